@@ -10,88 +10,25 @@
 #include <SDL_main.h>
 
 #include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
 #include <random>
+#include <thread>
 
-struct [[nodiscard]] ContextGuard{
-   ContextGuard(
-      std::function<int(void)> initContext
-      , std::function<void(void)> terminateContext)
-      : mInitContextFun{ initContext }
-      , mTerminateContextFun{ terminateContext } {
-      mInitStatus = mInitContextFun();
-   }
-
-   ~ContextGuard() {
-      mTerminateContextFun();
-   }
-
-   int getInitStatus() {
-      return mInitStatus;
-   }
-
-private: 
-   int mInitStatus;
-   std::function<int(void)> mInitContextFun;
-   std::function<void(void)> mTerminateContextFun;
-};
-
-
-GLuint VAO, VBO, shaderId;
-
-void createTriangle() {
-   GLfloat vertices[] = {
-      -1.0, -1.0, 0.0,
-       1.0, -1.0, 0.0,
-       0.0,  1.0, 0.0
-   };
-
-   glGenVertexArrays(1, &VAO);
-   glBindVertexArray(VAO);
-
-      glGenBuffers(1, &VBO);
-      glBindBuffer(GL_ARRAY_BUFFER, VBO); 
-      glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-      glEnableVertexAttribArray(0);
-
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
-   glBindVertexArray(0);
-}
+#include "capture.h"
+#include "frame_stats.h"
+#include "geometry.h"
+#include "headless.h"
+#include "meshes.h"
+#include "options.h"
+#include "program.h"
+#include "regression.h"
+#include "spsc_queue.h"
+#include "surface.h"
 
-
-GLuint createSquare() {
-   GLuint vao, vbo;
-
-   GLfloat vertices[] = {
-      -1.0, -1.0, 0.0,
-      -1.0,  1.0, 0.0,
-
-      -1.0,  1.0, 0.0,
-       1.0,  1.0, 0.0,
-
-       1.0,  1.0, 0.0,
-       1.0, -1.0, 0.0,
-
-       1.0, -1.0, 0.0,
-      -1.0, -1.0, 0.0
-   };
-
-   glGenVertexArrays(1, &vao);
-   glBindVertexArray(vao);
-
-   glGenBuffers(1, &vbo);
-   glBindBuffer(GL_ARRAY_BUFFER, vbo);
-   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-   glVertexAttribPointer(0, 3, GL_FLOAT, GL_TRUE, 0, 0);
-   glEnableVertexAttribArray(0);
-
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
-   glBindVertexArray(0);
-
-   return vao;
-}
+GLuint shaderId;
 
 //vertex shader
 static const char* vShader =
@@ -129,66 +66,57 @@ struct Color {
 const Color lawnGreen{  124.0/255, 252.0/255,   0.0/255, 1 };
 const Color chartReuse{ 127.0/255, 255.0/255,   0.0/255, 1 };
 const Color maroon{     128.0/255,   0.0/255,   0.0/255, 1 };
-std::atomic<Color> currentColor = lawnGreen;
-
-bool addShader(GLuint program, const char* shaderCode, GLenum shaderType) {
-   GLuint shader = glCreateShader(shaderType);
-
-   const GLchar* code[1];
-   code[0] = shaderCode;
-
-   GLint codeLength[1];
-   codeLength[0] = strlen(shaderCode);
 
-   glShaderSource(shader, 1, code, codeLength);
-   glCompileShader(shader);
-
-   GLint result = 0;
-   GLchar log[1024] = "";
-
-   glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
-   if (!result) {
-      glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
-      printf("Error compiling shader: '%s'\n", log);
-      return false;
-   }
-
-   glAttachShader(program, shader);
-   return true;
-}
-
-bool compileShaders(){
-   shaderId = glCreateProgram();
-   if (!shaderId) {
-      printf("Error creating shader program");
-      return false;
-   }
-
-   auto ret = true;
-   ret &= addShader(shaderId, vShader, GL_VERTEX_SHADER);
-   ret &= addShader(shaderId, fShader, GL_FRAGMENT_SHADER);
-
-   GLint result = 0;
-   GLchar log[1024] = "";
-
-   glLinkProgram(shaderId);
-   glGetProgramiv(shaderId, GL_LINK_STATUS, &result);
-   if (!result) {
-      glGetProgramInfoLog(shaderId, sizeof(log), nullptr, log);
-      printf("Error linking program: '%s'\n", log);
-      ret = false;
-   }
+// Clear colour produced by the simulation thread for the render thread.
+struct ColorUpdate {
+   Color color;
+   unsigned long tick = 0;
+};
 
-   glValidateProgram(shaderId);
-   glLinkProgram(shaderId);
-   glGetProgramiv(shaderId, GL_VALIDATE_STATUS, &result);
-   if (!result) {
-      glGetProgramInfoLog(shaderId, sizeof(log), nullptr, log);
-      printf("Error validating program: '%s'\n", log);
-      ret = false;
+SpscQueue<ColorUpdate, 64> colorUpdates;
+
+// Reproducible runs block on these instead of spinning: the simulation thread
+// for room in the queue, the render thread for the tick it needs. Either side
+// notifies under the mutex after its push or pop, so no wakeup is lost.
+std::mutex colorMutex;
+std::condition_variable colorPopped;
+std::condition_variable colorPushed;
+
+// simulation step of the clear colour
+const auto COLOR_INTERVAL = std::chrono::milliseconds(100);
+
+// Drifts the clear colour once per COLOR_INTERVAL and queues every new value.
+// Paced by the wall clock, or unpaced for reproducible runs: then it only
+// stays ahead of the render thread and waits for room instead of dropping.
+void simulate(const std::atomic<bool>& running, unsigned seed, bool paced) {
+   std::mt19937 random(seed);
+   std::uniform_real_distribution<float> drift(0.0f, 0.01f);
+
+   auto color = lawnGreen;
+   auto next = std::chrono::steady_clock::now();
+   for (unsigned long tick = 1; running.load(std::memory_order_relaxed); ++tick) {
+      const auto r = drift(random);
+      color.R = std::abs(std::fmod(color.R + r, 1.0f));
+      color.G = std::abs(std::fmod(color.G - r, 1.0f));
+      color.B = std::abs(std::fmod(color.B + r, 1.0f));
+
+      if (paced) {
+         colorUpdates.push({ color, tick });
+         next += COLOR_INTERVAL;
+         std::this_thread::sleep_until(next);
+      }
+      else {
+         {
+            std::unique_lock lock(colorMutex);
+            colorPopped.wait(lock, [&] {
+               return colorUpdates.depth() < colorUpdates.capacity() || !running.load(std::memory_order_relaxed);
+            });
+         }
+         colorUpdates.push({ color, tick });
+         std::lock_guard lock(colorMutex);
+         colorPushed.notify_one();
+      }
    }
-
-   return ret;
 }
 
 void sdlDie(const char* msg)
@@ -212,10 +140,12 @@ void checkSDLError(int line = -1)
 }
 
 int main(int argc, char* argv[]) {
-   SDL_Window* mainWindow;
-   SDL_GLContext glContext;
+   SDL_Window* mainWindow = nullptr;
+   SDL_GLContext glContext = nullptr;
+
+   const auto options = parseOptions(argc, argv);
 
-   if (SDL_Init(SDL_INIT_VIDEO) < 0) 
+   if (SDL_Init(options.headless ? 0 : SDL_INIT_VIDEO) < 0) 
       sdlDie("Unable to initialize SDL");
 
    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
@@ -223,79 +153,121 @@ int main(int argc, char* argv[]) {
    SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
 
-   //create timer
-   srand(2137);
-   unsigned int delay = 100;
-   auto callbackFun = [](unsigned int interval, void* param)->unsigned int {
-      printf("Kek xDD\n");
-      static int cnt = 0;
-      cnt++;
-
-      auto col = currentColor.load();
-      float r = 0;
-      r = (float(rand()) / RAND_MAX) * 0.01;
-      col.R = abs(fmod(col.R + r, 1));
-      col.G = abs(fmod(col.G - r, 1));
-      col.B = abs(fmod(col.B + r, 1));
-      currentColor.store(col);
-      //if (cnt % 2)
-      //   currentColor.store(maroon);
-      //else
-      //   currentColor.store(chartReuse);
-
-      return *static_cast<int*>(param);
-   };
-   auto timerId = SDL_AddTimer(delay, callbackFun, &delay);
-
-   mainWindow = SDL_CreateWindow(
-      "SDL2/OpenGL Demo",
-      SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 640, 480,
-      SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN );
-
-   if (!mainWindow)
-      sdlDie("Unable to create window");
-
-   checkSDLError(__LINE__);
-
-   glContext = SDL_GL_CreateContext(mainWindow);
-   checkSDLError(__LINE__);
-
-   SDL_GL_SetSwapInterval(1);
+   std::unique_ptr<Surface> surface;
+   if (options.headless) {
+      if (!headlessInit())
+         sdlDie("Unable to initialize headless display");
+
+      surface = makeWindow_headless(640, 480, 3, 2);
+      if (!surface)
+         sdlDie("Unable to create offscreen framebuffer");
+   }
+   else {
+      mainWindow = SDL_CreateWindow(
+         "SDL2/OpenGL Demo",
+         SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 640, 480,
+         SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN );
+
+      if (!mainWindow)
+         sdlDie("Unable to create window");
+
+      checkSDLError(__LINE__);
+
+      glContext = SDL_GL_CreateContext(mainWindow);
+      checkSDLError(__LINE__);
+
+      SDL_GL_SetSwapInterval(1);
+      surface = std::make_unique<SdlSurface>(mainWindow);
+   }
 
    //init glew
-   glewExperimental = GL_TRUE;
-   if (const auto ret = glewInit(); ret != GLEW_OK)
+   if (const auto ret = initGlew(); ret != GLEW_OK)
       return ret;
 
-   createTriangle();
-   compileShaders();
-
-   bool shouldQuit = false;
-   SDL_Event e;
-   while (!shouldQuit) {
-      while (SDL_PollEvent(&e)) {
-         if (e.type == SDL_QUIT)
-            shouldQuit = true;
+   GeometryRegistry geometry(parseVertexType(options.vertexFormat));
+   const auto triangle = createTriangle(geometry);
+   const auto square = createSquare(geometry);
+   shaderId = compileProgram(vShader, fShader);
+   if (!shaderId)
+      sdlDie("Unable to build the shader program");
+
+   // simulation runs on its own thread; the render loop drains its updates without waiting
+   std::atomic<bool> simulating = true;
+   const auto reproducible = options.frameTime > 0;
+   std::thread simulation(simulate, std::cref(simulating), options.seed.value_or(2137), !reproducible);
+   auto color = lawnGreen;
+   unsigned long colorTick = 0;
+
+   RegressionCheck check(options);
+   FrameCapture capture(options);
+   FrameRateCounter frameRate(options.frames);
+   for (unsigned long i = 0; !surface->shouldClose() && options.keepRunning(i); ++i) {
+      surface->pollEvents();
+
+      // everything that arrived; reproducible runs instead take exactly the
+      // ticks their fixed frame time has covered, waiting for them if needed
+      const auto wantedTick = reproducible
+         ? (unsigned long)(i * options.frameTime / std::chrono::duration<double>(COLOR_INTERVAL).count()) + 1
+         : ~0ul;
+      while (colorTick < wantedTick) {
+         if (const auto update = colorUpdates.pop()) {
+            color = update->color;
+            colorTick = update->tick;
+            if (reproducible) {
+               std::lock_guard lock(colorMutex);
+               colorPopped.notify_one();
+            }
+         }
+         else if (reproducible) {
+            std::unique_lock lock(colorMutex);
+            colorPushed.wait(lock, [] { return colorUpdates.depth() > 0; });
+         }
+         else
+            break;
       }
 
-      const auto col = currentColor.load();
-
-      glClearColor(col.R, col.G, col.B, col.alpha);
+      glClearColor(color.R, color.G, color.B, color.alpha);
       glUseProgram(shaderId);
-         glBindVertexArray(VAO);
-            glDrawArrays(GL_TRIANGLES, 0, 3);
-            glBindVertexArray(createSquare());
-            glDrawArrays(GL_LINES, 0, 8);
+         geometry.draw(triangle);
+         geometry.draw(square);
          glBindVertexArray(0);
       glUseProgram(0);
 
-      SDL_GL_SwapWindow(mainWindow);
+      if ((i & 0x3FF) == 0)
+         geometry.printStats();
+
+      check.frame(i, *surface);
+      capture.frame(*surface);
+      surface->swapBuffers();
       glClear(GL_COLOR_BUFFER_BIT);
+      frameRate.frame();
    }
 
-   SDL_GL_DeleteContext(glContext);
-   SDL_DestroyWindow(mainWindow);
+   {
+      std::lock_guard lock(colorMutex);
+      simulating = false;
+   }
+   colorPopped.notify_one();
+   simulation.join();
+
+   frameRate.print();
+   capture.finish();
+   capture.printStats();
+   colorUpdates.printStats("Color updates");
+   const auto status = check.finish(frameRate);
+
+   // GL objects have to go before the context does
+   geometry.printStats();
+   geometry.clear();
+   surface.reset();
+
+   if (options.headless)
+      headlessTerminate();
+   else {
+      SDL_GL_DeleteContext(glContext);
+      SDL_DestroyWindow(mainWindow);
+   }
    SDL_Quit();
 
-   return 0;
+   return status;
 }
\ No newline at end of file
@@ -9,220 +9,223 @@
 #include <cmath>
 #include <optional>
 #include <cstdlib>
+#include <cstring>
 #include <time.h>
 
-#include "util.h"
-#include "shaders.h"
+#include "allocation_tracker.h"
+#include "capture.h"
+#include "context.h"
+#include "frame_stats.h"
+#include "geometry.h"
+#include "headless.h"
+#include "meshes.h"
+#include "options.h"
+#include "profiler.h"
+#include "program_cache.h"
+#include "program_reflection.h"
+#include "regression.h"
+#include "render_queue.h"
+#include "shader_pipeline.h"
+#include "shader_reloader.h"
+#include "sim_clock.h"
+#include "stream_buffer.h"
+#include "surface.h"
 
 const GLint WIDTH = 800;
 const GLint HEIGHT = 800;
 
-GLuint uniformXMove;
-GLuint uniformYMove;
+// uniform block binding point of the Offsets block
+const GLuint OFFSETS_BINDING = 0;
+
 int directionX = 1;
 int directionY = 1;
-auto offsetX = 0.0f;
-auto offsetY = 0.0f;
+Interpolated<float> offsetX;
+Interpolated<float> offsetY;
 auto offsetMax = 0.5f;
 auto offsetIncrement = 5.0e-3f;
 
-GLuint createTriangle() {
-   GLuint vao = 0;
-   GLuint vbo = 0;
-
-   GLfloat vertices[] = {
-      -1.0, -1.0, 0.0,
-       1.0, -1.0, 0.0,
-       0.0,  1.0, 0.0
-   };
-
-   glGenVertexArrays(1, &vao);
-   glBindVertexArray(vao);
-
-      glGenBuffers(1, &vbo);
-      glBindBuffer(GL_ARRAY_BUFFER, vbo); 
-      glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-      glEnableVertexAttribArray(0);
-
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
-   glBindVertexArray(0);
-
-   return vao;
-}
-
-GLuint createSquare() {
-   GLuint vao, vbo;
-
-   GLfloat vertices[] = {
-      -1.0, -1.0, 0.0,
-      -1.0,  1.0, 0.0,
-
-      -1.0,  1.0, 0.0,
-       1.0,  1.0, 0.0,
-
-       1.0,  1.0, 0.0,
-       1.0, -1.0, 0.0,
-
-       1.0, -1.0, 0.0,
-      -1.0, -1.0, 0.0
-   };
-
-   glGenVertexArrays(1, &vao);
-   glBindVertexArray(vao);
-
-   glGenBuffers(1, &vbo);
-   glBindBuffer(GL_ARRAY_BUFFER, vbo);
-   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-   glVertexAttribPointer(0, 3, GL_FLOAT, GL_TRUE, 0, 0);
-   glEnableVertexAttribArray(0);
-
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
-   glBindVertexArray(0);
-
-   return vao;
-}
-
-
-bool addShader(GLuint program, const char* shaderCode, GLenum shaderType) {
-   GLuint shader = glCreateShader(shaderType);
+// simulation rate; offsetIncrement is per tick
+const double TICK_SECONDS = 1.0 / 60;
 
-   const GLchar* code[1];
-   code[0] = shaderCode;
-
-   GLint codeLength[1];
-   codeLength[0] = strlen(shaderCode);
-
-   glShaderSource(shader, 1, code, codeLength);
-   glCompileShader(shader);
-
-   GLint result = 0;
-   GLchar log[1024] = "";
-
-   glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
-   if (!result) {
-      glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
-      printf("Error compiling shader: '%s'\n", log);
-      return false;
-   }
-
-   glAttachShader(program, shader);
-   return true;
+// Block bindings are not part of a program binary, so they are set on every load.
+void bindBlocks(GLuint program) {
+   ProgramReflection(program).bindBlock("Offsets", OFFSETS_BINDING);
 }
 
-std::optional<GLuint> compileShaders(){
-   auto shaderId = glCreateProgram();
-   if (!shaderId) {
-      printf("Error creating shader program");
-      return {};
-   }
-
-   auto ret = true;
-   ret &= addShader(shaderId, vShader, GL_VERTEX_SHADER);
-   ret &= addShader(shaderId, fShader, GL_FRAGMENT_SHADER);
-
-   GLint result = 0;
-   GLchar log[1024] = "";
-
-   glLinkProgram(shaderId);
-   glGetProgramiv(shaderId, GL_LINK_STATUS, &result);
-   if (!result) {
-      glGetProgramInfoLog(shaderId, sizeof(log), nullptr, log);
-      printf("Error linking program: '%s'\n", log);
-      ret = false;
-   }
-
-   glValidateProgram(shaderId);
-   glLinkProgram(shaderId);
-   glGetProgramiv(shaderId, GL_VALIDATE_STATUS, &result);
-   if (!result) {
-      glGetProgramInfoLog(shaderId, sizeof(log), nullptr, log);
-      printf("Error validating program: '%s'\n", log);
-      ret = false;
-   }
-
-   uniformXMove = glGetUniformLocation(shaderId, "xMove");
-   uniformYMove = glGetUniformLocation(shaderId, "yMove");
-
-   if (ret)
-      return shaderId;
-   else {
-      glDeleteShader(shaderId);
-      return {};
-   }
+// One fixed simulation step: bounce the offsets between -offsetMax and offsetMax.
+void simulateTick() {
+   offsetX.save();
+   offsetY.save();
+
+   offsetX.current += directionX * offsetIncrement;
+   if(abs(offsetX.current) >= offsetMax)
+      directionX *= -1;
+   offsetY.current += directionY * offsetIncrement;
+   if(abs(offsetY.current) >= offsetMax)
+      directionY *= -1;
 }
 
+int main(int argc, char* argv[]) {
+   const auto options = parseOptions(argc, argv);
 
-int main() {
-   std::srand(time(nullptr));
-   offsetX = float(rand() % 100) / 100 - 0.5;
-   offsetY = float(rand() % 100) / 100 - 0.5;
+   std::srand(options.seed.value_or(unsigned(time(nullptr))));
+   offsetX.reset(float(rand() % 100) / 100 - 0.5);
+   offsetY.reset(float(rand() % 100) / 100 - 0.5);
 
-   //init glew
-   ContextGuard glfwContext(glfwInit, glfwTerminate);
+   //init glfw, or EGL when running headless
+   ContextGuard glfwContext(
+      options.headless ? headlessInit : glfwInit,
+      options.headless ? headlessTerminate : glfwTerminate);
    const auto ret = glfwContext.getInitStatus();
    if (ret != GLFW_TRUE)
       return ret;
 
-   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
-   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-   glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+   //make glfw window, or an offscreen framebuffer when running headless
+   window_ptr mainWindow;
+   std::unique_ptr<Surface> surface;
+   if (options.headless)
+      surface = makeWindow_headless(WIDTH, HEIGHT, 3, 2);
+   else {
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+      glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+      glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 
-   //make glfw window
-   auto mainWindow = makeWindow_glfw(WIDTH, HEIGHT, "MainWindow", nullptr, nullptr);
+      mainWindow = makeWindow_glfw(WIDTH, HEIGHT, "MainWindow", nullptr, nullptr);
 
-   // create gl context
-   glfwMakeContextCurrent(mainWindow.get());
+      // create gl context
+      glfwMakeContextCurrent(mainWindow.get());
+      surface = std::make_unique<GlfwSurface>(mainWindow.get());
+   }
+   if (!surface)
+      return -1;
 
    // intit glew
-   glewExperimental = GL_TRUE;
-   if (const auto ret = glewInit(); ret != GLEW_OK)
+   if (const auto ret = initGlew(); ret != GLEW_OK)
       return ret;
 
    int bufferWidth, bufferHeight;
-   glfwGetFramebufferSize(mainWindow.get(), &bufferWidth, &bufferHeight);
+   surface->getFramebufferSize(&bufferWidth, &bufferHeight);
    glViewport(0, 0, bufferHeight, bufferWidth);
 
-   const auto triangleVao = createTriangle();
-   const auto squareVao = createSquare();   
-
-   GLuint shaderId = 0;
-   if (auto ret = compileShaders(); !ret.has_value())
-      return(-1);
-   else
-      shaderId = ret.value();
-
-   for (unsigned long i = 0; !glfwWindowShouldClose(mainWindow.get()); ++i) {
-      if(i & 0x80)
+   GeometryRegistry geometry(parseVertexType(options.vertexFormat));
+   const auto triangle = createTriangle(geometry);
+   const auto square = createSquare(geometry);
+   geometry.merge();
+
+   // programs build in the background, the fallback draws until they are ready
+   ProgramCache programCache(options.shaderCache ? options.shaderCache : "");
+   ShaderPipeline shaders(&programCache);
+   const auto fallback = shaders.submit({ { GL_VERTEX_SHADER, FALLBACK_VERTEX_SHADER }, { GL_FRAGMENT_SHADER, FALLBACK_FRAGMENT_SHADER } });
+   // the sample's shaders are files, rebuilt on the fly when edited
+   ShaderReloader reloader(shaders, options.shaderDir ? options.shaderDir : PLAYGROUND_SHADER_DIR, options.watchShaders);
+   const auto program = reloader.add({ { GL_VERTEX_SHADER, "offsets.vert" }, { GL_FRAGMENT_SHADER, "red.frag" } }, bindBlocks);
+   if (!program)
+      return -1;
+   if (!shaders.wait(fallback))
+      return -1;
+
+   // per-frame uniform data, written straight into mapped memory
+   StreamBuffer stream;
+   if (!stream.create(1024))
+      return -1;
+   const auto uniformAlignment = uniformBufferAlignment();
+
+   Profiler profiler;
+   if (options.profilePath && !profiler.open(options.profilePath))
+      return -1;
+
+   // fixed-rate simulation, rendered between its last two ticks
+   SimulationClock clock(TICK_SECONDS);
+   auto lastTime = surface->getTime();
+
+   // draws go out sorted by state, binds already in place are skipped
+   RenderQueue queue;
+
+   // after warm-up a frame allocates nothing from the heap
+   AllocationCheck allocations(options);
+
+   RegressionCheck check(options);
+   FrameCapture capture(options);
+   FrameRateCounter frameRate(options.frames);
+   for (unsigned long i = 0; !surface->shouldClose() && options.keepRunning(i); ++i) {
+      allocations.beginFrame(i);
+      profiler.beginFrame();
+
+      // a broken shader file is fatal only when nobody can fix it while we run
+      shaders.poll();
+      reloader.poll();
+      const auto current = reloader.handle(*program);
+      if (shaders.failed(current) && !reloader.watching())
+         return -1;
+      const auto shaderId = shaders.program(shaders.ready(current) ? current : fallback);
+
+      {
+         ProfileScope scope(profiler, "simulate");
+         const auto now = surface->getTime();
+         const auto steps = clock.advance(options.frameTime > 0 ? options.frameTime : now - lastTime);
+         lastTime = now;
+         for (unsigned step = 0; step < steps; ++step)
+            simulateTick();
+      }
+      const auto alpha = clock.alpha();
+
+      if(clock.ticks() & 0x80)
          glClearColor(0.0, 1.0, 0.0, 1.0);
       else
          glClearColor(0.0, 0.0, 1.0, 1.0);
 
-      offsetX += directionX * offsetIncrement;
-      if(abs(offsetX) >= offsetMax)
-         directionX *= -1;
-      offsetY += directionY * offsetIncrement;
-      if(abs(offsetY) >= offsetMax)
-         directionY *= -1;
-
-      glUseProgram(shaderId);
-         glUniform1f(uniformXMove, offsetX);
-         glUniform1f(uniformYMove, offsetY);
-         glBindVertexArray(triangleVao);
-            glDrawArrays(GL_TRIANGLES, 0, 3);
-         glBindVertexArray(squareVao);
-            glDrawArrays(GL_LINES, 0, 8);
-         glBindVertexArray(0);
-
-      glUseProgram(0);
-
-      glfwPollEvents();
-      glfwSwapBuffers(mainWindow.get());
-      glClear(GL_COLOR_BUFFER_BIT);
+      stream.beginFrame();
+      StreamRange range;
+      {
+         ProfileScope scope(profiler, "uniform upload");
+         const GLfloat offsets[] = { offsetX.at(alpha), offsetY.at(alpha) };
+         range = stream.allocate(sizeof(offsets), uniformAlignment);
+         // an exhausted slice is counted in the stream stats, the frame draws nothing
+         if (range.data)
+            memcpy(range.data, offsets, sizeof(offsets));
+         stream.endWrites();
+      }
+
+      if (range.data) {
+         ProfileScope scope(profiler, "draw");
+         for (const auto mesh : { triangle, square }) {
+            auto command = makeDrawCommand(shaderId, geometry.range(mesh));
+            command.uniformIndex = OFFSETS_BINDING;
+            command.uniformBuffer = stream.get();
+            command.uniformOffset = range.offset;
+            command.uniformSize = range.size;
+            queue.submit(command);
+         }
+         queue.flush();
+      }
+      stream.endFrame();
+      allocations.endFrame();
+
+      {
+         ProfileScope scope(profiler, "swap");
+         surface->pollEvents();
+         check.frame(i, *surface);
+         capture.frame(*surface);
+         surface->swapBuffers();
+         glClear(GL_COLOR_BUFFER_BIT);
+      }
+
+      profiler.endFrame();
+      frameRate.frame();
    }
 
-   return 0;
+   frameRate.print();
+   capture.finish();
+   capture.printStats();
+   clock.printStats();
+   stream.printStats();
+   queue.printStats();
+   shaders.printStats();
+   reloader.printStats();
+   programCache.printStats();
+   geometry.printStats();
+   allocations.printStats();
+
+   return check.finish(frameRate) | allocations.finish();
 }
\ No newline at end of file
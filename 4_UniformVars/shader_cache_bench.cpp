@@ -0,0 +1,100 @@
+// Startup benchmark: builds a set of program variants one at a time, all at
+// once through the asynchronous ShaderPipeline, then with an empty shader cache
+// (compile + link + store) and again from the cached binaries.
+//
+// usage: ShaderCacheBench [programs=64] [cache directory=shader_cache_bench]
+//
+// Drivers keep their own on-disk shader caches too; every variant gets a unique
+// source so the cold pass really compiles. (Mesa stops reporting program binary
+// formats when MESA_SHADER_CACHE_DISABLE is set, which disables this cache.)
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <stdio.h>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "headless.h"
+#include "program_cache.h"
+#include "shader_pipeline.h"
+#include "shader_reloader.h"
+
+// Milliseconds to build every variant with a fresh pipeline (and cache on
+// directory, unless empty). Serial waits for each program before submitting
+// the next one, like the old compileShaders(); otherwise all are submitted up
+// front and polled until done.
+double buildAll(const std::filesystem::path& directory, const std::vector<std::string>& vertex, const std::vector<std::string>& fragment, bool serial, const char* label) {
+   const auto start = std::chrono::steady_clock::now();
+   ProgramCache cache(directory);
+   ShaderPipeline pipeline(&cache);
+
+   for (std::size_t i = 0; i < vertex.size(); ++i) {
+      const auto program = pipeline.submit({ { GL_VERTEX_SHADER, vertex[i].c_str() }, { GL_FRAGMENT_SHADER, fragment[i].c_str() } });
+      if (serial)
+         pipeline.wait(program);
+   }
+   while (!pipeline.poll())
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+   glFinish();
+   const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+   printf("%-14s %8.2f ms %8.3f ms/program, %lu hits, %lu misses\n",
+      label, elapsed, elapsed / vertex.size(), cache.hits(), cache.misses());
+   return elapsed;
+}
+
+int main(int argc, char* argv[]) {
+   const std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+   const std::filesystem::path directory = argc > 2 ? argv[2] : "shader_cache_bench";
+
+   if (headlessInit() != 1) {
+      printf("ShaderCacheBench needs the headless backend\n");
+      return -1;
+   }
+   auto window = makeWindow_headless(64, 64, 3, 2);
+   if (!window) {
+      headlessTerminate();
+      return -1;
+   }
+
+   // unique, otherwise unused function per variant and pass, so one pass does
+   // not warm the driver's cache for the next
+   const auto variants = [count](const std::string& source, int pass) {
+      std::vector<std::string> sources;
+      for (std::size_t i = 0; i < count; ++i)
+         sources.push_back(source + ("\nfloat variant" + std::to_string(pass) + "_" + std::to_string(i) + "() { return " + std::to_string(i) + ".0; }\n"));
+      return sources;
+   };
+
+   std::vector<std::filesystem::path> files;
+   const auto vShader = loadShaderSource(PLAYGROUND_SHADER_DIR "/offsets.vert", PLAYGROUND_SHADER_DIR, files);
+   const auto fShader = loadShaderSource(PLAYGROUND_SHADER_DIR "/red.frag", PLAYGROUND_SHADER_DIR, files);
+   if (!vShader || !fShader) {
+      window.reset();
+      headlessTerminate();
+      return -1;
+   }
+
+   std::error_code error;
+   std::filesystem::remove_all(directory, error);
+
+   printf("%zu programs, cache in '%s'\n", count, directory.string().c_str());
+   printf("%s driver compile\n", ShaderPipeline().parallel() ? "parallel" : "serial");
+
+   const auto serial = buildAll({}, variants(*vShader, 0), variants(*fShader, 0), true, "serial");
+   const auto batched = buildAll({}, variants(*vShader, 1), variants(*fShader, 1), false, "batched");
+   const auto cold = buildAll(directory, variants(*vShader, 2), variants(*fShader, 2), false, "batched, cold");
+   const auto warm = buildAll(directory, variants(*vShader, 2), variants(*fShader, 2), false, "batched, warm");
+   if (batched > 0 && warm > 0)
+      printf("batched %.1fx, warm cache %.1fx faster than serial (cold cache %.1fx)\n", serial / batched, serial / warm, serial / cold);
+
+   window.reset();
+   headlessTerminate();
+   return 0;
+}
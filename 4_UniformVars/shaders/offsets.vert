@@ -0,0 +1,10 @@
+#version 330
+layout (location = 0) in vec3 pos;
+layout (std140) uniform Offsets {
+    float xMove;
+    float yMove;
+};
+
+void main(){
+    gl_Position = vec4(0.5*pos.x + xMove, 0.5*pos.y+yMove, 0.5*pos.z, 1.0);
+}
@@ -0,0 +1,185 @@
+// Feeds the mesh and texture file parsers, which the loader threads run on
+// untrusted input, valid files and corrupted copies of them, and fails unless
+// the valid ones parse and every corrupted one is rejected. No GL context needed.
+//
+// usage: FileFormatTest
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <stdio.h>
+#include <vector>
+
+#include "file_loader.h"
+#include "mesh_builder.h"
+#include "mesh_file.h"
+#include "texture_file.h"
+
+int failures = 0;
+
+void expect(bool passed, const char* what) {
+   printf("%s: %s\n", what, passed ? "ok" : "FAILED");
+   failures += !passed;
+}
+
+std::vector<std::byte> readFile(const std::filesystem::path& path) {
+   MappedFile file;
+   if (!file.open(path))
+      return {};
+   return { file.bytes().begin(), file.bytes().end() };
+}
+
+// A copy of file with its header changed by edit.
+std::vector<std::byte> withHeader(std::vector<std::byte> file, const std::function<void(MeshFileHeader&)>& edit) {
+   MeshFileHeader header;
+   std::memcpy(&header, file.data(), sizeof(header));
+   edit(header);
+   std::memcpy(file.data(), &header, sizeof(header));
+   return file;
+}
+
+void testMeshFiles() {
+   // two triangles of a quad, indexed down to four vertices
+   const float soup[] = { 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 0, 0, 1, 1, 0, 0, 1, 0 };
+   const auto path = std::filesystem::temp_directory_path() / "file_format_test.pgmf";
+   if (!writeMeshFile(path, buildIndexedMesh(soup, 3), GL_TRIANGLES, VertexType::Float32)) {
+      expect(false, "mesh file: write");
+      return;
+   }
+   const auto file = readFile(path);
+   std::filesystem::remove(path);
+
+   const auto valid = parseMeshFile(file, "valid");
+   expect(valid && valid->header.vertexCount == 4 && valid->header.indexCount == 6 && valid->attributes.size() == 1,
+      "mesh file: valid file parses");
+
+   const auto rejected = [](const std::vector<std::byte>& data, const char* what) {
+      expect(!parseMeshFile(data, what), what);
+   };
+   rejected({ file.begin(), file.end() - 1 }, "mesh file: truncated index section");
+   rejected({ file.begin(), file.begin() + sizeof(MeshFileHeader) - 1 }, "mesh file: truncated header");
+   rejected(withHeader(file, [](auto& header) { header.magic[0] = 'X'; }), "mesh file: bad magic");
+   // indexCount * indexSize is 0, as are the index bytes right at the end of the file
+   rejected(withHeader(file, [&](auto& header) {
+      header.indexSize = 0;
+      header.indexCount = 100'000'000;
+      header.indexOffset = file.size();
+      header.indexBytes = 0;
+   }), "mesh file: index count without an index size");
+   rejected(withHeader(file, [](auto& header) { header.indexSize = 3; }), "mesh file: 3-byte indices");
+   rejected(withHeader(file, [](auto& header) { header.mode = 99; }), "mesh file: unknown primitive mode");
+   rejected(withHeader(file, [](auto& header) { header.vertexCount = 3; header.vertexBytes = 3 * header.stride; }),
+      "mesh file: index past the vertices");
+   rejected(withHeader(file, [](auto& header) { header.attributeCount = 17; }), "mesh file: too many attributes");
+   rejected(withHeader(file, [&](auto& header) { header.vertexOffset = file.size(); }), "mesh file: vertices outside the file");
+
+   // the attribute's offset, past the 12-byte position it describes
+   auto shifted = file;
+   const std::uint32_t offset = 4;
+   std::memcpy(shifted.data() + sizeof(MeshFileHeader) + offsetof(MeshFileAttribute, offset), &offset, sizeof(offset));
+   rejected(shifted, "mesh file: attribute past the stride");
+}
+
+void put32(std::vector<std::byte>& data, std::size_t offset, std::uint32_t value) {
+   std::memcpy(data.data() + offset, &value, sizeof(value));
+}
+
+void put64(std::vector<std::byte>& data, std::size_t offset, std::uint64_t value) {
+   std::memcpy(data.data() + offset, &value, sizeof(value));
+}
+
+// 4x4 RGBA8 with its three levels, 64 + 16 + 4 bytes
+constexpr std::size_t TEXTURE_LEVEL_BYTES[] = { 64, 16, 4 };
+constexpr std::size_t TEXTURE_BYTES = 84;
+
+// KTX2: identifier, header, empty DFD/KVD/SGD index, level index, levels smallest first.
+std::vector<std::byte> makeKtx2(std::uint32_t faces) {
+   static constexpr unsigned char IDENTIFIER[12] = { 0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n' };
+   constexpr std::size_t LEVEL_INDEX = 80;
+   constexpr std::size_t DATA = LEVEL_INDEX + 3 * 24;
+   std::vector<std::byte> data(DATA + TEXTURE_BYTES);
+   std::memcpy(data.data(), IDENTIFIER, sizeof(IDENTIFIER));
+   put32(data, 12, 37);           // VK_FORMAT_R8G8B8A8_UNORM
+   put32(data, 16, 1);            // typeSize
+   put32(data, 20, 4);
+   put32(data, 24, 4);
+   put32(data, 36, faces);
+   put32(data, 40, 3);
+   auto offset = data.size();
+   for (std::size_t level = 0; level < 3; ++level) {
+      offset -= TEXTURE_LEVEL_BYTES[level];
+      put64(data, LEVEL_INDEX + level * 24, offset);
+      put64(data, LEVEL_INDEX + level * 24 + 8, TEXTURE_LEVEL_BYTES[level]);
+      put64(data, LEVEL_INDEX + level * 24 + 16, TEXTURE_LEVEL_BYTES[level]);
+   }
+   return data;
+}
+
+// DDS: magic, header, with dx10 the DX10 header, levels largest first.
+std::vector<std::byte> makeDds(bool dx10, std::uint32_t caps2 = 0, std::uint32_t miscFlag = 0) {
+   const std::size_t header = dx10 ? 148 : 128;
+   std::vector<std::byte> data(header + TEXTURE_BYTES);
+   std::memcpy(data.data(), "DDS ", 4);
+   put32(data, 4, 124);
+   put32(data, 12, 4);
+   put32(data, 16, 4);
+   put32(data, 28, 3);
+   put32(data, 76, 32);
+   put32(data, 112, caps2);
+   if (dx10) {
+      put32(data, 80, 0x4);       // DDPF_FOURCC
+      std::memcpy(data.data() + 84, "DX10", 4);
+      put32(data, 128, 28);       // DXGI_FORMAT_R8G8B8A8_UNORM
+      put32(data, 132, 3);        // TEXTURE2D
+      put32(data, 136, miscFlag);
+      put32(data, 140, 1);
+   }
+   else {
+      put32(data, 80, 0x41);      // DDPF_RGB | DDPF_ALPHAPIXELS
+      put32(data, 88, 32);
+      put32(data, 92, 0xff);
+      put32(data, 96, 0xff00);
+      put32(data, 100, 0xff0000);
+      put32(data, 104, 0xff000000);
+   }
+   return data;
+}
+
+void testTextureFiles() {
+   const auto parses = [](const std::vector<std::byte>& data, const char* what) {
+      const auto view = parseTextureFile(data, what);
+      expect(view && view->width == 4 && view->height == 4 && view->levels.size() == 3
+         && view->levels[2].size() == TEXTURE_LEVEL_BYTES[2] && !view->format.compressed, what);
+   };
+   const auto rejected = [](const std::vector<std::byte>& data, const char* what) {
+      expect(!parseTextureFile(data, what), what);
+   };
+
+   const auto ktx2 = makeKtx2(1);
+   parses(ktx2, "KTX2: valid file parses");
+   rejected({ ktx2.begin(), ktx2.end() - 1 }, "KTX2: truncated level");
+   auto shortLevel = ktx2;
+   put64(shortLevel, 80 + 8, TEXTURE_LEVEL_BYTES[0] - 4);
+   rejected(shortLevel, "KTX2: level shorter than its size");
+   rejected(makeKtx2(6), "KTX2: cube map");
+
+   parses(makeDds(false), "DDS: valid file parses");
+   parses(makeDds(true), "DDS: valid DX10 file parses");
+   const auto dds = makeDds(false);
+   rejected({ dds.begin(), dds.end() - 1 }, "DDS: truncated level");
+   rejected(makeDds(false, 0x200), "DDS: cube map");
+   rejected(makeDds(true, 0, 0x4), "DDS: DX10 cube map");
+
+   rejected(std::vector<std::byte>(256), "texture file: neither KTX2 nor DDS");
+}
+
+int main() {
+   testMeshFiles();
+   testTextureFiles();
+   printf("File format test: %s\n", failures ? "FAILED" : "ok");
+   return failures ? 1 : 0;
+}
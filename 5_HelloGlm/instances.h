@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cmath>
+#include <cstdlib>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "transform.h"
+#include "util.h"
+
+// Animation parameters of instanced objects as structure of arrays, one entry
+// per object, laid out for composeTransforms().
+struct InstanceSet {
+   std::vector<float> positionX;
+   std::vector<float> positionY;
+   std::vector<float> positionZ;
+   std::vector<float> axisX;  // unit length
+   std::vector<float> axisY;
+   std::vector<float> axisZ;
+   std::vector<float> phase;  // degrees
+   std::vector<float> speed;  // multiplier of the shared rotation angle
+   std::vector<float> scale;
+
+   // per frame scratch: rotation angle in radians
+   std::vector<float> angle;
+
+   std::size_t size() const {
+      return positionX.size();
+   }
+};
+
+// Spreads count objects over spread times the viewport, shrinking them as
+// the density grows.
+inline InstanceSet makeInstances(std::size_t count, glm::vec3 axis, float direction, float spread = 1.0f) {
+   InstanceSet set;
+   const auto size = 0.5f * spread / std::sqrt(float(count));
+   axis = glm::normalize(axis);
+
+   for (std::size_t i = 0; i < count; ++i) {
+      set.positionX.push_back(spread * (float(rand() % 2000) / 1000 - 1));
+      set.positionY.push_back(spread * (float(rand() % 2000) / 1000 - 1));
+      set.positionZ.push_back(0.0f);
+      set.axisX.push_back(axis.x);
+      set.axisY.push_back(axis.y);
+      set.axisZ.push_back(axis.z);
+      set.phase.push_back(float(rand() % 360));
+      set.speed.push_back(direction * (0.5f + float(rand() % 100) / 100));
+      set.scale.push_back(size);
+   }
+   set.angle.resize(count);
+
+   return set;
+}
+
+// Model matrix of every object in set with the batched kernel, angle in degrees.
+inline void buildModels(InstanceSet& set, float angle, glm::vec3 offset, float scaleFactor, std::span<glm::mat4> models, SimdLevel level = bestSimdLevel()) {
+   if (set.size() == 0)
+      return;
+
+   for (std::size_t i = 0; i < set.size(); ++i)
+      set.angle[i] = toRadians(angle * set.speed[i] + set.phase[i]);
+
+   TransformBatch batch;
+   batch.positionX = set.positionX.data();
+   batch.positionY = set.positionY.data();
+   batch.positionZ = set.positionZ.data();
+   batch.axisX = set.axisX.data();
+   batch.axisY = set.axisY.data();
+   batch.axisZ = set.axisZ.data();
+   batch.angle = set.angle.data();
+   batch.scale = set.scale.data();
+   batch.count = set.size();
+   batch.offset[0] = offset.x;
+   batch.offset[1] = offset.y;
+   batch.offset[2] = offset.z;
+   batch.scaleFactor = scaleFactor;
+
+   composeTransforms(batch, glm::value_ptr(models[0]), level);
+}
+
+// Model matrix of object i through the glm::translate/rotate/scale chain.
+inline glm::mat4 buildModelGlm(const InstanceSet& set, std::size_t i, float angle, glm::vec3 offset, float scaleFactor) {
+   auto model = glm::mat4(1.0f);
+   model = glm::translate(model, glm::vec3(set.positionX[i], set.positionY[i], set.positionZ[i]) + offset);
+   model = glm::rotate(model, toRadians(angle * set.speed[i] + set.phase[i]), glm::vec3(set.axisX[i], set.axisY[i], set.axisZ[i]));
+   model = glm::scale(model, glm::vec3(set.scale[i]));
+   model = glm::scale(model, glm::vec3(scaleFactor));
+   return model;
+}
+
+// Reference: the per-object chain the kernel replaces.
+inline void buildModelsGlm(const InstanceSet& set, float angle, glm::vec3 offset, float scaleFactor, std::span<glm::mat4> models) {
+   for (std::size_t i = 0; i < set.size(); ++i)
+      models[i] = buildModelGlm(set, i, angle, offset, scaleFactor);
+}
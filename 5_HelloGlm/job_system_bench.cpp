@@ -0,0 +1,116 @@
+// Scheduling cost of the JobSystem and how the --objects frame graph
+// (simulate -> transforms -> cull -> record) scales with worker threads on
+// a synthetic scene. Nothing is drawn: the recorded lists are dropped, so
+// only the CPU side of a frame is timed.
+//
+// usage: JobSystemBench [objects=100000] [max threads=max(16, hardware threads)]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#include "command_list.h"
+#include "frame_memory.h"
+#include "job_system.h"
+#include "object_frame.h"
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+   return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Empty jobs, so all that is timed is queueing, stealing and waiting.
+void measureOverhead(unsigned threads) {
+   constexpr int REPEATS = 200;
+   JobSystem jobs(threads);
+
+   // a loop of one-index chunks, as many as the deques hold
+   const auto count = std::size_t(JobDeque::CAPACITY) * threads;
+   jobs.parallelFor(count, 1, [](std::size_t, std::size_t, unsigned) {});
+   auto start = Clock::now();
+   for (int i = 0; i < REPEATS; ++i)
+      jobs.parallelFor(count, 1, [](std::size_t, std::size_t, unsigned) {});
+   const auto loopJob = secondsSince(start) / (double(REPEATS) * double(count));
+
+   // a chain of single-job nodes, each released by the one before it
+   constexpr std::size_t CHAIN = 1000;
+   TaskGraph chain;
+   auto previous = chain.add("link", [](unsigned) {});
+   for (std::size_t i = 1; i < CHAIN; ++i) {
+      const auto next = chain.add("link", [](unsigned) {});
+      chain.precede(previous, next);
+      previous = next;
+   }
+   jobs.run(chain);
+   start = Clock::now();
+   for (int i = 0; i < REPEATS; ++i)
+      jobs.run(chain);
+   const auto chainTask = secondsSince(start) / (double(REPEATS) * double(CHAIN));
+
+   printf("%2u threads: %7.1f ns/job in a parallel loop, %7.1f ns/task along a dependency chain\n",
+      threads, loopJob * 1e9, chainTask * 1e9);
+}
+
+// Wall time of one frame graph run over objects objects on threads threads.
+double measureFrame(std::size_t objects, unsigned threads) {
+   constexpr int FRAMES = 30;
+   JobSystem jobs(threads);
+   ParallelRecorder recorder(jobs);
+
+   ObjectFrame frame;
+   frame.shapes[0] = makeInstances(objects / 2, glm::vec3(0.0f, 0.0f, 1.0f), 1.0f, 2.0f);
+   frame.shapes[1] = makeInstances(objects - objects / 2, glm::vec3(1.0f, 1.0f, 1.0f), -1.0f, 2.0f);
+   frame.radius[0] = frame.radius[1] = 0.5f;
+   frame.ranges[0].count = 3;
+   frame.ranges[1].count = 6;
+   frame.uniformStride = 256;
+   std::vector<unsigned char> uniforms(objects * std::size_t(frame.uniformStride));
+   frame.uniforms = uniforms.data();
+
+   FrameArena arena;
+   TaskGraph graph;
+   addObjectFrame(graph, frame, recorder, [](ObjectFrame& frame) {
+      frame.angle += 1.0f;
+      frame.offset[0] = glm::vec3(0.1f, -0.1f, 0.0f);
+      frame.offset[1] = -frame.offset[0];
+   });
+
+   double best = 1e9;
+   for (int i = 0; i < FRAMES; ++i) {
+      arena.beginFrame();
+      frame.allocate(arena);
+      const auto start = Clock::now();
+      jobs.run(graph);
+      best = std::min(best, secondsSince(start));
+      for (unsigned worker = 0; worker < jobs.threads(); ++worker)
+         recorder.list(worker).clear();
+   }
+   return best;
+}
+
+int main(int argc, char* argv[]) {
+   const auto objects = argc > 1 ? std::size_t(std::atol(argv[1])) : std::size_t(100000);
+   const auto hardware = std::max(1u, std::thread::hardware_concurrency());
+   const auto maxThreads = argc > 2 ? unsigned(std::atoi(argv[2])) : std::max(16u, hardware);
+   printf("%u hardware threads\n", hardware);
+
+   printf("\nper-job overhead\n");
+   for (unsigned threads = 1; threads <= maxThreads; threads *= 2)
+      measureOverhead(threads);
+
+   printf("\nframe graph over %zu objects (best of 30 frames)\n", objects);
+   double single = 0;
+   for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+      const auto seconds = measureFrame(objects, threads);
+      if (threads == 1)
+         single = seconds;
+      printf("%2u threads: %8.3f ms/frame, %5.2fx speedup, %5.1f%% efficiency%s\n",
+         threads, seconds * 1000, single / seconds, 100 * single / seconds / threads,
+         threads > hardware ? " (more threads than hardware)" : "");
+   }
+   return 0;
+}
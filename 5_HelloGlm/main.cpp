@@ -1,6 +1,10 @@
 #include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <functional>
 #include <memory>
 #include <optional>
@@ -15,239 +19,472 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "allocation_tracker.h"
+#include "capture.h"
+#include "command_list.h"
+#include "context.h"
+#include "frame_stats.h"
+#include "geometry.h"
+#include "gpu_scene.h"
+#include "frame_memory.h"
+#include "headless.h"
+#include "instances.h"
+#include "job_system.h"
+#include "meshes.h"
+#include "mesh_streamer.h"
+#include "object_frame.h"
+#include "options.h"
+#include "profiler.h"
+#include "program_cache.h"
+#include "program_reflection.h"
+#include "regression.h"
+#include "render_queue.h"
+#include "scene_state.h"
+#include "shader_pipeline.h"
+#include "shader_reloader.h"
+#include "sim_clock.h"
+#include "stream_buffer.h"
+#include "surface.h"
+#include "texture_streamer.h"
 #include "util.h"
-#include "shaders.h"
 
 const GLint WIN_SIZE = 250;
 
-GLuint uniformModel;
-int directionX = 1;
-int directionY = 1;
-auto offsetX = 0.0f;
-auto offsetY = 0.0f;
-auto offsetMax = 0.5f;
-auto offsetIncrement = 5.0e-3f;
-
-auto rotSpeed = 50.f;
-
-GLuint createTriangle() {
-   GLuint vao = 0;
-   GLuint vbo = 0;
-
-   GLfloat vertices[] = {
-      -1.0, -1.0, 0.0,
-       1.0, -1.0, 0.0,
-       0.0,  1.0, 0.0
-   };
-
-   glGenVertexArrays(1, &vao);
-   glBindVertexArray(vao);
-
-      glGenBuffers(1, &vbo);
-      glBindBuffer(GL_ARRAY_BUFFER, vbo); 
-      glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-      glEnableVertexAttribArray(0);
-
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
-   glBindVertexArray(0);
-
-   return vao;
+// uniform block binding point of the Model block
+const GLuint MODEL_BINDING = 0;
+// Block bindings are not part of a program binary, so they are set on every load.
+void bindBlocks(GLuint program) {
+   ProgramReflection(program).bindBlock("Model", MODEL_BINDING);
 }
 
-GLuint createSquare() {
-   GLuint vao, vbo;
-
-   GLfloat vertices[] = {
-      -1.0, -1.0, 0.0,
-      -1.0,  1.0, 0.0,
-
-      -1.0,  1.0, 0.0,
-       1.0,  1.0, 0.0,
-
-       1.0,  1.0, 0.0,
-       1.0, -1.0, 0.0,
-
-       1.0, -1.0, 0.0,
-      -1.0, -1.0, 0.0
-   };
-
-   glGenVertexArrays(1, &vao);
-   glBindVertexArray(vao);
-
-   glGenBuffers(1, &vbo);
-   glBindBuffer(GL_ARRAY_BUFFER, vbo);
-   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-   glVertexAttribPointer(0, 3, GL_FLOAT, GL_TRUE, 0, 0);
-   glEnableVertexAttribArray(0);
-
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
-   glBindVertexArray(0);
-
-   return vao;
+// The objects of set as GpuScene objects of mesh.
+void appendGpuObjects(const InstanceSet& set, std::uint32_t mesh, std::vector<GpuObject>& objects) {
+   for (std::size_t i = 0; i < set.size(); ++i) {
+      GpuObject object;
+      object.position[0] = set.positionX[i];
+      object.position[1] = set.positionY[i];
+      object.position[2] = set.positionZ[i];
+      object.scale = set.scale[i];
+      object.axis[0] = set.axisX[i];
+      object.axis[1] = set.axisY[i];
+      object.axis[2] = set.axisZ[i];
+      object.phase = set.phase[i];
+      object.speed = set.speed[i];
+      object.mesh = mesh;
+      objects.push_back(object);
+   }
 }
 
-bool addShader(GLuint program, const char* shaderCode, GLenum shaderType) {
-   GLuint shader = glCreateShader(shaderType);
-
-   const GLchar* code[1];
-   code[0] = shaderCode;
+int main(int argc, char* argv[]) {
+   const auto options = parseOptions(argc, argv);
 
-   GLint codeLength[1];
-   codeLength[0] = strlen(shaderCode);
+   std::srand(options.seed.value_or(unsigned(time(nullptr))));
+   SceneState sceneState;
+   sceneState.seedOffsets();
 
-   glShaderSource(shader, 1, code, codeLength);
-   glCompileShader(shader);
-
-   GLint result = 0;
-   GLchar log[1024] = "";
+   //init glfw, or EGL when running headless
+   ContextGuard glfwContext(
+      options.headless ? headlessInit : glfwInit,
+      options.headless ? headlessTerminate : glfwTerminate);
+   const auto ret = glfwContext.getInitStatus();
+   if (ret != GLFW_TRUE)
+      return ret;
 
-   glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
-   if (!result) {
-      glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
-      printf("Error compiling shader: '%s'\n", log);
-      return false;
-   }
+   //make glfw window, or an offscreen framebuffer when running headless
+   window_ptr mainWindow;
+   std::unique_ptr<Surface> surface;
+   // compute shaders and indirect draws of the GPU-driven mode need 4.3
+   const auto glMajor = options.gpuDriven ? 4 : 3;
+   const auto glMinor = 3;
+   if (options.headless)
+      surface = makeWindow_headless(WIN_SIZE, WIN_SIZE, glMajor, glMinor);
+   else {
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, glMajor);
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, glMinor);
+      glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+      glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 
-   glAttachShader(program, shader);
-   return true;
-}
+      mainWindow = makeWindow_glfw(WIN_SIZE, WIN_SIZE, "MainWindow", nullptr, nullptr);
 
-std::optional<GLuint> compileShaders(){
-   auto shaderId = glCreateProgram();
-   if (!shaderId) {
-      printf("Error creating shader program");
-      return {};
+      // create gl context
+      glfwMakeContextCurrent(mainWindow.get());
+      surface = std::make_unique<GlfwSurface>(mainWindow.get());
    }
+   if (!surface)
+      return -1;
 
-   auto ret = true;
-   ret &= addShader(shaderId, vShader, GL_VERTEX_SHADER);
-   ret &= addShader(shaderId, fShader, GL_FRAGMENT_SHADER);
+   // intit glew
+   if (const auto ret = initGlew(); ret != GLEW_OK)
+      return ret;
 
-   GLint result = 0;
-   GLchar log[1024] = "";
+   int bufferWidth, bufferHeight;
+   surface->getFramebufferSize(&bufferWidth, &bufferHeight);
+   glViewport(0, 0, bufferWidth, bufferHeight);
 
-   glLinkProgram(shaderId);
-   glGetProgramiv(shaderId, GL_LINK_STATUS, &result);
-   if (!result) {
-      glGetProgramInfoLog(shaderId, sizeof(log), nullptr, log);
-      printf("Error linking program: '%s'\n", log);
-      ret = false;
+   GeometryRegistry geometry(parseVertexType(options.vertexFormat));
+   const auto triangle = createTriangle(geometry);
+   const auto square = createSquare(geometry);
+
+   // programs build in the background, the fallback draws until they are ready
+   ProgramCache programCache(options.shaderCache ? options.shaderCache : "");
+   ShaderPipeline shaders(&programCache);
+   const auto fallback = shaders.submit({ { GL_VERTEX_SHADER, FALLBACK_VERTEX_SHADER }, { GL_FRAGMENT_SHADER, FALLBACK_FRAGMENT_SHADER } });
+   // the sample's shaders are files, rebuilt on the fly when edited
+   ShaderReloader reloader(shaders, options.shaderDir ? options.shaderDir : PLAYGROUND_SHADER_DIR, options.watchShaders);
+   const auto program = reloader.add({ { GL_VERTEX_SHADER, options.instances || options.gpuDriven ? "instanced.vert" : "model.vert" },
+      { GL_FRAGMENT_SHADER, options.texturePath && !options.gpuDriven ? "textured.frag" : "red.frag" } }, bindBlocks);
+   if (!program)
+      return -1;
+   if (!shaders.wait(fallback))
+      return -1;
+
+   // GPU-driven mode: objects stay on the GPU, culled and drawn without the CPU touching them
+   GpuScene scene;
+   ProgramHandle cullProgram = 0;
+   if (options.gpuDriven) {
+      const auto count = options.instances ? options.instances : 100000;
+      std::vector<GpuObject> objects;
+      // spread over twice the viewport, so about a quarter survives culling
+      appendGpuObjects(makeInstances(count, glm::vec3(0.0f, 0.0f, 1.0f), 1.0f, 2.0f), 0, objects);
+      appendGpuObjects(makeInstances(count, glm::vec3(1.0f, 1.0f, 1.0f), -1.0f, 2.0f), 1, objects);
+      const MeshHandle meshes[] = { triangle, square };
+      if (!scene.create(geometry, meshes, objects))
+         return -1;
+
+      cullProgram = shaders.submit({ { GL_COMPUTE_SHADER, GPU_CULL_COMPUTE_SHADER } });
+      if (!shaders.wait(cullProgram))
+         return -1;
+      printf("GPU-driven: %lu objects per shape\n", count);
    }
 
-   glValidateProgram(shaderId);
-   glLinkProgram(shaderId);
-   glGetProgramiv(shaderId, GL_VALIDATE_STATUS, &result);
-   if (!result) {
-      glGetProgramInfoLog(shaderId, sizeof(log), nullptr, log);
-      printf("Error validating program: '%s'\n", log);
-      ret = false;
+   // instanced mode: one draw per shape, model matrices streamed as per-instance attributes
+   const auto instanceCount = options.gpuDriven ? 0 : GLsizei(options.instances);
+   const auto instanceBytes = 2 * GLsizeiptr(instanceCount) * GLsizeiptr(sizeof(glm::mat4));
+   InstanceSet triangleInstances;
+   InstanceSet squareInstances;
+   if (instanceCount) {
+      triangleInstances = makeInstances(instanceCount, glm::vec3(0.0f, 0.0f, 1.0f), 1.0f);
+      squareInstances = makeInstances(instanceCount, glm::vec3(1.0f, 1.0f, 1.0f), -1.0f);
+      printf("Instanced: %d objects per shape\n", instanceCount);
    }
-
-   uniformModel = glGetUniformLocation(shaderId, "model");
-
-   if (ret)
-      return shaderId;
-   else {
-      glDeleteShader(shaderId);
-      return {};
+   else if (!options.gpuDriven)
+      // one VAO for both shapes; instancing needs the per-mesh VAOs, they carry the instance attributes
+      geometry.merge();
+
+   // per-object mode: a draw and a model uniform slice per object, each frame a task graph over every core
+   const auto objectCount = options.gpuDriven || instanceCount ? 0 : std::size_t(options.objects);
+   JobSystem jobs(objectCount ? options.threads : 1);
+   ParallelRecorder recorder(jobs);
+   ObjectFrame objects;
+   if (objectCount) {
+      objects.shapes[0] = makeInstances(objectCount, glm::vec3(0.0f, 0.0f, 1.0f), 1.0f);
+      objects.shapes[1] = makeInstances(objectCount, glm::vec3(1.0f, 1.0f, 1.0f), -1.0f);
+      objects.radius[0] = geometry.get(triangle).radius;
+      objects.radius[1] = geometry.get(square).radius;
+      objects.ranges[0] = geometry.range(triangle);
+      objects.ranges[1] = geometry.range(square);
+      recorder.reserve(objects.size());
+      printf("Per-object draws: %zu objects per shape, prepared on %u threads\n", objectCount, jobs.threads());
    }
-}
-
-
-int main() {
-   std::srand(time(nullptr));
-   offsetX = float(rand() % 100) / 100 - 0.5;
-   offsetY = float(rand() % 100) / 100 - 0.5;
-
-   //init glew
-   ContextGuard glfwContext(glfwInit, glfwTerminate);
-   const auto ret = glfwContext.getInitStatus();
-   if (ret != GLFW_TRUE)
-      return ret;
-
-   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-   glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-
-   //make glfw window
-   auto mainWindow = makeWindow_glfw(WIN_SIZE, WIN_SIZE, "MainWindow", nullptr, nullptr);
-
-   int bufferWidth, bufferHeight;
-   glfwGetFramebufferSize(mainWindow.get(), &bufferWidth, &bufferHeight);
-   glViewport(0, 0, bufferWidth, bufferHeight);
+   // all per-frame data goes through one persistently mapped ring
+   const auto uniformAlignment = uniformBufferAlignment();
+   const auto modelStride = (GLsizeiptr(sizeof(glm::mat4)) + uniformAlignment - 1) & ~(uniformAlignment - 1);
+   StreamBuffer stream;
+   if (!stream.create(2 * modelStride + instanceBytes + 2 * GLsizeiptr(objectCount) * modelStride))
+      return -1;
+
+   sceneState.seedClearColor();
+
+   Profiler profiler;
+   if (options.profilePath && !profiler.open(options.profilePath))
+      return -1;
+
+   // fixed-rate simulation, rendered between its last two ticks
+   SimulationClock clock(SceneState::TICK_SECONDS);
+   auto lastTime = surface->getTime();
+   const auto simulate = [&] {
+      const auto now = surface->getTime();
+      const auto steps = clock.advance(options.frameTime > 0 ? options.frameTime : now - lastTime);
+      lastTime = now;
+      for (unsigned step = 0; step < steps; ++step)
+         sceneState.tick();
+   };
 
-   // create gl context
-   glfwMakeContextCurrent(mainWindow.get());
+   // --mesh: read on a loader thread, uploaded a budget per frame, drawn in
+   // place of the square once all of it is on the GPU, at the square's size
+   MeshStreamer streamer(geometry, GLsizeiptr(options.uploadBudget));
+   std::optional<std::size_t> streamedMesh;
+   auto squareMesh = square;
+   auto squareScale = 1.0f;
+   if (options.meshPath && options.gpuDriven)
+      printf("--mesh is ignored with --gpu-driven, its scene is built up front\n");
+   else if (options.meshPath) {
+      if (!streamer.create())
+         return -1;
+      streamedMesh = streamer.load(options.meshPath);
+   }
 
-   // intit glew
-   glewExperimental = GL_TRUE;
-   if (const auto ret = glewInit(); ret != GLEW_OK)
-      return ret;
+   // --textures: every KTX2/DDS file of the directory, shape i (object i) drawn
+   // with texture i; mip tails arrive first, finer levels as the budget allows
+   TextureStreamer textures(GLsizeiptr(options.uploadBudget), options.vramCap);
+   std::vector<TextureHandle> textureHandles;
+   if (options.texturePath && options.gpuDriven)
+      printf("--textures is ignored with --gpu-driven, its shaders do not sample\n");
+   else if (options.texturePath) {
+      std::vector<std::filesystem::path> paths;
+      std::error_code error;
+      for (const auto& entry : std::filesystem::directory_iterator(options.texturePath, error)) {
+         auto extension = entry.path().extension().string();
+         std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+         if (extension == ".ktx2" || extension == ".dds")
+            paths.push_back(entry.path());
+      }
+      if (paths.empty()) {
+         printf("No .ktx2 or .dds files in '%s'\n", options.texturePath);
+         return -1;
+      }
+      std::sort(paths.begin(), paths.end());
+      if (!textures.create())
+         return -1;
+      for (const auto& path : paths)
+         textureHandles.push_back(textures.load(path));
+      objects.textures = &textures;
+      objects.textureHandles = textureHandles;
+      printf("Textures: streaming %zu files from '%s', at most %.0f MB resident\n",
+         paths.size(), options.texturePath, options.vramCap / (1024.0 * 1024.0));
+   }
+   const auto shapeTexture = [&](std::size_t shape) -> GLuint {
+      return textureHandles.empty() ? 0 : textures.use(textureHandles[shape % textureHandles.size()]);
+   };
 
-   const auto triangleVao = createTriangle();
-   const auto squareVao = createSquare();   
+   // draws go out sorted by state, binds already in place are skipped
+   RenderQueue queue;
+   queue.reserve(2 + objects.size());
+
+   // simulate -> transforms -> cull -> record on the workers, submitted on this thread
+   TaskGraph frameGraph;
+   if (objectCount)
+      addObjectFrame(frameGraph, objects, recorder, [&](ObjectFrame& frame) {
+         simulate();
+         const auto alpha = clock.alpha();
+         const auto angle = SceneState::angle(clock.time());
+         frame.angle = angle;
+         frame.offset[0] = sceneState.triangleOffset(alpha);
+         frame.offset[1] = sceneState.squareOffset(alpha);
+         frame.scaleFactor[0] = SceneState::pulse(angle);
+         frame.scaleFactor[1] = squareScale;
+      });
+
+   // per-frame scratch; after warm-up a frame allocates nothing from the heap
+   FrameArena frameArena;
+   AllocationCheck allocations(options);
+
+   RegressionCheck check(options);
+   FrameCapture capture(options);
+   FrameRateCounter frameRate(options.frames);
+   for (unsigned long i = 0; !surface->shouldClose() && options.keepRunning(i); ++i) {
+      allocations.beginFrame(i);
+      profiler.beginFrame();
+      frameArena.beginFrame();
+
+      // a broken shader file is fatal only when nobody can fix it while we run
+      shaders.poll();
+      reloader.poll();
+      const auto current = reloader.handle(*program);
+      if (shaders.failed(current) && !reloader.watching())
+         return -1;
+      const auto shaderId = shaders.program(shaders.ready(current) ? current : fallback);
+
+      if (streamedMesh) {
+         ProfileScope scope(profiler, "mesh upload");
+         streamer.update();
+         if (const auto mesh = streamer.handle(*streamedMesh)) {
+            const auto& streamed = geometry.get(*mesh);
+            squareMesh = *mesh;
+            squareScale = streamed.positionScale * geometry.get(square).radius / std::max(streamed.radius, 1e-6f);
+            // adding it dropped the merged buffers; both rebind VAOs behind the queue's back
+            if (!instanceCount)
+               geometry.merge();
+            queue.state().invalidate();
+            // the radius of what the vertices hold, the scale above takes it to the square's
+            objects.radius[1] = streamed.radius / streamed.positionScale;
+            objects.ranges[0] = geometry.range(triangle);
+            objects.ranges[1] = geometry.range(squareMesh);
+            streamedMesh.reset();
+         }
+         else if (streamer.failed(*streamedMesh))
+            streamedMesh.reset();
+      }
+      if (!textureHandles.empty()) {
+         ProfileScope scope(profiler, "texture upload");
+         textures.update(queue.state());
+      }
+
+      // an exhausted stream slice is counted in its stats and skips the frame's draws
+      auto streamed = true;
+      if (objectCount) {
+         stream.beginFrame();
+         const auto range = stream.allocate(2 * GLsizeiptr(objectCount) * modelStride, uniformAlignment);
+         streamed = range.data != nullptr;
+         objects.program = shaderId;
+         objects.uniformIndex = MODEL_BINDING;
+         objects.uniformBuffer = stream.get();
+         objects.uniforms = range.data;
+         objects.uniformOffset = range.offset;
+         objects.uniformStride = modelStride;
+         objects.allocate(frameArena);
+         ProfileScope scope(profiler, "frame graph");
+         if (streamed)
+            jobs.run(frameGraph);
+         stream.endWrites();
+      }
+      else {
+         ProfileScope scope(profiler, "simulate");
+         simulate();
+      }
+      // everything drawn is taken between the last two ticks
+      const auto alpha = clock.alpha();
+      const auto time = clock.time();
+
+      const auto clearColor = sceneState.clearColor(time);
+      glClearColor(clearColor.r, clearColor.g, clearColor.b, clearColor.a);
+
+      if (options.gpuDriven) {
+         const auto angle = SceneState::angle(time);
+         const auto triangleOffset = sceneState.triangleOffset(alpha);
+         const auto squareOffset = sceneState.squareOffset(alpha);
+         scene.setMeshTransform(0, glm::value_ptr(triangleOffset), SceneState::pulse(angle), angle);
+         scene.setMeshTransform(1, glm::value_ptr(squareOffset), 1.0f, angle);
+         {
+            ProfileScope scope(profiler, "cull");
+            scene.cull(queue.state(), shaders.program(cullProgram));
+         }
+         {
+            ProfileScope scope(profiler, "draw");
+            scene.draw(queue.state(), shaderId);
+         }
+      }
+      else if (instanceCount) {
+         const auto angle = SceneState::angle(time);
+         stream.beginFrame();
+         const auto range = stream.allocate(instanceBytes, sizeof(glm::mat4));
+         streamed = range.data != nullptr;
+         if (streamed) {
+            // matrices are composed straight into the mapped slice
+            ProfileScope scope(profiler, "matrix build");
+            const auto models = std::span(static_cast<glm::mat4*>(range.data), 2 * std::size_t(instanceCount));
+            buildModels(triangleInstances, angle, sceneState.triangleOffset(alpha), SceneState::pulse(angle), models.first(instanceCount));
+            buildModels(squareInstances, angle, sceneState.squareOffset(alpha), squareScale, models.subspan(instanceCount));
+         }
+
+         stream.endWrites();
+         if (streamed) {
+            ProfileScope scope(profiler, "instance upload");
+            geometry.setInstanceMatrices(triangle, stream.get(), range.offset);
+            geometry.setInstanceMatrices(squareMesh, stream.get(), range.offset + instanceBytes / 2);
+            // both leave VAO 0 bound
+            queue.state().invalidate();
+         }
+         if (streamed) {
+            ProfileScope scope(profiler, "draw");
+            const MeshHandle shapes[] = { triangle, squareMesh };
+            for (std::size_t shape = 0; shape < 2; ++shape) {
+               auto command = makeDrawCommand(shaderId, geometry.range(shapes[shape]), false, 0, shapeTexture(shape));
+               command.instances = instanceCount;
+               queue.submit(command);
+            }
+            queue.flush();
+         }
+         stream.endFrame();
+      }
+      else if (objectCount) {
+         ProfileScope scope(profiler, "draw");
+         if (streamed) {
+            recorder.replay(queue);
+            queue.flush();
+         }
+         stream.endFrame();
+      }
+      else {
+         glm::mat4 triangleModel;
+         glm::mat4 squareModel;
+         {
+            ProfileScope scope(profiler, "matrix build");
+            triangleModel = sceneState.triangleModel(alpha, time);
+            squareModel = sceneState.squareModel(alpha, time, squareScale);
+         }
+
+         stream.beginFrame();
+         StreamRange triangleRange;
+         StreamRange squareRange;
+         {
+            ProfileScope scope(profiler, "uniform upload");
+            triangleRange = stream.allocate(sizeof(glm::mat4), uniformAlignment);
+            squareRange = stream.allocate(sizeof(glm::mat4), uniformAlignment);
+            streamed = triangleRange.data && squareRange.data;
+            if (streamed) {
+               memcpy(triangleRange.data, glm::value_ptr(triangleModel), sizeof(glm::mat4));
+               memcpy(squareRange.data, glm::value_ptr(squareModel), sizeof(glm::mat4));
+            }
+            stream.endWrites();
+         }
+
+         if (streamed) {
+            ProfileScope scope(profiler, "draw");
+            const std::pair<MeshHandle, StreamRange> shapes[] = { { triangle, triangleRange }, { squareMesh, squareRange } };
+            for (std::size_t shape = 0; shape < 2; ++shape) {
+               const auto& [mesh, model] = shapes[shape];
+               auto command = makeDrawCommand(shaderId, geometry.range(mesh), false, 0, shapeTexture(shape));
+               command.uniformIndex = MODEL_BINDING;
+               command.uniformBuffer = stream.get();
+               command.uniformOffset = model.offset;
+               command.uniformSize = model.size;
+               queue.submit(command);
+            }
+            queue.flush();
+         }
+         stream.endFrame();
+      }
+
+      allocations.endFrame();
+
+      {
+         ProfileScope scope(profiler, "swap");
+         surface->pollEvents();
+         check.frame(i, *surface);
+         capture.frame(*surface);
+         surface->swapBuffers();
+         glClear(GL_COLOR_BUFFER_BIT);
+      }
+
+      profiler.endFrame();
+      frameRate.frame();
+   }
 
-   GLuint shaderId = 0;
-   if (auto ret = compileShaders(); !ret.has_value())
-      return(-1);
+   frameRate.print();
+   capture.finish();
+   capture.printStats();
+   clock.printStats();
+   stream.printStats();
+   if (options.gpuDriven)
+      scene.printStats();
    else
-      shaderId = ret.value();
-
-   float fiR = float(rand() % 360);
-   float fiG = float(rand() % 360);
-   float fiB = float(rand() % 360);
-   float speedCoeffR = float(rand() % 100) / 100 - 0.5;
-   float speedCoeffG = float(rand() % 100) / 100 - 0.5;
-   float speedCoeffB = float(rand() % 100) / 100 - 0.5;
-
-   for (unsigned long i = 0; !glfwWindowShouldClose(mainWindow.get()); ++i) {
-      const auto time = glfwGetTime();
-      glClearColor(
-         std::sin(toRadians(time * rotSpeed * speedCoeffR + fiR)), 
-         std::sin(toRadians(time * rotSpeed * speedCoeffG + fiG)), 
-         std::sin(toRadians(time * rotSpeed * speedCoeffB + fiB)), 
-         1.0
-      );
-
-      offsetX += directionX * offsetIncrement;
-      if(abs(offsetX) >= offsetMax)
-         directionX *= -1;
-      offsetY += directionY * offsetIncrement;
-      if(abs(offsetY) >= offsetMax)
-         directionY *= -1;
-
-      glm::mat4 model;
-
-      glUseProgram(shaderId);
-         model = glm::mat4(1.0f);
-         model = glm::translate(model, glm::vec3(offsetX, offsetY, 0.0f));
-         model = glm::rotate(model, toRadians(glfwGetTime()*rotSpeed), glm::vec3(0.0f, 0.f, 1.0f));
-         model = glm::scale(model, glm::vec3(0.5));
-         model = glm::scale(model, glm::vec3(1 + 0.2*abs(std::cos(toRadians(glfwGetTime()*rotSpeed)))));
-         glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-
-         glBindVertexArray(triangleVao);
-            glDrawArrays(GL_TRIANGLES, 0, 3);
-
-         model = glm::mat4(1.0f);
-         model = glm::translate(model, glm::vec3(-offsetY, -offsetX, 0.0f));
-         model = glm::rotate(model, toRadians(-glfwGetTime() * rotSpeed), glm::vec3(1.0f, 1.0f, 1.0f));
-         model = glm::scale(model, glm::vec3(0.5));
-         glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-         glBindVertexArray(squareVao);
-            glDrawArrays(GL_LINES, 0, 8);
-         glBindVertexArray(0);
-
-      glUseProgram(0);
-
-      glfwPollEvents();
-      glfwSwapBuffers(mainWindow.get());
-      glClear(GL_COLOR_BUFFER_BIT);
+      queue.printStats();
+   if (objectCount) {
+      frameGraph.printStats("Frame graph");
+      jobs.printStats("Frame jobs");
+      recorder.printStats();
    }
-
-   return 0;
+   shaders.printStats();
+   reloader.printStats();
+   programCache.printStats();
+   geometry.printStats();
+   if (options.meshPath && !options.gpuDriven)
+      streamer.printStats();
+   if (!textureHandles.empty())
+      textures.printStats();
+   frameArena.printStats("Frame arena");
+   allocations.printStats();
+
+   return check.finish(frameRate) | allocations.finish();
 }
@@ -0,0 +1,84 @@
+// Indexing savings and build time of buildIndexedMesh() on unindexed
+// triangle soups of UV spheres, the shape imported meshes arrive in, and
+// the size and precision of the compact vertex formats on the result.
+//
+// usage: MeshBuildBench [max segments=512]
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <stdio.h>
+#include <vector>
+
+#include "mesh_builder.h"
+#include "vertex_format.h"
+#include "util.h"
+
+// Unit sphere with segments x segments/2 quads, two triangles each, every
+// triangle listing its own three vertices.
+std::vector<float> makeSphereSoup(int segments) {
+   const auto rings = segments / 2;
+   const auto point = [&](int segment, int ring, std::vector<float>& out) {
+      const auto theta = toRadians(360.0f * float(segment % segments) / float(segments));
+      const auto phi = toRadians(180.0f * float(ring) / float(rings));
+      out.push_back(std::sin(phi) * std::cos(theta));
+      out.push_back(std::cos(phi));
+      out.push_back(std::sin(phi) * std::sin(theta));
+   };
+
+   std::vector<float> vertices;
+   vertices.reserve(std::size_t(segments) * rings * 18);
+   for (int ring = 0; ring < rings; ++ring)
+      for (int segment = 0; segment < segments; ++segment) {
+         point(segment, ring, vertices);
+         point(segment, ring + 1, vertices);
+         point(segment + 1, ring + 1, vertices);
+         point(segment, ring, vertices);
+         point(segment + 1, ring + 1, vertices);
+         point(segment + 1, ring, vertices);
+      }
+   return vertices;
+}
+
+// Position and normal of every vertex of mesh in each layout.
+void compareFormats(const IndexedMesh& mesh) {
+   std::vector<float> normals(mesh.vertices.size());
+   for (std::size_t i = 0; i < mesh.vertices.size(); i += 3) {
+      const auto length = std::sqrt(mesh.vertices[i] * mesh.vertices[i] + mesh.vertices[i + 1] * mesh.vertices[i + 1] + mesh.vertices[i + 2] * mesh.vertices[i + 2]);
+      for (std::size_t c = 0; c < 3; ++c)
+         normals[i + c] = mesh.vertices[i + c] / length;
+   }
+
+   const VertexLayout layouts[] = {
+      { { 0, VertexType::Float32, 3, "position" }, { 1, VertexType::Float32, 3, "normal" } },
+      { { 0, VertexType::Half, 3, "position" }, { 1, VertexType::Snorm10, 3, "normal" } },
+      { { 0, VertexType::Snorm16, 3, "position" }, { 1, VertexType::Snorm10, 3, "normal" } },
+   };
+   const auto floatBytes = layouts[0].stride() * mesh.vertexCount();
+   for (const auto& layout : layouts) {
+      std::vector<QuantizationError> errors;
+      const auto bytes = layout.pack({ mesh.vertices, normals }, mesh.vertexCount(), &errors);
+      printf("   %d bytes per vertex, %zu bytes (%.2fx smaller)\n", layout.stride(), bytes.size(), double(floatBytes) / bytes.size());
+      layout.printErrors("   ", errors);
+   }
+}
+
+int main(int argc, char* argv[]) {
+   const int maxSegments = argc > 1 ? std::atoi(argv[1]) : 512;
+
+   for (int segments = 32; segments <= maxSegments; segments *= 4) {
+      const auto soup = makeSphereSoup(segments);
+
+      const auto start = std::chrono::steady_clock::now();
+      const auto mesh = buildIndexedMesh(soup, 3);
+      const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      char name[64];
+      snprintf(name, sizeof(name), "sphere %d, %zu triangles", segments, mesh.stats.primitives);
+      mesh.stats.print(name);
+      printf("   %s indices, built in %.3f ms (%.1f Mtriangles/s)\n",
+         mesh.shortIndices() ? "16-bit" : "32-bit", seconds * 1000, mesh.stats.primitives / seconds / 1e6);
+      compareFormats(mesh);
+   }
+   return 0;
+}
@@ -0,0 +1,323 @@
+// Converts an OBJ or PLY model into the binary mesh file HelloGlm --mesh
+// streams in (mesh_file.h): triangulated, deduplicated and cache ordered by
+// buildIndexedMesh(), positions stored in the given vertex format. Only
+// positions are kept, as the registry draws nothing else. Reports how fast
+// each step went, reading the result back through a mapping as the loader
+// thread does.
+//
+// usage: MeshConvert input.obj|input.ply output [float|half|snorm16|snorm10]
+
+#include <GL/glew.h>
+
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <stdio.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "file_loader.h"
+#include "mesh_builder.h"
+#include "mesh_file.h"
+#include "vertex_format.h"
+
+// Triangle soup of an OBJ: every v, every f fanned into triangles. Indices
+// may be negative (relative) and carry /texture/normal parts, which are skipped.
+std::optional<std::vector<float>> readObj(const std::string& text, const char* name) {
+   std::vector<float> positions;
+   std::vector<float> soup;
+   std::vector<long> face;
+   std::istringstream lines(text);
+   std::string line;
+   for (unsigned long number = 1; std::getline(lines, line); ++number) {
+      const char* cursor = line.c_str();
+      if (line.starts_with("v ")) {
+         cursor += 2;
+         for (int i = 0; i < 3; ++i) {
+            char* end;
+            positions.push_back(std::strtof(cursor, &end));
+            if (end == cursor) {
+               printf("%s:%lu: a vertex needs x y z\n", name, number);
+               return std::nullopt;
+            }
+            cursor = end;
+         }
+      }
+      else if (line.starts_with("f ")) {
+         face.clear();
+         cursor += 2;
+         for (;;) {
+            char* end;
+            const auto index = std::strtol(cursor, &end, 10);
+            if (end == cursor)
+               break;
+            const auto count = long(positions.size() / 3);
+            const auto vertex = index < 0 ? count + index : index - 1;
+            if (index == 0 || vertex < 0 || vertex >= count) {
+               printf("%s:%lu: face index %ld is out of range\n", name, number, index);
+               return std::nullopt;
+            }
+            face.push_back(vertex);
+            cursor = end;
+            while (*cursor && *cursor != ' ' && *cursor != '\t')
+               ++cursor;
+         }
+         for (std::size_t i = 1; i + 1 < face.size(); ++i)
+            for (const auto vertex : { face[0], face[i], face[i + 1] })
+               soup.insert(soup.end(), positions.begin() + 3 * vertex, positions.begin() + 3 * vertex + 3);
+      }
+   }
+   return soup;
+}
+
+// Triangle soup of a PLY, ascii or binary little endian: x y z of the
+// vertex element, the vertex_indices list of the face element fanned into
+// triangles; every other element and property is skipped.
+class PlyReader {
+public:
+   std::optional<std::vector<float>> read(const std::string& data, const char* name) {
+      mData = data;
+      mName = name;
+      if (!readHeader())
+         return std::nullopt;
+
+      std::vector<float> positions;
+      std::vector<float> soup;
+      std::vector<long> face;
+      for (const auto& element : mElements) {
+         for (unsigned long item = 0; item < element.count; ++item) {
+            float position[3] = {};
+            face.clear();
+            for (const auto& property : element.properties) {
+               const auto isPosition = element.name == "vertex" && property.name.size() == 1 && property.name[0] >= 'x' && property.name[0] <= 'z';
+               const auto isFace = element.name == "face" && (property.name == "vertex_indices" || property.name == "vertex_index");
+               if (!property.list) {
+                  const auto value = number(property.type);
+                  if (!value)
+                     return truncated();
+                  if (isPosition)
+                     position[property.name[0] - 'x'] = float(*value);
+                  continue;
+               }
+               const auto count = number(property.countType);
+               if (!count)
+                  return truncated();
+               for (long i = 0; i < long(*count); ++i) {
+                  const auto value = number(property.type);
+                  if (!value)
+                     return truncated();
+                  if (isFace)
+                     face.push_back(long(*value));
+               }
+            }
+
+            if (element.name == "vertex")
+               positions.insert(positions.end(), position, position + 3);
+            const auto vertexCount = long(positions.size() / 3);
+            for (std::size_t i = 1; i + 1 < face.size(); ++i)
+               for (const auto vertex : { face[0], face[i], face[i + 1] }) {
+                  if (vertex < 0 || vertex >= vertexCount) {
+                     printf("%s: face index %ld is out of range\n", mName, vertex);
+                     return std::nullopt;
+                  }
+                  soup.insert(soup.end(), positions.begin() + 3 * vertex, positions.begin() + 3 * vertex + 3);
+               }
+         }
+      }
+      return soup;
+   }
+
+private:
+   struct Property {
+      std::string name;
+      std::string type;
+      bool list = false;
+      std::string countType;
+   };
+
+   struct Element {
+      std::string name;
+      unsigned long count = 0;
+      std::vector<Property> properties;
+   };
+
+   bool readHeader() {
+      const auto end = mData.find("end_header");
+      if (!mData.starts_with("ply") || end == std::string::npos) {
+         printf("%s: not a PLY file\n", mName);
+         return false;
+      }
+      std::istringstream lines(std::string(mData.substr(0, end)));
+      std::string line;
+      while (std::getline(lines, line)) {
+         std::istringstream words(line);
+         std::string keyword;
+         words >> keyword;
+         if (keyword == "format") {
+            std::string format;
+            words >> format;
+            mBinary = format == "binary_little_endian";
+            if (!mBinary && format != "ascii") {
+               printf("%s: %s PLY files are not supported\n", mName, format.c_str());
+               return false;
+            }
+         }
+         else if (keyword == "element") {
+            auto& element = mElements.emplace_back();
+            words >> element.name >> element.count;
+         }
+         else if (keyword == "property" && !mElements.empty()) {
+            auto& property = mElements.back().properties.emplace_back();
+            words >> property.type;
+            if (property.type == "list") {
+               property.list = true;
+               words >> property.countType >> property.type;
+            }
+            words >> property.name;
+            if (!size(property.type) || (property.list && !size(property.countType))) {
+               printf("%s: unknown property type in '%s'\n", mName, line.c_str());
+               return false;
+            }
+         }
+      }
+      mCursor = mData.find('\n', end);
+      mCursor = mCursor == std::string::npos ? mData.size() : mCursor + 1;
+      return true;
+   }
+
+   static std::size_t size(std::string_view type) {
+      if (type == "char" || type == "uchar" || type == "int8" || type == "uint8")
+         return 1;
+      if (type == "short" || type == "ushort" || type == "int16" || type == "uint16")
+         return 2;
+      if (type == "int" || type == "uint" || type == "int32" || type == "uint32" || type == "float" || type == "float32")
+         return 4;
+      if (type == "double" || type == "float64")
+         return 8;
+      return 0;
+   }
+
+   // The next value of type in the body.
+   std::optional<double> number(std::string_view type) {
+      if (!mBinary) {
+         // the string behind mData ends in a 0, strtod stops there
+         const char* start = mData.data() + mCursor;
+         char* end;
+         const auto value = std::strtod(start, &end);
+         if (end == start)
+            return std::nullopt;
+         mCursor += std::size_t(end - start);
+         return value;
+      }
+
+      const auto bytes = size(type);
+      if (mCursor + bytes > mData.size())
+         return std::nullopt;
+      const auto* data = mData.data() + mCursor;
+      mCursor += bytes;
+      const auto load = [&](auto value) {
+         std::memcpy(&value, data, sizeof(value));
+         return double(value);
+      };
+      if (type == "char" || type == "int8")
+         return load(std::int8_t());
+      if (type == "uchar" || type == "uint8")
+         return load(std::uint8_t());
+      if (type == "short" || type == "int16")
+         return load(std::int16_t());
+      if (type == "ushort" || type == "uint16")
+         return load(std::uint16_t());
+      if (type == "int" || type == "int32")
+         return load(std::int32_t());
+      if (type == "uint" || type == "uint32")
+         return load(std::uint32_t());
+      if (type == "float" || type == "float32")
+         return load(float());
+      return load(double());
+   }
+
+   std::nullopt_t truncated() {
+      printf("%s: PLY body is shorter than its header says\n", mName);
+      return std::nullopt;
+   }
+
+   std::string_view mData;
+   const char* mName = "";
+   bool mBinary = false;
+   std::size_t mCursor = 0;
+   std::vector<Element> mElements;
+};
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+   return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double megabytes(std::size_t bytes) {
+   return double(bytes) / (1024 * 1024);
+}
+
+int main(int argc, char* argv[]) {
+   if (argc < 3) {
+      printf("usage: %s input.obj|input.ply output [float|half|snorm16|snorm10]\n", argv[0]);
+      return 1;
+   }
+   const std::filesystem::path input = argv[1];
+   const std::filesystem::path output = argv[2];
+   const auto positionType = parseVertexType(argc > 3 ? argv[3] : "float");
+
+   auto start = std::chrono::steady_clock::now();
+   std::ifstream stream(input, std::ios::binary);
+   if (!stream) {
+      printf("Cannot open '%s'\n", input.string().c_str());
+      return 1;
+   }
+   std::string data((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+   const auto name = input.string();
+   auto extension = input.extension().string();
+   for (auto& c : extension)
+      c = char(std::tolower(c));
+   const auto soup = extension == ".ply" ? PlyReader().read(data, name.c_str()) : readObj(data, name.c_str());
+   if (!soup)
+      return 1;
+   if (soup->empty()) {
+      printf("%s: no faces\n", name.c_str());
+      return 1;
+   }
+   const auto parseSeconds = secondsSince(start);
+   printf("Read %s: %.2f MB in %.1f ms (%.1f MB/s), %zu triangles\n",
+      name.c_str(), megabytes(data.size()), parseSeconds * 1000, megabytes(data.size()) / parseSeconds, soup->size() / 9);
+
+   start = std::chrono::steady_clock::now();
+   const auto mesh = buildIndexedMesh(*soup, 3);
+   printf("Indexed in %.1f ms\n", secondsSince(start) * 1000);
+   mesh.stats.print(name.c_str());
+
+   start = std::chrono::steady_clock::now();
+   if (!writeMeshFile(output, mesh, GL_TRIANGLES, positionType))
+      return 1;
+   const auto writeSeconds = secondsSince(start);
+   const auto outputBytes = std::size_t(std::filesystem::file_size(output));
+   printf("Wrote %s: %s positions, %.2f MB (%.2fx smaller) in %.1f ms (%.1f MB/s)\n",
+      output.string().c_str(), toString(positionType), megabytes(outputBytes), double(data.size()) / outputBytes,
+      writeSeconds * 1000, megabytes(outputBytes) / writeSeconds);
+
+   // what the loader thread does: map, read every page in, check
+   start = std::chrono::steady_clock::now();
+   MappedFile file;
+   if (!file.open(output))
+      return 1;
+   file.prefetch();
+   if (!parseMeshFile(file.bytes(), output.string().c_str()))
+      return 1;
+   const auto mapSeconds = secondsSince(start);
+   printf("Read back %s in %.2f ms (%.1f MB/s)\n", file.mapped() ? "mapped" : "copied", mapSeconds * 1000,
+      megabytes(outputBytes) / mapSeconds);
+   return 0;
+}
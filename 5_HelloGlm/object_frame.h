@@ -0,0 +1,141 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "command_list.h"
+#include "frame_memory.h"
+#include "instances.h"
+#include "job_system.h"
+#include "render_queue.h"
+#include "texture_streamer.h"
+
+// The --objects scene, a draw per object, and what one frame of it needs.
+// Shape 0 is the triangle, shape 1 the square; object i of the frame is
+// object i of shape 0, then of shape 1.
+struct ObjectFrame {
+   InstanceSet shapes[2];
+   float radius[2] = { 1, 1 };   // bounding radius of the shape's mesh
+   MeshRange ranges[2];
+   // object i is drawn with textureHandles[i % size], no textures when textures is null
+   TextureStreamer* textures = nullptr;
+   std::span<const TextureHandle> textureHandles;
+
+   // written by the tasks, in frame memory
+   std::span<glm::mat4> models;
+   std::span<std::uint8_t> visible;
+
+   // set by the simulate task
+   float angle = 0;   // degrees
+   glm::vec3 offset[2] = {};
+   float scaleFactor[2] = { 1, 1 };
+
+   // set before every run: model matrices go stride bytes apart from
+   // uniforms, which is offset bytes into uniformBuffer
+   GLuint program = 0;
+   GLuint uniformIndex = 0;
+   GLuint uniformBuffer = 0;
+   void* uniforms = nullptr;
+   GLintptr uniformOffset = 0;
+   GLsizeiptr uniformStride = sizeof(glm::mat4);
+
+   std::size_t size() const {
+      return shapes[0].size() + shapes[1].size();
+   }
+
+   // takes this frame's outputs from arena, before every run
+   void allocate(FrameArena& arena) {
+      models = arena.allocate<glm::mat4>(size());
+      visible = arena.allocate<std::uint8_t>(size());
+   }
+};
+
+// Adds the frame of objects to graph as
+//    simulate -> transforms -> cull -> record
+// simulate(frame) advances the scene and fills in the per-frame values;
+// record leaves a draw per visible object in recorder's lists, which the
+// GL thread replays afterwards (submit).
+template <typename Simulate>
+void addObjectFrame(TaskGraph& graph, ObjectFrame& frame, ParallelRecorder& recorder, Simulate&& simulate) {
+   const auto simulateNode = graph.add("simulate", [&frame, simulate = std::forward<Simulate>(simulate)](unsigned) mutable {
+      simulate(frame);
+   });
+
+   // the batched kernel over each chunk, per shape
+   const auto transforms = graph.addParallelFor("transforms", frame.size(), 512, [&frame](std::size_t begin, std::size_t end, unsigned) {
+      const auto split = frame.shapes[0].size();
+      for (int shape = 0; shape < 2; ++shape) {
+         const auto first = shape ? std::max(begin, split) : begin;
+         const auto last = shape ? end : std::min(end, split);
+         if (first >= last)
+            continue;
+
+         auto& set = frame.shapes[shape];
+         const auto base = shape ? split : 0;
+         const auto from = first - base;
+         const auto count = last - first;
+         for (auto i = from; i < from + count; ++i)
+            set.angle[i] = toRadians(frame.angle * set.speed[i] + set.phase[i]);
+
+         TransformBatch batch;
+         batch.positionX = set.positionX.data() + from;
+         batch.positionY = set.positionY.data() + from;
+         batch.positionZ = set.positionZ.data() + from;
+         batch.axisX = set.axisX.data() + from;
+         batch.axisY = set.axisY.data() + from;
+         batch.axisZ = set.axisZ.data() + from;
+         batch.angle = set.angle.data() + from;
+         batch.scale = set.scale.data() + from;
+         batch.count = count;
+         batch.offset[0] = frame.offset[shape].x;
+         batch.offset[1] = frame.offset[shape].y;
+         batch.offset[2] = frame.offset[shape].z;
+         batch.scaleFactor = frame.scaleFactor[shape];
+         composeTransforms(batch, glm::value_ptr(frame.models[first]));
+      }
+   });
+
+   // bounding spheres against the clip cube; the sample draws without a projection
+   const auto cull = graph.addParallelFor("cull", frame.size(), 2048, [&frame](std::size_t begin, std::size_t end, unsigned) {
+      const auto split = frame.shapes[0].size();
+      for (auto i = begin; i < end; ++i) {
+         const auto shape = i < split ? 0 : 1;
+         const auto& set = frame.shapes[shape];
+         const auto radius = frame.radius[shape] * set.scale[i - (shape ? split : 0)] * frame.scaleFactor[shape];
+         const auto& center = frame.models[i][3];
+         frame.visible[i] = std::abs(center.x) - radius <= 1 && std::abs(center.y) - radius <= 1 && std::abs(center.z) - radius <= 1;
+      }
+   });
+
+   // the object index in the depth bits keeps the draw order fixed, whichever worker recorded it
+   const auto record = graph.addParallelFor("record", frame.size(), 64, [&frame, &recorder](std::size_t begin, std::size_t end, unsigned worker) {
+      auto& list = recorder.list(worker);
+      const auto split = frame.shapes[0].size();
+      const auto total = float(frame.size());
+      for (auto i = begin; i < end; ++i) {
+         if (!frame.visible[i])
+            continue;
+         std::memcpy(static_cast<char*>(frame.uniforms) + i * frame.uniformStride, glm::value_ptr(frame.models[i]), sizeof(glm::mat4));
+
+         const auto texture = frame.textures ? frame.textures->use(frame.textureHandles[i % frame.textureHandles.size()]) : 0;
+         auto command = makeDrawCommand(frame.program, frame.ranges[i < split ? 0 : 1], false, float(i) / total, texture);
+         command.uniformIndex = frame.uniformIndex;
+         command.uniformBuffer = frame.uniformBuffer;
+         command.uniformOffset = frame.uniformOffset + GLintptr(i) * frame.uniformStride;
+         command.uniformSize = sizeof(glm::mat4);
+         list.record(command);
+      }
+   });
+
+   graph.precede(simulateNode, transforms);
+   graph.precede(transforms, cull);
+   graph.precede(cull, record);
+}
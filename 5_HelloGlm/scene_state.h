@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cmath>
+#include <cstdlib>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "sim_clock.h"
+#include "util.h"
+
+// HelloGlm's two-object scene without GL: the offsets bouncing on the
+// fixed-rate simulation, the cycling clear colour and the model matrices.
+// main.cpp draws it with GL and SoftRasterBench on the software rasterizer,
+// so with the same --seed and --frame-time both render the same frames.
+struct SceneState {
+   // simulation rate; OFFSET_INCREMENT is per tick
+   static constexpr double TICK_SECONDS = 1.0 / 60;
+   static constexpr float OFFSET_MAX = 0.5f;
+   static constexpr float OFFSET_INCREMENT = 5.0e-3f;
+   // degrees per second
+   static constexpr float ROT_SPEED = 50.f;
+
+   Interpolated<float> offsetX;
+   Interpolated<float> offsetY;
+   int directionX = 1;
+   int directionY = 1;
+   // per channel phase in degrees and speed of the clear colour
+   float colorPhase[3] = {};
+   float colorSpeed[3] = {};
+
+   // Starting offsets from rand(), right after srand().
+   void seedOffsets() {
+      offsetX.reset(float(rand() % 100) / 100 - 0.5);
+      offsetY.reset(float(rand() % 100) / 100 - 0.5);
+   }
+
+   // The clear colour from rand(); HelloGlm makes its instance sets in
+   // between, so a seed keeps giving the scene it always gave.
+   void seedClearColor() {
+      for (auto& phase : colorPhase)
+         phase = float(rand() % 360);
+      for (auto& speed : colorSpeed)
+         speed = float(rand() % 100) / 100 - 0.5;
+   }
+
+   // One fixed simulation step: bounce the offsets between -OFFSET_MAX and OFFSET_MAX.
+   void tick() {
+      offsetX.save();
+      offsetY.save();
+
+      offsetX.current += directionX * OFFSET_INCREMENT;
+      if (std::abs(offsetX.current) >= OFFSET_MAX)
+         directionX *= -1;
+      offsetY.current += directionY * OFFSET_INCREMENT;
+      if (std::abs(offsetY.current) >= OFFSET_MAX)
+         directionY *= -1;
+   }
+
+   // Rotation in degrees at simulated time.
+   static float angle(double time) {
+      return float(time * ROT_SPEED);
+   }
+
+   // The triangle's scale at a rotation.
+   static float pulse(float angle) {
+      return float(1 + 0.2 * std::abs(std::cos(toRadians(angle))));
+   }
+
+   glm::vec3 triangleOffset(float alpha) const {
+      return glm::vec3(offsetX.at(alpha), offsetY.at(alpha), 0.0f);
+   }
+
+   glm::vec3 squareOffset(float alpha) const {
+      return glm::vec3(-offsetY.at(alpha), -offsetX.at(alpha), 0.0f);
+   }
+
+   glm::vec4 clearColor(double time) const {
+      return glm::vec4(
+         std::sin(toRadians(time * ROT_SPEED * colorSpeed[0] + colorPhase[0])),
+         std::sin(toRadians(time * ROT_SPEED * colorSpeed[1] + colorPhase[1])),
+         std::sin(toRadians(time * ROT_SPEED * colorSpeed[2] + colorPhase[2])),
+         1.0f);
+   }
+
+   glm::mat4 triangleModel(float alpha, double time) const {
+      auto model = glm::translate(glm::mat4(1.0f), triangleOffset(alpha));
+      model = glm::rotate(model, toRadians(angle(time)), glm::vec3(0.0f, 0.f, 1.0f));
+      model = glm::scale(model, glm::vec3(0.5));
+      return glm::scale(model, glm::vec3(pulse(angle(time))));
+   }
+
+   // squareScale takes a streamed mesh to the square's size.
+   glm::mat4 squareModel(float alpha, double time, float squareScale = 1.0f) const {
+      auto model = glm::translate(glm::mat4(1.0f), squareOffset(alpha));
+      model = glm::rotate(model, toRadians(-angle(time)), glm::vec3(1.0f, 1.0f, 1.0f));
+      return glm::scale(model, glm::vec3(0.5f * squareScale));
+   }
+};
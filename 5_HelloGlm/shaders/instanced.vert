@@ -0,0 +1,14 @@
+#version 330
+// model matrix per instance in locations 1-4
+layout (location = 0) in vec3 pos;
+layout (location = 1) in mat4 model;
+
+// planar mapping of the model's xy plane, for textured.frag
+out vec2 uv;
+
+#include "transform.glsl"
+
+void main(){
+    gl_Position = transform(model, pos);
+    uv = pos.xy * 0.5 + 0.5;
+}
@@ -0,0 +1,9 @@
+#version 330
+// bound on texture unit 0, see TextureStreamer
+uniform sampler2D albedo;
+in vec2 uv;
+out vec4 color;
+
+void main(){
+   color = texture(albedo, uv);
+}
@@ -0,0 +1,4 @@
+// shared by the vertex shaders: position in clip space
+vec4 transform(mat4 model, vec3 pos){
+    return model * vec4(pos, 1.0);
+}
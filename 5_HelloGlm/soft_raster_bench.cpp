@@ -0,0 +1,87 @@
+// HelloGlm's scene on the software rasterizer, no GL needed: the same seeded
+// simulation, clear colour and model matrices (scene_state.h), so a run with
+// HelloGlm's --seed and --frame-time renders HelloGlm's frames, and --golden
+// checks the last one against HelloGlm's golden image.
+//
+// usage: SoftRasterBench [--instances N] [--frames N (default: 200)] [--frame-time MS (default: 16.6667)]
+//                        [--seed N] [--threads N] [--screenshot FILE] [--golden FILE]
+
+#include <cstdlib>
+#include <stdio.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "frame_stats.h"
+#include "instances.h"
+#include "options.h"
+#include "regression.h"
+#include "scene_state.h"
+#include "shapes.h"
+#include "sim_clock.h"
+#include "soft_raster.h"
+
+const int WIN_SIZE = 250;
+
+int main(int argc, char* argv[]) {
+   auto options = parseOptions(argc, argv);
+   if (options.frames == 0)
+      options.frames = 200;
+
+   SoftRasterizer raster(WIN_SIZE, WIN_SIZE, options.threads);
+   // red.frag's colour, written without blending
+   const auto red = SoftRasterizer::pack(1.0f, 0.0f, 0.0f, 0.5f);
+
+   // rand() in HelloGlm's order: offsets, instance sets, clear colour
+   std::srand(options.seed.value_or(2137));
+   SceneState sceneState;
+   sceneState.seedOffsets();
+   const auto instances = std::size_t(options.instances);
+   const auto triangles = makeInstances(instances, glm::vec3(0.0f, 0.0f, 1.0f), 1.0f);
+   const auto squares = makeInstances(instances, glm::vec3(1.0f, 1.0f, 1.0f), -1.0f);
+   sceneState.seedClearColor();
+   std::vector<glm::mat4> triangleModels(instances);
+   std::vector<glm::mat4> squareModels(instances);
+
+   SimulationClock clock(SceneState::TICK_SECONDS);
+   RegressionCheck check(options);
+   FrameRateCounter frameRate(options.frames);
+   for (unsigned long i = 0; options.keepRunning(i); ++i) {
+      const auto steps = clock.advance(options.frameTime > 0 ? options.frameTime : SceneState::TICK_SECONDS);
+      for (unsigned step = 0; step < steps; ++step)
+         sceneState.tick();
+      const auto alpha = clock.alpha();
+      const auto time = clock.time();
+
+      if (instances) {
+         const auto angle = SceneState::angle(time);
+         buildModelsGlm(triangles, angle, sceneState.triangleOffset(alpha), SceneState::pulse(angle), triangleModels);
+         buildModelsGlm(squares, angle, sceneState.squareOffset(alpha), 1.0f, squareModels);
+         for (const auto& model : triangleModels)
+            raster.draw(TRIANGLE_VERTICES, SoftPrimitive::Triangles, glm::value_ptr(model), red);
+         for (const auto& model : squareModels)
+            raster.draw(SQUARE_VERTICES, SoftPrimitive::Lines, glm::value_ptr(model), red);
+      }
+      else {
+         const auto triangleModel = sceneState.triangleModel(alpha, time);
+         const auto squareModel = sceneState.squareModel(alpha, time);
+         raster.draw(TRIANGLE_VERTICES, SoftPrimitive::Triangles, glm::value_ptr(triangleModel), red);
+         raster.draw(SQUARE_VERTICES, SoftPrimitive::Lines, glm::value_ptr(squareModel), red);
+      }
+
+      raster.flush();
+      check.frame(i, raster.width(), raster.height(), raster.pixels());
+
+      // HelloGlm clears after the swap, so a frame shows the colour set by the one before
+      const auto clearColor = sceneState.clearColor(time);
+      raster.clear(clearColor.r, clearColor.g, clearColor.b, clearColor.a);
+      frameRate.frame();
+   }
+
+   printf("%zu instances per shape\n", instances ? instances : 1);
+   frameRate.print();
+   raster.printStats();
+
+   return check.finish(frameRate);
+}
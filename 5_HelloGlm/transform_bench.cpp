@@ -0,0 +1,70 @@
+// Microbenchmark: batched TRS kernel (composeTransforms) against the per-object
+// glm::translate/rotate/scale chain HelloGlm used to run.
+//
+// usage: TransformBench [objects=100000] [iterations=200]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <stdio.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "instances.h"
+#include "transform.h"
+
+template <typename F>
+double nanosecondsPerObject(F&& buildFrame, std::size_t objects, int iterations) {
+   buildFrame(0);
+   const auto start = std::chrono::steady_clock::now();
+   for (int i = 0; i < iterations; ++i)
+      buildFrame(i);
+   const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+   return elapsed / (double(objects) * iterations);
+}
+
+float maxError(const std::vector<glm::mat4>& a, const std::vector<glm::mat4>& b) {
+   auto error = 0.0f;
+   for (std::size_t i = 0; i < a.size(); ++i)
+      for (int column = 0; column < 4; ++column)
+         for (int row = 0; row < 4; ++row)
+            error = std::max(error, std::abs(a[i][column][row] - b[i][column][row]));
+   return error;
+}
+
+int main(int argc, char* argv[]) {
+   const std::size_t objects = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+   const int iterations = argc > 2 ? std::atoi(argv[2]) : 200;
+
+   srand(2137);
+   auto set = makeInstances(objects, glm::vec3(1.0f, 1.0f, 1.0f), 1.0f);
+   const auto offset = glm::vec3(0.1f, -0.2f, 0.0f);
+
+   std::vector<glm::mat4> reference(objects);
+   std::vector<glm::mat4> models(objects);
+
+   const auto glmTime = nanosecondsPerObject([&](int i) {
+      buildModelsGlm(set, 1.5f * i, offset, 1.1f, reference);
+   }, objects, iterations);
+   printf("%zu objects, %d iterations\n", objects, iterations);
+   printf("%-8s %8.2f ns/object %8.1f Mobjects/s\n", "glm", glmTime, 1e3 / glmTime);
+
+   for (auto level : { SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2 }) {
+      if (level > detectSimdLevel())
+         continue;
+
+      const auto time = nanosecondsPerObject([&](int i) {
+         buildModels(set, 1.5f * i, offset, 1.1f, models, level);
+      }, objects, iterations);
+
+      buildModelsGlm(set, 12.5f, offset, 1.1f, reference);
+      buildModels(set, 12.5f, offset, 1.1f, models, level);
+
+      printf("%-8s %8.2f ns/object %8.1f Mobjects/s %6.2fx vs glm, max error %.2e\n",
+         toString(level), time, 1e3 / time, glmTime / time, maxError(reference, models));
+   }
+
+   return 0;
+}
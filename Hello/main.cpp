@@ -6,71 +6,71 @@
 #include <memory>
 #include <functional>
 
+#include "capture.h"
+#include "context.h"
+#include "frame_stats.h"
+#include "headless.h"
+#include "options.h"
+#include "regression.h"
+#include "surface.h"
+
 const GLint WIDTH = 800;
 const GLint HEIGHT = 600;
 
-using window_ptr = std::unique_ptr<GLFWwindow, std::function<void(GLFWwindow*)>>;
-
-template<typename ...Ts>
-window_ptr makeWindow_glfw(Ts... args) {
-   return window_ptr(glfwCreateWindow(std::forward<Ts>(args)...), glfwDestroyWindow);
-}
-
-struct [[nodiscard]] ContextGuard{
-   ContextGuard(
-      std::function<int(void)> initContext
-      , std::function<void(void)> terminateContext)
-      : mInitContextFun{ initContext }
-      , mTerminateContextFun{ terminateContext } {
-      mInitStatus = mInitContextFun();
-   }
-
-   ~ContextGuard() {
-      mTerminateContextFun();
-   }
+int main(int argc, char* argv[]) {
+   const auto options = parseOptions(argc, argv);
 
-   int getInitStatus() {
-      return mInitStatus;
-   }
-
-private: 
-   int mInitStatus;
-   std::function<int(void)> mInitContextFun;
-   std::function<void(void)> mTerminateContextFun;
-};
-
-int main() {
-   ContextGuard glfwContext(glfwInit, glfwTerminate);
+   ContextGuard glfwContext(
+      options.headless ? headlessInit : glfwInit,
+      options.headless ? headlessTerminate : glfwTerminate);
    const auto ret = glfwContext.getInitStatus();
    if (ret != GLFW_TRUE)
       return ret;
 
-   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
-   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-   glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+   window_ptr mainWindow;
+   std::unique_ptr<Surface> surface;
+   if (options.headless)
+      surface = makeWindow_headless(WIDTH, HEIGHT, 3, 2);
+   else {
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+      glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+      glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 
-   auto mainWindow = makeWindow_glfw(WIDTH, HEIGHT, "MainWindow", nullptr, nullptr);
+      mainWindow = makeWindow_glfw(WIDTH, HEIGHT, "MainWindow", nullptr, nullptr);
+      glfwMakeContextCurrent(mainWindow.get());
+      surface = std::make_unique<GlfwSurface>(mainWindow.get());
+   }
+   if (!surface)
+      return -1;
 
-   glfwMakeContextCurrent(mainWindow.get());
-   glewExperimental = GL_TRUE;
-   if (const auto ret = glewInit(); ret != GLEW_OK)
+   if (const auto ret = initGlew(); ret != GLEW_OK)
       return ret;
 
    int bufferWidth, bufferHeight;
-   glfwGetFramebufferSize(mainWindow.get(), &bufferWidth, &bufferHeight);
+   surface->getFramebufferSize(&bufferWidth, &bufferHeight);
    glViewport(0, 0, bufferHeight, bufferWidth);
 
-   for (unsigned long i = 0; !glfwWindowShouldClose(mainWindow.get()); ++i) {
+   RegressionCheck check(options);
+   FrameCapture capture(options);
+   FrameRateCounter frameRate(options.frames);
+   for (unsigned long i = 0; !surface->shouldClose() && options.keepRunning(i); ++i) {
       if(i & 0x80)
          glClearColor(0.0, 1.0, 0.0, 1.0);
       else
          glClearColor(0.0, 0.0, 1.0, 1.0);
 
-      glfwPollEvents();
-      glfwSwapBuffers(mainWindow.get());
+      surface->pollEvents();
+      check.frame(i, *surface);
+      capture.frame(*surface);
+      surface->swapBuffers();
       glClear(GL_COLOR_BUFFER_BIT);
+      frameRate.frame();
    }
 
-   return 0;
+   frameRate.print();
+   capture.finish();
+   capture.printStats();
+
+   return check.finish(frameRate);
 }
\ No newline at end of file
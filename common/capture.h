@@ -0,0 +1,383 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <stdio.h>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "gl_objects.h"
+#include "image.h"
+#include "options.h"
+#include "surface.h"
+
+// --capture: records every frame to a Y4M video (a path ending in .y4m) or to
+// a directory of numbered PNGs, without stalling the frame loop on readback.
+//
+// frame() reads the framebuffer into a pixel buffer object and places a fence
+// behind it; the copy completes on the GPU while the next frames render. Once
+// the fence has signalled, the slot goes to a worker thread that converts and
+// writes it. With ARB_buffer_storage the PBO is mapped once, persistently, and
+// the worker reads straight out of it; otherwise the GL thread maps the slot
+// and copies it out. The frame loop only waits when all SLOTS are still being
+// read back or encoded.
+//
+//    capture.frame(*surface);   // right before swapBuffers()
+//    ...
+//    capture.finish();          // while the context is still current
+class FrameCapture {
+public:
+   static constexpr unsigned SLOTS = 4;
+
+   explicit FrameCapture(const Options& options)
+      : mPath{ options.capturePath ? options.capturePath : "" }
+      , mY4m{ mPath.extension() == ".y4m" }
+      , mFps{ options.captureFps > 0 ? options.captureFps : options.frameTime > 0 ? 1 / options.frameTime : 60 } {
+   }
+
+   ~FrameCapture() {
+      finish();
+   }
+
+   FrameCapture(const FrameCapture&) = delete;
+   FrameCapture& operator=(const FrameCapture&) = delete;
+
+   bool enabled() const {
+      return !mPath.empty() && !mFailed && !mFinished;
+   }
+
+   // Starts the readback of the bound framebuffer, which holds the finished frame.
+   void frame(Surface& surface) {
+      if (!enabled())
+         return;
+
+      const auto start = clock::now();
+
+      int width, height;
+      surface.getFramebufferSize(&width, &height);
+      if (!mStarted && !open(width, height))
+         return;
+      if (width != mWidth || height != mHeight) {
+         // a video can't change size halfway through
+         ++mSkipped;
+         return;
+      }
+
+      collect(false);
+
+      auto& slot = mSlots[mNext];
+      if (slot.state.load(std::memory_order_acquire) == SlotState::Reading)
+         collect(true);
+      if (slot.state.load(std::memory_order_acquire) == SlotState::Encoding) {
+         const auto waitStart = clock::now();
+         std::unique_lock lock(mMutex);
+         ++mEncoderWaits;
+         mSlotFree.wait(lock, [&] { return slot.state.load(std::memory_order_acquire) == SlotState::Free; });
+         mEncoderWaitSeconds += seconds(clock::now() - waitStart);
+      }
+
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, mBuffer.get());
+      glPixelStorei(GL_PACK_ALIGNMENT, 4);
+      glReadPixels(0, 0, mWidth, mHeight, GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<void*>(offset(mNext)));
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+      slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      slot.frame = mFrames++;
+      slot.state.store(SlotState::Reading, std::memory_order_release);
+      mNext = (mNext + 1) % SLOTS;
+
+      const auto elapsed = seconds(clock::now() - start);
+      mFrameSeconds += elapsed;
+      mMaxFrameSeconds = std::max(mMaxFrameSeconds, elapsed);
+   }
+
+   // Waits for the frames still in flight and for the encoder to write them.
+   // Needs the context that frame() ran with.
+   void finish() {
+      if (!mStarted || mFinished)
+         return;
+
+      collect(true, true);
+      {
+         std::lock_guard lock(mMutex);
+         mStopping = true;
+      }
+      mWork.notify_one();
+      mWorker.join();
+
+      if (mPersistent) {
+         glBindBuffer(GL_PIXEL_PACK_BUFFER, mBuffer.get());
+         glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+         glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+      }
+      if (mOutput)
+         fclose(mOutput);
+      mOutput = nullptr;
+      mFinished = true;
+   }
+
+   void printStats() const {
+      if (mPath.empty())
+         return;
+
+      std::lock_guard lock(mMutex);
+      printf("Capture: %lu of %lu frames %dx%d to '%s' (%s, %s PBOs), frame loop %.3f ms/frame (max %.3f ms), "
+         "%lu readback waits (%.3f ms), %lu encoder waits (%.3f ms), encode %.3f ms/frame, %.1f MB/s, %lu skipped\n",
+         mEncoded, mFrames, mWidth, mHeight, mPath.string().c_str(), mY4m ? "y4m" : "png", mPersistent ? "persistent" : "mapped",
+         mFrames ? mFrameSeconds * 1000 / mFrames : 0.0, mMaxFrameSeconds * 1000,
+         mReadbackWaits, mReadbackWaitSeconds * 1000, mEncoderWaits, mEncoderWaitSeconds * 1000,
+         mEncoded ? mEncodeSeconds * 1000 / mEncoded : 0.0,
+         mEncodeSeconds > 0 ? mEncoded * double(frameBytes()) / mEncodeSeconds / 1e6 : 0.0, mSkipped);
+   }
+
+private:
+   using clock = std::chrono::steady_clock;
+
+   enum class SlotState {
+      // ready for the next readback
+      Free,
+      // glReadPixels issued, fence pending; owned by the GL thread
+      Reading,
+      // handed to the worker until it sets the slot Free again
+      Encoding,
+   };
+
+   struct Slot {
+      // read by the GL thread without mMutex, so the pixels it hands over are
+      // visible to whichever thread sees the new state
+      std::atomic<SlotState> state{ SlotState::Free };
+      GLsync fence = nullptr;
+      unsigned long frame = 0;
+      const std::uint32_t* pixels = nullptr;
+      // copy of the slot for drivers without persistent mapping
+      std::vector<std::uint32_t> copy;
+   };
+
+   static double seconds(clock::duration duration) {
+      return std::chrono::duration<double>(duration).count();
+   }
+
+   GLsizeiptr frameBytes() const {
+      return GLsizeiptr(mWidth) * mHeight * 4;
+   }
+
+   GLintptr offset(unsigned slot) const {
+      return GLintptr(slot) * frameBytes();
+   }
+
+   bool open(int width, int height) {
+      mWidth = width;
+      mHeight = height;
+
+      if (mY4m) {
+         mOutput = fopen(mPath.string().c_str(), "wb");
+         if (!mOutput) {
+            printf("Error opening '%s' for writing, capture disabled\n", mPath.string().c_str());
+            mFailed = true;
+            return false;
+         }
+         // 4:2:0, full range chroma sited like JPEG
+         fprintf(mOutput, "YUV4MPEG2 W%d H%d F%ld:1000 Ip A1:1 C420jpeg\n", mWidth, mHeight, long(mFps * 1000 + 0.5));
+      }
+      else {
+         std::error_code error;
+         std::filesystem::create_directories(mPath, error);
+         if (error) {
+            printf("Error creating '%s': %s, capture disabled\n", mPath.string().c_str(), error.message().c_str());
+            mFailed = true;
+            return false;
+         }
+      }
+
+      mPersistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+      if (mPersistent) {
+         const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+         mBuffer.allocateStorage(GL_PIXEL_PACK_BUFFER, frameBytes() * SLOTS, nullptr, flags | GL_CLIENT_STORAGE_BIT);
+         mMapped = static_cast<const std::uint8_t*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes() * SLOTS, flags));
+         if (!mMapped) {
+            printf("Error mapping capture buffer, capture disabled\n");
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            mFailed = true;
+            return false;
+         }
+      }
+      else {
+         mBuffer.allocate(GL_PIXEL_PACK_BUFFER, frameBytes() * SLOTS, nullptr, GL_STREAM_READ);
+         for (auto& slot : mSlots)
+            slot.copy.resize(std::size_t(mWidth) * mHeight);
+      }
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+      mStopping = false;
+      mWorker = std::thread([this] { encodeLoop(); });
+      mStarted = true;
+      return true;
+   }
+
+   // Hands read back slots to the worker, oldest first. Without wait it stops
+   // at the first fence that hasn't signalled; with it, it waits for the oldest
+   // one, or for all of them with all.
+   void collect(bool wait, bool all = false) {
+      for (unsigned i = 0; i < SLOTS; ++i) {
+         auto& slot = mSlots[(mNext + i) % SLOTS];
+         if (slot.state.load(std::memory_order_acquire) != SlotState::Reading)
+            continue;
+
+         if (glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            if (!wait)
+               return;
+            ++mReadbackWaits;
+            const auto waitStart = clock::now();
+            while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000) == GL_TIMEOUT_EXPIRED)
+               ;
+            mReadbackWaitSeconds += seconds(clock::now() - waitStart);
+         }
+         wait = all;
+         glDeleteSync(slot.fence);
+         slot.fence = nullptr;
+
+         const auto index = unsigned(&slot - mSlots.data());
+         if (mPersistent)
+            slot.pixels = reinterpret_cast<const std::uint32_t*>(mMapped + offset(index));
+         else {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, mBuffer.get());
+            const auto data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, offset(index), frameBytes(), GL_MAP_READ_BIT);
+            if (data)
+               memcpy(slot.copy.data(), data, frameBytes());
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            slot.pixels = slot.copy.data();
+         }
+
+         {
+            std::lock_guard lock(mMutex);
+            slot.state.store(SlotState::Encoding, std::memory_order_release);
+         }
+         mWork.notify_one();
+      }
+   }
+
+   // Worker thread: encodes slots in the order they were read back.
+   void encodeLoop() {
+      for (unsigned next = 0;; next = (next + 1) % SLOTS) {
+         auto& slot = mSlots[next];
+         {
+            std::unique_lock lock(mMutex);
+            mWork.wait(lock, [&] { return slot.state.load(std::memory_order_acquire) == SlotState::Encoding || mStopping; });
+            if (slot.state.load(std::memory_order_acquire) != SlotState::Encoding)
+               return;
+         }
+
+         const auto start = clock::now();
+         const auto written = mY4m ? writeY4mFrame(slot.pixels) : writePngFrame(slot.frame, slot.pixels);
+         const auto elapsed = seconds(clock::now() - start);
+
+         {
+            std::lock_guard lock(mMutex);
+            slot.state.store(SlotState::Free, std::memory_order_release);
+            mEncoded += written;
+            mEncodeSeconds += elapsed;
+         }
+         mSlotFree.notify_one();
+      }
+   }
+
+   bool writePngFrame(unsigned long frame, const std::uint32_t* pixels) {
+      char name[32];
+      snprintf(name, sizeof(name), "frame_%06lu.png", frame);
+      return writePng((mPath / name).string().c_str(), mWidth, mHeight,
+         std::span(pixels, std::size_t(mWidth) * mHeight));
+   }
+
+   // RGBA bottom row first to planar Y'CbCr 4:2:0 top row first, full range
+   // BT.601; chroma is the average of each 2x2 block.
+   bool writeY4mFrame(const std::uint32_t* pixels) {
+      const auto chromaWidth = (mWidth + 1) / 2;
+      const auto chromaHeight = (mHeight + 1) / 2;
+      mPlanes.resize(std::size_t(mWidth) * mHeight + 2 * std::size_t(chromaWidth) * chromaHeight);
+      auto* y = mPlanes.data();
+      auto* cb = y + std::size_t(mWidth) * mHeight;
+      auto* cr = cb + std::size_t(chromaWidth) * chromaHeight;
+
+      // memory row of a picture row, the last one repeated for odd heights
+      const auto source = [&](int row) {
+         return pixels + std::size_t(mHeight - 1 - std::min(row, mHeight - 1)) * mWidth;
+      };
+      const auto r = [](std::uint32_t p) { return int(p & 0xff); };
+      const auto g = [](std::uint32_t p) { return int((p >> 8) & 0xff); };
+      const auto b = [](std::uint32_t p) { return int((p >> 16) & 0xff); };
+
+      for (int row = 0; row < mHeight; ++row) {
+         const auto* line = source(row);
+         for (int x = 0; x < mWidth; ++x)
+            *y++ = std::uint8_t((77 * r(line[x]) + 150 * g(line[x]) + 29 * b(line[x]) + 128) >> 8);
+      }
+
+      for (int row = 0; row < mHeight; row += 2) {
+         const auto* top = source(row);
+         const auto* bottom = source(row + 1);
+         for (int x = 0; x < mWidth; x += 2) {
+            const auto right = std::min(x + 1, mWidth - 1);
+            const auto sr = r(top[x]) + r(top[right]) + r(bottom[x]) + r(bottom[right]);
+            const auto sg = g(top[x]) + g(top[right]) + g(bottom[x]) + g(bottom[right]);
+            const auto sb = b(top[x]) + b(top[right]) + b(bottom[x]) + b(bottom[right]);
+            // sums of four, hence the extra 2 bits of shift; pure blue and red round up to 256
+            *cb++ = std::uint8_t(std::min(((-43 * sr - 85 * sg + 128 * sb + 512) >> 10) + 128, 255));
+            *cr++ = std::uint8_t(std::min(((128 * sr - 107 * sg - 21 * sb + 512) >> 10) + 128, 255));
+         }
+      }
+
+      if (fputs("FRAME\n", mOutput) < 0 || fwrite(mPlanes.data(), mPlanes.size(), 1, mOutput) != 1) {
+         printf("Error writing '%s'\n", mPath.string().c_str());
+         return false;
+      }
+      return true;
+   }
+
+   std::filesystem::path mPath;
+   bool mY4m;
+   double mFps;
+
+   bool mStarted = false;
+   bool mFinished = false;
+   bool mFailed = false;
+   bool mPersistent = false;
+   int mWidth = 0;
+   int mHeight = 0;
+   GlBuffer mBuffer;
+   const std::uint8_t* mMapped = nullptr;
+   std::array<Slot, SLOTS> mSlots;
+   unsigned mNext = 0;
+
+   // worker side; hand-overs between the threads (Encoding, Free) happen
+   // under mMutex, so neither condition variable misses one
+   std::thread mWorker;
+   mutable std::mutex mMutex;
+   std::condition_variable mWork;
+   std::condition_variable mSlotFree;
+   bool mStopping = false;
+   FILE* mOutput = nullptr;
+   std::vector<std::uint8_t> mPlanes;
+
+   unsigned long mFrames = 0;
+   unsigned long mEncoded = 0;
+   unsigned long mSkipped = 0;
+   unsigned long mReadbackWaits = 0;
+   unsigned long mEncoderWaits = 0;
+   double mFrameSeconds = 0;
+   double mMaxFrameSeconds = 0;
+   double mReadbackWaitSeconds = 0;
+   double mEncoderWaitSeconds = 0;
+   double mEncodeSeconds = 0;
+};
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <stdio.h>
+#include <vector>
+
+#include "frame_memory.h"
+#include "job_system.h"
+#include "render_queue.h"
+
+// Fixed-size pieces of CommandLists, 256 commands each.
+struct CommandChunk {
+   static constexpr std::size_t CAPACITY = 256;
+   CommandChunk* next = nullptr;
+   std::size_t count = 0;
+   DrawCommand commands[CAPACITY];
+};
+
+// Chunks shared by the CommandLists of several threads, so together they
+// need only as many as a frame's commands fill, whichever thread recorded
+// them. The lock is taken once per chunk, not per command.
+class CommandChunkPool {
+public:
+   CommandChunk* acquire() {
+      std::lock_guard lock(mMutex);
+      return mChunks.create();
+   }
+
+   // Returns first and the chunks chained after it.
+   void release(CommandChunk* first) {
+      std::lock_guard lock(mMutex);
+      while (first) {
+         auto* next = first->next;
+         mChunks.destroy(first);
+         first = next;
+      }
+   }
+
+   // Room for lists lists holding commands commands in all, without allocating.
+   void reserve(std::size_t commands, std::size_t lists) {
+      std::lock_guard lock(mMutex);
+      mChunks.reserve((commands + CommandChunk::CAPACITY - 1) / CommandChunk::CAPACITY + lists);
+   }
+
+   std::size_t peak() const {
+      return mChunks.peak();
+   }
+
+private:
+   std::mutex mMutex;
+   ObjectPool<CommandChunk, 8> mChunks;
+};
+
+// Draw commands recorded by one thread as a chain of chunks from a pool,
+// which clear() returns them to. Nothing in it touches GL; replay() hands
+// the commands to a RenderQueue on the GL thread.
+class alignas(64) CommandList {
+public:
+   explicit CommandList(CommandChunkPool& chunks)
+      : mChunks{ &chunks } {
+   }
+
+   void record(const DrawCommand& command) {
+      if (!mLast || mLast->count == CommandChunk::CAPACITY) {
+         auto* chunk = mChunks->acquire();
+         (mLast ? mLast->next : mFirst) = chunk;
+         mLast = chunk;
+      }
+      mLast->commands[mLast->count++] = command;
+      ++mSize;
+   }
+
+   // Submits every command in recording order and empties the list.
+   void replay(RenderQueue& queue) {
+      for (auto* chunk = mFirst; chunk; chunk = chunk->next)
+         for (std::size_t i = 0; i < chunk->count; ++i)
+            queue.submit(chunk->commands[i]);
+      clear();
+   }
+
+   void clear() {
+      mChunks->release(mFirst);
+      mFirst = mLast = nullptr;
+      mSize = 0;
+   }
+
+   std::size_t size() const {
+      return mSize;
+   }
+
+private:
+   CommandChunkPool* mChunks;
+   CommandChunk* mFirst = nullptr;
+   CommandChunk* mLast = nullptr;
+   std::size_t mSize = 0;
+};
+
+// Per-object draw preparation fanned out over a JobSystem: every worker
+// records into its own CommandList (from record(), or from TaskGraph jobs
+// through list()), then the GL thread replays the lists into the
+// RenderQueue in one pass. Commands that should go out in a fixed
+// order need it in their sort keys, the order of the lists depends on which
+// worker ran which chunk.
+//
+//    recorder.record(count, 64, [&](std::size_t begin, std::size_t end, CommandList& list) { ... list.record(command); });
+//    recorder.replay(queue);
+//    queue.flush();
+class ParallelRecorder {
+public:
+   explicit ParallelRecorder(JobSystem& jobs)
+      : mJobs{ jobs } {
+      mLists.reserve(jobs.threads());
+      for (unsigned i = 0; i < jobs.threads(); ++i)
+         mLists.emplace_back(mChunks);
+   }
+
+   // Room for commands commands a frame, however the workers split them.
+   void reserve(std::size_t commands) {
+      mChunks.reserve(commands, mLists.size());
+   }
+
+   // Calls prepare(begin, end, list) for chunks of [0, count) on every worker.
+   template <typename Prepare>
+   void record(std::size_t count, std::size_t grain, Prepare&& prepare) {
+      mJobs.parallelFor(count, grain, [&](std::size_t begin, std::size_t end, unsigned worker) {
+         prepare(begin, end, mLists[worker]);
+      });
+   }
+
+   // The list of worker, for recording from jobs of a TaskGraph.
+   CommandList& list(unsigned worker) {
+      return mLists[worker];
+   }
+
+   void replay(RenderQueue& queue) {
+      const auto start = std::chrono::steady_clock::now();
+      for (auto& list : mLists) {
+         mCommands += list.size();
+         list.replay(queue);
+      }
+      ++mFrames;
+      mReplaySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   }
+
+   void printStats() const {
+      const auto frames = double(std::max(mFrames, 1ul));
+      printf("Parallel recording: %zu command lists, %.1f commands/frame, replay %.3f ms/frame, peak %zu chunks (%zu bytes)\n",
+         mLists.size(), mCommands / frames, mReplaySeconds * 1000 / frames, mChunks.peak(), mChunks.peak() * sizeof(CommandChunk));
+   }
+
+private:
+   JobSystem& mJobs;
+   CommandChunkPool mChunks;
+   std::vector<CommandList> mLists;
+
+   unsigned long mFrames = 0;
+   unsigned long mCommands = 0;
+   double mReplaySeconds = 0;
+};
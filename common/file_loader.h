@@ -0,0 +1,243 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A file's bytes, read-only: mmap'ed where there is mmap, read into memory
+// elsewhere. Mapping costs nothing up front, the pages come in as they are
+// first touched; prefetch() touches them all, on whichever thread should
+// wait for the disk.
+class MappedFile {
+public:
+   MappedFile() = default;
+
+   MappedFile(const MappedFile&) = delete;
+   MappedFile& operator=(const MappedFile&) = delete;
+
+   ~MappedFile() {
+      close();
+   }
+
+   // false after printing why when path cannot be read.
+   bool open(const std::filesystem::path& path) {
+      close();
+#if defined(__unix__) || defined(__APPLE__)
+      const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      struct stat info;
+      if (fd < 0 || fstat(fd, &info) != 0) {
+         printf("Cannot open '%s'\n", path.string().c_str());
+         if (fd >= 0)
+            ::close(fd);
+         return false;
+      }
+      mSize = std::size_t(info.st_size);
+      if (mSize) {
+         void* data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+         if (data == MAP_FAILED) {
+            printf("Cannot map '%s'\n", path.string().c_str());
+            ::close(fd);
+            mSize = 0;
+            return false;
+         }
+         mData = static_cast<const std::byte*>(data);
+         madvise(data, mSize, MADV_SEQUENTIAL);
+      }
+      ::close(fd);
+      mMapped = true;
+#else
+      std::ifstream stream(path, std::ios::binary | std::ios::ate);
+      if (!stream) {
+         printf("Cannot open '%s'\n", path.string().c_str());
+         return false;
+      }
+      mCopy.resize(std::size_t(stream.tellg()));
+      stream.seekg(0);
+      if (!stream.read(reinterpret_cast<char*>(mCopy.data()), std::streamsize(mCopy.size()))) {
+         printf("Cannot read '%s'\n", path.string().c_str());
+         mCopy.clear();
+         return false;
+      }
+      mData = mCopy.data();
+      mSize = mCopy.size();
+#endif
+      return true;
+   }
+
+   void close() {
+#if defined(__unix__) || defined(__APPLE__)
+      if (mMapped && mData)
+         munmap(const_cast<std::byte*>(mData), mSize);
+#endif
+      mCopy.clear();
+      mData = nullptr;
+      mSize = 0;
+      mMapped = false;
+   }
+
+   // Reads every page in, so later reads of the bytes do not wait for the disk.
+   void prefetch() const {
+      volatile std::byte sink{};
+      for (std::size_t offset = 0; offset < mSize; offset += 4096)
+         sink = mData[offset];
+      (void)sink;
+   }
+
+   std::span<const std::byte> bytes() const {
+      return { mData, mSize };
+   }
+
+   bool mapped() const {
+      return mMapped;
+   }
+
+private:
+   const std::byte* mData = nullptr;
+   std::size_t mSize = 0;
+   bool mMapped = false;
+   std::vector<std::byte> mCopy;
+};
+
+// Where a streamed file is: the loader thread takes it from Queued to Mapped
+// or Failed, the streamer's GL thread on from Mapped as it uploads it.
+enum class LoadState { Queued, Mapped, Uploading, Ready, Failed };
+
+// A file queued on a FileLoader; the streamers keep their per-file state in
+// a struct derived from it.
+struct LoadedFile {
+   std::filesystem::path path;
+   std::atomic<LoadState> state{ LoadState::Queued };
+
+   // written by the loader thread before it leaves Queued
+   MappedFile file;
+   std::size_t readBytes = 0;
+   double readSeconds = 0;
+
+   LoadState current() const {
+      return state.load(std::memory_order_acquire);
+   }
+
+   bool done() const {
+      const auto state = current();
+      return state == LoadState::Ready || state == LoadState::Failed;
+   }
+};
+
+// The loader thread of the streamers: maps the queued files one after the
+// other, in the order they were queued, and reads their pages in, so the GL
+// thread never waits for the disk. parse then checks a file's bytes, still
+// on that thread, and keeps what the streamer needs of them; a file it
+// refuses is closed and Failed. Files are only appended and live as long as
+// the loader.
+//
+//    FileLoader<Request> loader([](Request& request, const char* name) { ... });
+//    loader.start();
+//    const auto id = loader.add(std::make_unique<Request>(path));
+//    if (loader.files()[id]->current() == LoadState::Mapped) ...   // GL thread
+template <typename File>
+class FileLoader {
+public:
+   using Parse = std::function<bool(File& file, const char* name)>;
+
+   explicit FileLoader(Parse parse)
+      : mParse{ std::move(parse) } {
+   }
+
+   ~FileLoader() {
+      if (!mThread.joinable())
+         return;
+      {
+         std::lock_guard lock(mMutex);
+         mStop = true;
+      }
+      mWake.notify_one();
+      mThread.join();
+   }
+
+   FileLoader(const FileLoader&) = delete;
+   FileLoader& operator=(const FileLoader&) = delete;
+
+   void start() {
+      mThread = std::thread([this] { run(); });
+   }
+
+   // Queues file; its index into files().
+   std::size_t add(std::unique_ptr<File> file) {
+      {
+         std::lock_guard lock(mMutex);
+         mFiles.push_back(std::move(file));
+      }
+      mWake.notify_one();
+      return mFiles.size() - 1;
+   }
+
+   // Every file queued so far; on the thread that adds them.
+   std::span<const std::unique_ptr<File>> files() const {
+      return mFiles;
+   }
+
+   // Read rate of the loader thread, over the files it is done with.
+   double readMegabytesPerSecond() const {
+      std::size_t bytes = 0;
+      double seconds = 0;
+      for (const auto& file : mFiles)
+         if (file->current() != LoadState::Queued) {
+            bytes += file->readBytes;
+            seconds += file->readSeconds;
+         }
+      return seconds > 0 ? double(bytes) / (1024 * 1024) / seconds : 0.0;
+   }
+
+private:
+   void run() {
+      std::size_t next = 0;
+      for (;;) {
+         File* file = nullptr;
+         {
+            std::unique_lock lock(mMutex);
+            mWake.wait(lock, [&] { return mStop || next < mFiles.size(); });
+            if (mStop)
+               return;
+            file = mFiles[next++].get();
+         }
+
+         const auto start = std::chrono::steady_clock::now();
+         const auto name = file->path.string();
+         auto ok = file->file.open(file->path);
+         if (ok) {
+            file->file.prefetch();
+            ok = mParse(*file, name.c_str());
+         }
+         file->readBytes = file->file.bytes().size();
+         file->readSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+         if (!ok)
+            file->file.close();
+         file->state.store(ok ? LoadState::Mapped : LoadState::Failed, std::memory_order_release);
+      }
+   }
+
+   Parse mParse;
+   // the loader thread reads the vector under mMutex
+   std::vector<std::unique_ptr<File>> mFiles;
+   std::thread mThread;
+   std::mutex mMutex;
+   std::condition_variable mWake;
+   bool mStop = false;
+};
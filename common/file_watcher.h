@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdio.h>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Reports files that were written, replaced or created. A background thread
+// waits on inotify for their directories, which catches editors that save by
+// renaming a temporary file over the original; elsewhere it compares
+// modification times four times a second.
+//
+//    watcher.watch(path);
+//    for (const auto& file : watcher.changes())   // once a frame, never blocks
+class FileWatcher {
+public:
+   FileWatcher() {
+#ifdef __linux__
+      mFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+      if (mFd < 0)
+         printf("inotify unavailable, watching files by their modification time\n");
+#endif
+      mThread = std::thread([this] { run(); });
+   }
+
+   ~FileWatcher() {
+      mStop = true;
+      mThread.join();
+#ifdef __linux__
+      if (mFd >= 0)
+         close(mFd);
+#endif
+   }
+
+   FileWatcher(const FileWatcher&) = delete;
+   FileWatcher& operator=(const FileWatcher&) = delete;
+
+   void watch(const std::filesystem::path& path) {
+      std::error_code error;
+      auto file = std::filesystem::absolute(path, error).lexically_normal();
+      const auto time = std::filesystem::last_write_time(file, error);
+
+      std::lock_guard lock(mMutex);
+      if (!mFiles.emplace(file, time).second)
+         return;
+#ifdef __linux__
+      const auto directory = file.parent_path();
+      if (mFd >= 0 && !mDirectories.count(directory)) {
+         const auto wd = inotify_add_watch(mFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+         if (wd < 0)
+            printf("Cannot watch '%s'\n", directory.c_str());
+         else {
+            mDirectories.insert(directory);
+            mWatches[wd] = directory;
+         }
+      }
+#endif
+   }
+
+   // Watched files that changed since the last call, each once.
+   std::vector<std::filesystem::path> changes() {
+      std::lock_guard lock(mMutex);
+      std::vector<std::filesystem::path> changed(mChanged.begin(), mChanged.end());
+      mChanged.clear();
+      return changed;
+   }
+
+private:
+   void run() {
+      while (!mStop) {
+#ifdef __linux__
+         if (mFd >= 0) {
+            readEvents();
+            continue;
+         }
+#endif
+         compareTimes();
+         std::this_thread::sleep_for(std::chrono::milliseconds(250));
+      }
+   }
+
+#ifdef __linux__
+   void readEvents() {
+      pollfd descriptor{ mFd, POLLIN, 0 };
+      if (::poll(&descriptor, 1, 100) <= 0)
+         return;
+
+      alignas(inotify_event) char buffer[4096];
+      for (;;) {
+         const auto length = read(mFd, buffer, sizeof(buffer));
+         if (length <= 0)
+            return;
+
+         std::lock_guard lock(mMutex);
+         for (auto* at = buffer; at < buffer + length;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(at);
+            at += sizeof(inotify_event) + event->len;
+            const auto watch = mWatches.find(event->wd);
+            if (watch == mWatches.end() || event->len == 0)
+               continue;
+            const auto file = watch->second / event->name;
+            if (mFiles.count(file))
+               mChanged.insert(file);
+         }
+      }
+   }
+#endif
+
+   void compareTimes() {
+      std::lock_guard lock(mMutex);
+      for (auto& [file, time] : mFiles) {
+         std::error_code error;
+         const auto now = std::filesystem::last_write_time(file, error);
+         if (!error && now != time) {
+            time = now;
+            mChanged.insert(file);
+         }
+      }
+   }
+
+   std::mutex mMutex;
+   std::map<std::filesystem::path, std::filesystem::file_time_type> mFiles;
+   std::set<std::filesystem::path> mChanged;
+#ifdef __linux__
+   int mFd = -1;
+   std::set<std::filesystem::path> mDirectories;
+   std::map<int, std::filesystem::path> mWatches;
+#endif
+   std::atomic<bool> mStop = false;
+   std::thread mThread;
+};
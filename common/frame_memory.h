@@ -0,0 +1,207 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <span>
+#include <stdio.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator: allocate() hands out consecutive pieces of a block and
+// reset() takes them all back at once. When a frame outgrows the block the
+// arena chains more, and the next reset() swaps them for one block of the
+// combined size, so a steady frame ends up in a single block.
+class LinearArena {
+public:
+   explicit LinearArena(std::size_t capacity = 64 * 1024) {
+      addBlock(capacity);
+   }
+
+   LinearArena(const LinearArena&) = delete;
+   LinearArena& operator=(const LinearArena&) = delete;
+
+   void* allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t)) {
+      auto offset = (mUsed + alignment - 1) & ~(alignment - 1);
+      if (offset + size > mBlocks.back().size) {
+         addBlock(std::max(size + alignment, 2 * mBlocks.back().size));
+         offset = 0;
+      }
+      mUsed = offset + size;
+      mBytes += size;
+      return mBlocks.back().data.get() + offset;
+   }
+
+   // Uninitialized room for count T's; T must be trivially destructible,
+   // reset() runs no destructors.
+   template <typename T>
+   T* allocate(std::size_t count = 1) {
+      static_assert(std::is_trivially_destructible_v<T>, "the arena never runs destructors");
+      return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+   }
+
+   void reset() {
+      mPeak = std::max(mPeak, mBytes);
+      if (mBlocks.size() > 1) {
+         std::size_t total = 0;
+         for (const auto& block : mBlocks)
+            total += block.size;
+         mBlocks.clear();
+         addBlock(total);
+      }
+      mUsed = 0;
+      mBytes = 0;
+   }
+
+   // bytes handed out since the last reset, and the most in any one frame
+   std::size_t bytes() const {
+      return mBytes;
+   }
+
+   std::size_t peak() const {
+      return std::max(mPeak, mBytes);
+   }
+
+   std::size_t capacity() const {
+      std::size_t total = 0;
+      for (const auto& block : mBlocks)
+         total += block.size;
+      return total;
+   }
+
+private:
+   struct Block {
+      std::unique_ptr<std::byte[]> data;
+      std::size_t size;
+   };
+
+   void addBlock(std::size_t size) {
+      mBlocks.push_back({ std::make_unique<std::byte[]>(size), size });
+      mUsed = 0;
+   }
+
+   std::vector<Block> mBlocks;
+   std::size_t mUsed = 0;
+   std::size_t mBytes = 0;
+   std::size_t mPeak = 0;
+};
+
+// Scratch memory of a frame, two LinearArenas used on alternate frames:
+// what a frame allocates stays valid through the next one, for work that
+// still reads it (a GPU upload, last frame's matrices), and is reclaimed
+// by the beginFrame() after that. Once both halves have grown to the
+// biggest frame, frames allocate nothing from the heap.
+//
+//    arena.beginFrame();
+//    const auto models = arena.allocate<glm::mat4>(count);
+class FrameArena {
+public:
+   explicit FrameArena(std::size_t capacity = 256 * 1024)
+      : mArenas{ LinearArena{ capacity }, LinearArena{ capacity } } {
+   }
+
+   void beginFrame() {
+      mCurrent ^= 1;
+      mArenas[mCurrent].reset();
+      ++mFrames;
+   }
+
+   // Uninitialized, see LinearArena::allocate().
+   template <typename T>
+   std::span<T> allocate(std::size_t count) {
+      return { mArenas[mCurrent].allocate<T>(count), count };
+   }
+
+   void* allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t)) {
+      return mArenas[mCurrent].allocate(size, alignment);
+   }
+
+   void printStats(const char* name) const {
+      printf("%s: %lu frames, peak %zu bytes/frame, %zu bytes reserved over both halves\n",
+         name, mFrames, std::max(mArenas[0].peak(), mArenas[1].peak()), mArenas[0].capacity() + mArenas[1].capacity());
+   }
+
+private:
+   LinearArena mArenas[2];
+   unsigned mCurrent = 0;
+   unsigned long mFrames = 0;
+};
+
+// Fixed-size slots for objects of type T, carved from blocks of BLOCK_SLOTS
+// that live as long as the pool: create() takes a slot off a free list and
+// destroy() puts it back, so once the pool holds as many objects as a frame
+// needs, frames allocate nothing. Objects keep their address. A pool is used
+// by one thread at a time; objects still in it when it goes away are not
+// destroyed, hence trivially destructible T only.
+template <typename T, std::size_t BLOCK_SLOTS = 64>
+class ObjectPool {
+public:
+   static_assert(std::is_trivially_destructible_v<T>, "the pool drops live objects without destroying them");
+
+   ObjectPool() = default;
+
+   ObjectPool(const ObjectPool&) = delete;
+   ObjectPool& operator=(const ObjectPool&) = delete;
+
+   template <typename... Args>
+   T* create(Args&&... args) {
+      if (!mFree)
+         addBlock();
+      auto* slot = mFree;
+      mFree = slot->next;
+      mPeak = std::max(mPeak, ++mLive);
+      // no arguments default-initializes, as new T does
+      if constexpr (sizeof...(Args) == 0)
+         return new (slot->storage) T;
+      else
+         return new (slot->storage) T(std::forward<Args>(args)...);
+   }
+
+   void destroy(T* object) {
+      object->~T();
+      auto* slot = reinterpret_cast<Slot*>(object);
+      slot->next = mFree;
+      mFree = slot;
+      --mLive;
+   }
+
+   // Room for count live objects without allocating.
+   void reserve(std::size_t count) {
+      while (capacity() < count)
+         addBlock();
+   }
+
+   // objects alive now and at most, and slots allocated
+   std::size_t size() const {
+      return mLive;
+   }
+
+   std::size_t peak() const {
+      return mPeak;
+   }
+
+   std::size_t capacity() const {
+      return mBlocks.size() * BLOCK_SLOTS;
+   }
+
+private:
+   union Slot {
+      Slot* next;
+      alignas(T) std::byte storage[sizeof(T)];
+   };
+
+   void addBlock() {
+      auto block = std::make_unique<Slot[]>(BLOCK_SLOTS);
+      for (std::size_t i = 0; i < BLOCK_SLOTS; ++i)
+         block[i].next = i + 1 < BLOCK_SLOTS ? &block[i + 1] : mFree;
+      mFree = &block[0];
+      mBlocks.push_back(std::move(block));
+   }
+
+   std::vector<std::unique_ptr<Slot[]>> mBlocks;
+   Slot* mFree = nullptr;
+   std::size_t mLive = 0;
+   std::size_t mPeak = 0;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+
+// Counts frames between construction and print() and reports the average rate
+// and the frame time distribution. Room for expectedFrames frame times is
+// reserved up front, so a run of known length records them without allocating.
+class FrameRateCounter {
+public:
+   using clock = std::chrono::steady_clock;
+
+   explicit FrameRateCounter(unsigned long expectedFrames = 0) {
+      mFrameTimes.reserve(expectedFrames);
+   }
+
+   void frame() {
+      const auto now = clock::now();
+      mFrameTimes.push_back(std::chrono::duration<double, std::milli>(now - mLast).count());
+      mLast = now;
+      ++mFrames;
+   }
+
+   unsigned long frames() const {
+      return mFrames;
+   }
+
+   double seconds() const {
+      return std::chrono::duration<double>(clock::now() - mStart).count();
+   }
+
+   // Frame time in milliseconds that percent of the frames stayed within.
+   double percentile(double percent) const {
+      if (mFrameTimes.empty())
+         return 0;
+
+      auto sorted = mFrameTimes;
+      const auto rank = std::min(sorted.size() - 1, std::size_t(percent / 100 * sorted.size()));
+      std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+      return sorted[rank];
+   }
+
+   void print() const {
+      const auto elapsed = seconds();
+      printf("%lu frames in %.3f s: %.1f frames/s, frame time p50 %.3f ms, p99 %.3f ms\n",
+         mFrames, elapsed, elapsed > 0 ? mFrames / elapsed : 0.0, percentile(50), percentile(99));
+   }
+
+private:
+   clock::time_point mStart = clock::now();
+   clock::time_point mLast = mStart;
+   unsigned long mFrames = 0;
+   std::vector<double> mFrameTimes;
+};
@@ -0,0 +1,318 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <stdio.h>
+#include <vector>
+
+#include "gl_objects.h"
+#include "mesh_builder.h"
+#include "vertex_format.h"
+
+// GPU resident mesh: position-only vertices in a single VBO, in the
+// registry's vertex format, and for indexed meshes 16- or 32-bit indices in
+// an EBO.
+struct Mesh {
+   GlVertexArray vao;
+   GlBuffer vbo;
+   GlBuffer ebo;
+   GLenum mode = GL_TRIANGLES;
+   GLsizei vertexCount = 0;
+   // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, GL_NONE when not indexed
+   GLenum indexType = GL_NONE;
+   GLsizei indexCount = 0;
+   // first vertex and byte offset of the indices in the registry's merged buffers
+   GLint first = 0;
+   GLintptr indexOffset = 0;
+   // bounding sphere around the model space origin
+   GLfloat radius = 0;
+   // normalized position formats store position / positionScale; it is 1
+   // unless a coordinate is outside [-1, 1], then models have to scale by it
+   GLfloat positionScale = 1;
+};
+
+// What a draw of a mesh binds and issues.
+struct MeshRange {
+   GLuint vertexArray = 0;
+   GLenum mode = GL_TRIANGLES;
+   // first vertex; for indexed ranges the base vertex added to every index
+   GLint first = 0;
+   // vertices, or indices for indexed ranges
+   GLsizei count = 0;
+   // type of the indices at indexOffset in the VAO's element buffer, GL_NONE draws arrays
+   GLenum indexType = GL_NONE;
+   GLintptr indexOffset = 0;
+};
+
+// Issues the draw of range, instanced when instances is not 0; its VAO has to be bound.
+inline void drawRange(const MeshRange& range, GLsizei instances = 0) {
+   if (range.indexType == GL_NONE) {
+      if (instances)
+         glDrawArraysInstanced(range.mode, range.first, range.count, instances);
+      else
+         glDrawArrays(range.mode, range.first, range.count);
+      return;
+   }
+
+   const auto indices = reinterpret_cast<const void*>(range.indexOffset);
+   if (instances)
+      glDrawElementsInstancedBaseVertex(range.mode, range.count, range.indexType, indices, instances, range.first);
+   else
+      glDrawElementsBaseVertex(range.mode, range.count, range.indexType, indices, range.first);
+}
+
+// Index into GeometryRegistry, valid for the registry's whole lifetime.
+using MeshHandle = std::uint32_t;
+
+// Owns every mesh a sample draws. Meshes are uploaded once in add() and
+// released together with the registry, so the frame loop only binds and draws.
+class GeometryRegistry {
+public:
+   // Positions are stored as positionType, see vertex_format.h.
+   explicit GeometryRegistry(VertexType positionType = VertexType::Float32)
+      : mLayout{ { 0, positionType, 3, "position" } } {
+   }
+
+   MeshHandle add(std::span<const GLfloat> vertices, GLenum mode) {
+      Mesh mesh;
+      mesh.mode = mode;
+      upload(mesh, vertices);
+      glBindVertexArray(0);
+
+      mMeshes.push_back(std::move(mesh));
+      mMerged.reset();
+      return MeshHandle(mMeshes.size() - 1);
+   }
+
+   // Indexed mesh from buildIndexedMesh(), 16-bit indices when its vertices allow.
+   MeshHandle add(const IndexedMesh& indexed, GLenum mode) {
+      Mesh mesh;
+      mesh.mode = mode;
+      upload(mesh, indexed.vertices);
+
+         mesh.indexCount = GLsizei(indexed.indices.size());
+         if (indexed.shortIndices()) {
+            std::vector<std::uint16_t> shortIndices(indexed.indices.begin(), indexed.indices.end());
+            mesh.indexType = GL_UNSIGNED_SHORT;
+            mesh.ebo.allocate(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(shortIndices.size() * sizeof(std::uint16_t)), shortIndices.data(), GL_STATIC_DRAW);
+         }
+         else {
+            mesh.indexType = GL_UNSIGNED_INT;
+            mesh.ebo.allocate(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(indexed.indices.size() * sizeof(std::uint32_t)), indexed.indices.data(), GL_STATIC_DRAW);
+         }
+
+      // the element buffer binding is VAO state, unbind the VAO first
+      glBindVertexArray(0);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+      mBuildStats += indexed.stats;
+      mMeshes.push_back(std::move(mesh));
+      mMerged.reset();
+      return MeshHandle(mMeshes.size() - 1);
+   }
+
+   // Mesh whose vbo (and ebo, when indexed) were filled elsewhere, as
+   // MeshStreamer does, with vertices in layout(); sets up its VAO.
+   MeshHandle add(Mesh mesh) {
+      glBindVertexArray(mesh.vao.get());
+
+         glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo.get());
+         mLayout.apply();
+         if (mesh.indexType != GL_NONE)
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo.get());
+
+      glBindVertexArray(0);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+      mMeshes.push_back(std::move(mesh));
+      mMerged.reset();
+      return MeshHandle(mMeshes.size() - 1);
+   }
+
+   // Copies every mesh into one vertex buffer behind one VAO, which they can
+   // all share since they have the same format. Draws of different meshes then
+   // need no VAO switch and can go out together in one glMultiDrawArrays (or
+   // glMultiDrawElementsBaseVertex, the indices of every indexed mesh are
+   // merged the same way). The per-mesh VAOs stay for instancing; add() drops
+   // the merged buffers again.
+   void merge() {
+      const auto vertexBytes = GLsizeiptr(mLayout.stride());
+      GLsizeiptr total = 0;
+      for (const auto& mesh : mMeshes)
+         total += mesh.vertexCount * vertexBytes;
+
+      auto& merged = mMerged.emplace();
+      merged.vertexCount = GLsizei(total / vertexBytes);
+      merged.vbo.allocate(GL_COPY_WRITE_BUFFER, total, nullptr, GL_STATIC_DRAW);
+
+      GLint first = 0;
+      for (auto& mesh : mMeshes) {
+         glBindBuffer(GL_COPY_READ_BUFFER, mesh.vbo.get());
+         glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, first * vertexBytes, mesh.vertexCount * vertexBytes);
+         mesh.first = first;
+         first += mesh.vertexCount;
+      }
+
+      // indices keep their type, each mesh's aligned to 4 bytes
+      GLsizeiptr indexBytes = 0;
+      for (auto& mesh : mMeshes) {
+         mesh.indexOffset = indexBytes;
+         indexBytes += (mesh.ebo.size() + 3) & ~GLsizeiptr(3);
+      }
+      if (indexBytes) {
+         merged.ebo.allocate(GL_COPY_WRITE_BUFFER, indexBytes, nullptr, GL_STATIC_DRAW);
+         for (const auto& mesh : mMeshes) {
+            if (mesh.indexType == GL_NONE)
+               continue;
+            glBindBuffer(GL_COPY_READ_BUFFER, mesh.ebo.get());
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, mesh.indexOffset, mesh.ebo.size());
+         }
+      }
+      glBindBuffer(GL_COPY_READ_BUFFER, 0);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+      glBindVertexArray(merged.vao.get());
+
+         glBindBuffer(GL_ARRAY_BUFFER, merged.vbo.get());
+         mLayout.apply();
+         if (indexBytes)
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, merged.ebo.get());
+
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+      glBindVertexArray(0);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+   }
+
+   // The merged VAO and the mesh's place in it after merge(), else its own VAO.
+   MeshRange range(MeshHandle handle) const {
+      if (!mMerged)
+         return ownRange(handle);
+      auto range = ownRange(handle);
+      range.vertexArray = mMerged->vao.get();
+      range.first = mMeshes[handle].first;
+      range.indexOffset = mMeshes[handle].indexOffset;
+      return range;
+   }
+
+   const Mesh& get(MeshHandle handle) const {
+      return mMeshes[handle];
+   }
+
+   // Binds the mesh VAO and issues its draw; leaves the VAO bound.
+   void draw(MeshHandle handle) const {
+      const auto range = ownRange(handle);
+      glBindVertexArray(range.vertexArray);
+      drawRange(range);
+   }
+
+   // Feeds a per-instance mat4 (column major, tightly packed from offset in
+   // buffer) to attributes 1-4 of the mesh, advancing once per instance.
+   void setInstanceMatrices(MeshHandle handle, GLuint buffer, GLintptr offset) {
+      attachInstanceMatrices(mMeshes[handle].vao.get(), buffer, offset);
+   }
+
+   // The same for the merged VAO; merge() first. Draws from it then pick their
+   // matrices with baseInstance.
+   void setMergedInstanceMatrices(GLuint buffer, GLintptr offset) {
+      attachInstanceMatrices(mMerged->vao.get(), buffer, offset);
+   }
+
+   void drawInstanced(MeshHandle handle, GLsizei instanceCount) const {
+      const auto range = ownRange(handle);
+      glBindVertexArray(range.vertexArray);
+      drawRange(range, instanceCount);
+   }
+
+   std::size_t size() const {
+      return mMeshes.size();
+   }
+
+   // How every mesh of the registry stores its vertices.
+   const VertexLayout& layout() const {
+      return mLayout;
+   }
+
+   void clear() {
+      mMerged.reset();
+      mMeshes.clear();
+      mBuildStats = {};
+      mPositionError = {};
+   }
+
+   void printStats() const {
+      const auto& stats = glResourceStats();
+      printf("Geometry: %zu meshes, %zu buffers, %zu vertex arrays, %zu bytes\n",
+         mMeshes.size(), stats.buffers, stats.vertexArrays, stats.bufferBytes);
+      if (mBuildStats.indices)
+         mBuildStats.print("Indexed meshes");
+      const auto& position = mLayout.attributes()[0];
+      printf("Vertex format: %s %s, %d bytes per vertex (%zu as floats), max error %.3g, rms %.3g\n",
+         position.name, toString(position.type), mLayout.stride(), 3 * sizeof(GLfloat), mPositionError.maxError, mPositionError.rms());
+   }
+
+private:
+   // Fills the VBO and position attribute of mesh; leaves its VAO bound.
+   void upload(Mesh& mesh, std::span<const GLfloat> vertices) {
+      mesh.vertexCount = GLsizei(vertices.size() / 3);
+      for (std::size_t i = 0; i + 2 < vertices.size(); i += 3)
+         mesh.radius = std::max(mesh.radius, std::sqrt(vertices[i] * vertices[i] + vertices[i + 1] * vertices[i + 1] + vertices[i + 2] * vertices[i + 2]));
+
+      std::span<const GLfloat> positions = vertices;
+      std::vector<GLfloat> scaled;
+      if (VertexLayout::normalized(mLayout.attributes()[0].type)) {
+         for (const auto value : vertices)
+            mesh.positionScale = std::max(mesh.positionScale, std::abs(value));
+         if (mesh.positionScale != 1) {
+            for (const auto value : vertices)
+               scaled.push_back(value / mesh.positionScale);
+            positions = scaled;
+         }
+      }
+
+      std::vector<QuantizationError> errors;
+      const auto packed = mLayout.pack({ positions }, std::size_t(mesh.vertexCount), &errors);
+      errors[0].scale(mesh.positionScale);
+      mPositionError += errors[0];
+
+      glBindVertexArray(mesh.vao.get());
+
+         mesh.vbo.allocate(GL_ARRAY_BUFFER, GLsizeiptr(packed.size()), packed.data(), GL_STATIC_DRAW);
+         mLayout.apply();
+
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+   }
+
+   MeshRange ownRange(MeshHandle handle) const {
+      const auto& mesh = mMeshes[handle];
+      const auto count = mesh.indexType == GL_NONE ? mesh.vertexCount : mesh.indexCount;
+      return { mesh.vao.get(), mesh.mode, 0, count, mesh.indexType, 0 };
+   }
+
+   static void attachInstanceMatrices(GLuint vertexArray, GLuint buffer, GLintptr offset) {
+      glBindVertexArray(vertexArray);
+      glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+      for (GLuint column = 0; column < 4; ++column) {
+         const auto location = 1 + column;
+         const auto columnOffset = offset + GLintptr(column * 4 * sizeof(GLfloat));
+         glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(GLfloat), reinterpret_cast<const void*>(columnOffset));
+         glVertexAttribDivisor(location, 1);
+         glEnableVertexAttribArray(location);
+      }
+
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+      glBindVertexArray(0);
+   }
+
+   std::vector<Mesh> mMeshes;
+   std::optional<Mesh> mMerged;
+   MeshBuildStats mBuildStats;
+   VertexLayout mLayout;
+   QuantizationError mPositionError;
+};
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <utility>
+
+// Counters of GL objects currently owned by the RAII wrappers below.
+struct GlResourceStats {
+   std::size_t buffers = 0;
+   std::size_t vertexArrays = 0;
+   std::size_t textures = 0;
+   std::size_t bufferBytes = 0;
+};
+
+inline GlResourceStats& glResourceStats() {
+   static GlResourceStats stats;
+   return stats;
+}
+
+struct VertexArrayTraits {
+   static GLuint create() {
+      GLuint id = 0;
+      glGenVertexArrays(1, &id);
+      ++glResourceStats().vertexArrays;
+      return id;
+   }
+
+   static void destroy(GLuint id) {
+      glDeleteVertexArrays(1, &id);
+      --glResourceStats().vertexArrays;
+   }
+};
+
+struct BufferTraits {
+   static GLuint create() {
+      GLuint id = 0;
+      glGenBuffers(1, &id);
+      ++glResourceStats().buffers;
+      return id;
+   }
+
+   static void destroy(GLuint id) {
+      glDeleteBuffers(1, &id);
+      --glResourceStats().buffers;
+   }
+};
+
+struct TextureTraits {
+   static GLuint create() {
+      GLuint id = 0;
+      glGenTextures(1, &id);
+      ++glResourceStats().textures;
+      return id;
+   }
+
+   static void destroy(GLuint id) {
+      glDeleteTextures(1, &id);
+      --glResourceStats().textures;
+   }
+};
+
+struct FramebufferTraits {
+   static GLuint create() {
+      GLuint id = 0;
+      glGenFramebuffers(1, &id);
+      return id;
+   }
+
+   static void destroy(GLuint id) {
+      glDeleteFramebuffers(1, &id);
+   }
+};
+
+struct RenderbufferTraits {
+   static GLuint create() {
+      GLuint id = 0;
+      glGenRenderbuffers(1, &id);
+      return id;
+   }
+
+   static void destroy(GLuint id) {
+      glDeleteRenderbuffers(1, &id);
+   }
+};
+
+struct QueryTraits {
+   static GLuint create() {
+      GLuint id = 0;
+      glGenQueries(1, &id);
+      return id;
+   }
+
+   static void destroy(GLuint id) {
+      glDeleteQueries(1, &id);
+   }
+};
+
+// Move-only owner of a single GL object name, deleted when it goes out of scope.
+// Must be destroyed while the context that created it is still current.
+template <typename Traits>
+class [[nodiscard]] GlObject {
+public:
+   GlObject()
+      : mId{ Traits::create() } {
+   }
+
+   ~GlObject() {
+      reset();
+   }
+
+   GlObject(GlObject&& other) noexcept
+      : mId{ std::exchange(other.mId, 0) } {
+   }
+
+   GlObject& operator=(GlObject&& other) noexcept {
+      if (this != &other) {
+         reset();
+         mId = std::exchange(other.mId, 0);
+      }
+      return *this;
+   }
+
+   GlObject(const GlObject&) = delete;
+   GlObject& operator=(const GlObject&) = delete;
+
+   GLuint get() const {
+      return mId;
+   }
+
+   void reset() {
+      if (mId) {
+         Traits::destroy(mId);
+         mId = 0;
+      }
+   }
+
+private:
+   GLuint mId = 0;
+};
+
+using GlVertexArray = GlObject<VertexArrayTraits>;
+using GlTexture = GlObject<TextureTraits>;
+using GlFramebuffer = GlObject<FramebufferTraits>;
+using GlRenderbuffer = GlObject<RenderbufferTraits>;
+using GlQuery = GlObject<QueryTraits>;
+
+// Buffer object that also accounts for the size of its data store.
+class [[nodiscard]] GlBuffer {
+public:
+   GlBuffer() = default;
+
+   ~GlBuffer() {
+      release();
+   }
+
+   GlBuffer(GlBuffer&& other) noexcept
+      : mObject{ std::move(other.mObject) }
+      , mSize{ std::exchange(other.mSize, 0) } {
+   }
+
+   GlBuffer& operator=(GlBuffer&& other) noexcept {
+      if (this != &other) {
+         release();
+         mObject = std::move(other.mObject);
+         mSize = std::exchange(other.mSize, 0);
+      }
+      return *this;
+   }
+
+   GlBuffer(const GlBuffer&) = delete;
+   GlBuffer& operator=(const GlBuffer&) = delete;
+
+   // Binds the buffer to target and (re)specifies its data store.
+   void allocate(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+      glBindBuffer(target, mObject.get());
+      glBufferData(target, size, data, usage);
+      track(size);
+   }
+
+   // Immutable store (GL 4.4 / ARB_buffer_storage), required for persistent mapping.
+   void allocateStorage(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags) {
+      glBindBuffer(target, mObject.get());
+      glBufferStorage(target, size, data, flags);
+      track(size);
+   }
+
+   GLuint get() const {
+      return mObject.get();
+   }
+
+   GLsizeiptr size() const {
+      return mSize;
+   }
+
+private:
+   void track(GLsizeiptr size) {
+      glResourceStats().bufferBytes += size;
+      glResourceStats().bufferBytes -= mSize;
+      mSize = size;
+   }
+
+   void release() {
+      glResourceStats().bufferBytes -= mSize;
+      mSize = 0;
+      mObject.reset();
+   }
+
+   GlObject<BufferTraits> mObject;
+   GLsizeiptr mSize = 0;
+};
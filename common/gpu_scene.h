@@ -0,0 +1,342 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <stdio.h>
+#include <vector>
+
+#include "geometry.h"
+#include "gl_objects.h"
+#include "program_reflection.h"
+#include "render_queue.h"
+
+// One object of a GpuScene, as the cull shader reads it (std430). Its model
+// matrix is the closed form of transform.h, built on the GPU every frame:
+//    translate(position + mesh offset) * rotate(mesh angle * speed + phase, axis) * scale(scale * mesh scale factor)
+struct GpuObject {
+   float position[3] = { 0, 0, 0 };
+   float scale = 1;
+   float axis[3] = { 0, 0, 1 };   // unit length
+   float phase = 0;               // degrees
+   float speed = 1;               // multiplier of the mesh's rotation angle
+   std::uint32_t mesh = 0;        // index into the meshes given to GpuScene::create()
+   float padding[2] = { 0, 0 };
+};
+static_assert(sizeof(GpuObject) == 48, "GpuObject must match the std430 layout of Object");
+
+// Builds the model matrix of every object, drops the ones outside the frustum
+// and appends the rest to their mesh's indirect draw command: the
+// instanceCount is the append counter, the matrix goes to the mesh's base
+// instance + slot.
+// MAX_MESHES is the size of the mesh arrays.
+static const char* GPU_CULL_COMPUTE_SHADER = R"(
+#version 430
+layout (local_size_x = 256) in;
+
+struct Object {
+   vec4 positionScale;
+   vec4 axisPhase;
+   float speed;
+   uint mesh;
+};
+
+struct DrawCommand {
+   uint count;
+   uint instanceCount;
+   uint first;
+   uint baseVertex;
+   uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Objects {
+   Object objects[];
+};
+layout (std430, binding = 1) buffer Commands {
+   DrawCommand commands[];
+};
+layout (std430, binding = 2) writeonly buffer Models {
+   mat4 models[];
+};
+
+uniform uint objectCount;
+uniform vec4 planes[6];
+uniform vec4 meshOffset[16];   // xyz offset, w scale factor
+uniform float meshAngle[16];   // degrees
+uniform float meshRadius[16];
+uniform uint meshBaseInstance[16];
+
+void main(){
+   const uint index = gl_GlobalInvocationID.x;
+   if (index >= objectCount)
+      return;
+
+   const Object object = objects[index];
+   const uint mesh = object.mesh;
+   const vec3 center = object.positionScale.xyz + meshOffset[mesh].xyz;
+   const float scale = object.positionScale.w * meshOffset[mesh].w;
+   const float radius = meshRadius[mesh] * scale;
+   for (int i = 0; i < 6; ++i)
+      if (dot(planes[i].xyz, center) + planes[i].w < -radius)
+         return;
+
+   const float angle = radians(meshAngle[mesh] * object.speed + object.axisPhase.w);
+   const vec3 a = object.axisPhase.xyz;
+   const float c = cos(angle);
+   const float s = sin(angle);
+   const vec3 t = (1.0 - c) * a;
+   const mat3 rotation = mat3(
+      t.x * a.x + c,       t.x * a.y + s * a.z, t.x * a.z - s * a.y,
+      t.y * a.x - s * a.z, t.y * a.y + c,       t.y * a.z + s * a.x,
+      t.z * a.x + s * a.y, t.z * a.y - s * a.x, t.z * a.z + c);
+
+   const uint slot = atomicAdd(commands[mesh].instanceCount, 1u);
+   models[meshBaseInstance[mesh] + slot] = mat4(
+      vec4(scale * rotation[0], 0.0),
+      vec4(scale * rotation[1], 0.0),
+      vec4(scale * rotation[2], 0.0),
+      vec4(center, 1.0));
+}
+)";
+
+// GPU-driven drawing of many instances of a few meshes: objects live in a
+// shader storage buffer, a compute pass culls them against the frustum and
+// writes the indirect draw commands and the model matrices of the survivors,
+// and the draw is one glMultiDrawArraysIndirect (glMultiDrawElementsIndirect
+// for indexed meshes) per run of meshes with the same primitive mode and
+// index type. Per frame the CPU sets a few uniforms and issues a dispatch
+// and the draws, whatever the object count. (The submit time printStats()
+// reports stays flat on hardware; a software driver like llvmpipe runs the
+// pass inside those calls, so there it grows with the objects.)
+//
+// Needs GL 4.3 (or the compute shader, storage buffer, multi-draw-indirect
+// and base instance extensions); the vertex shader takes the model matrix as
+// a per-instance mat4 in locations 1-4, as with GeometryRegistry::setInstanceMatrices.
+//
+//    scene.create(geometry, meshes, objects);
+//    scene.setMeshTransform(...);            // per frame, per mesh
+//    scene.cull(state, cullProgram);         // GPU_CULL_COMPUTE_SHADER
+//    scene.draw(state, drawProgram);
+class GpuScene {
+public:
+   static constexpr std::size_t MAX_MESHES = 16;
+   static constexpr GLuint LOCAL_SIZE = 256;
+
+   static bool supported() {
+      return GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object
+         && GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance);
+   }
+
+   // Merges geometry and points its merged VAO at the scene's matrices, so
+   // nothing else may draw instanced from it. objects[i].mesh indexes meshes.
+   bool create(GeometryRegistry& geometry, std::span<const MeshHandle> meshes, std::span<const GpuObject> objects) {
+      if (!supported()) {
+         printf("GPU-driven drawing needs OpenGL 4.3 or its compute and indirect draw extensions\n");
+         return false;
+      }
+      if (meshes.empty() || meshes.size() > MAX_MESHES) {
+         printf("GPU scene takes 1 to %zu meshes, got %zu\n", MAX_MESHES, meshes.size());
+         return false;
+      }
+
+      // every mesh gets room for all its objects at its baseInstance
+      std::vector<GLuint> perMesh(meshes.size());
+      for (const auto& object : objects) {
+         if (object.mesh >= meshes.size()) {
+            printf("GPU scene object refers to mesh %u of %zu\n", object.mesh, meshes.size());
+            return false;
+         }
+         ++perMesh[object.mesh];
+      }
+
+      geometry.merge();
+      mCommandTemplate.clear();
+      mRuns.clear();
+      GLuint baseInstance = 0;
+      for (std::size_t i = 0; i < meshes.size(); ++i) {
+         const auto range = geometry.range(meshes[i]);
+         mVertexArray = range.vertexArray;
+         if (mRuns.empty() || mRuns.back().mode != range.mode || mRuns.back().indexType != range.indexType)
+            mRuns.push_back({ range.mode, range.indexType, i, 0 });
+         ++mRuns.back().count;
+
+         // arrays commands end at the fourth field, their baseInstance
+         if (range.indexType == GL_NONE)
+            mCommandTemplate.push_back({ GLuint(range.count), 0, GLuint(range.first), baseInstance, 0 });
+         else {
+            const auto indexSize = range.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+            mCommandTemplate.push_back({ GLuint(range.count), 0, GLuint(range.indexOffset / indexSize), GLuint(range.first), baseInstance });
+         }
+         mMeshBaseInstance[i] = baseInstance;
+         mMeshRadius[i] = geometry.get(meshes[i]).radius;
+         mMeshOffset[i] = { 0, 0, 0, 1 };
+         mMeshAngle[i] = 0;
+         baseInstance += perMesh[i];
+      }
+      mObjectCount = GLuint(objects.size());
+
+      mObjects.allocate(GL_SHADER_STORAGE_BUFFER, std::max<GLsizeiptr>(objects.size_bytes(), 1), objects.data(), GL_STATIC_DRAW);
+      mModels.allocate(GL_SHADER_STORAGE_BUFFER, std::max<GLsizeiptr>(GLsizeiptr(objects.size()) * 16 * sizeof(GLfloat), 1), nullptr, GL_DYNAMIC_COPY);
+      glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+      const auto commandBytes = GLsizeiptr(mCommandTemplate.size() * sizeof(IndirectCommand));
+      mCommandReset.allocate(GL_COPY_READ_BUFFER, commandBytes, mCommandTemplate.data(), GL_STATIC_DRAW);
+      glBindBuffer(GL_COPY_READ_BUFFER, 0);
+      mCommands.allocate(GL_DRAW_INDIRECT_BUFFER, commandBytes, mCommandTemplate.data(), GL_DYNAMIC_COPY);
+      glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+      geometry.setMergedInstanceMatrices(mModels.get(), 0);
+      setViewProjection(IDENTITY);
+      return true;
+   }
+
+   // Placement of every object of mesh this frame, angle in degrees.
+   void setMeshTransform(std::uint32_t mesh, const float offset[3], float scaleFactor, float angle) {
+      mMeshOffset[mesh] = { offset[0], offset[1], offset[2], scaleFactor };
+      mMeshAngle[mesh] = angle;
+   }
+
+   // Culling frustum from a column major view projection matrix, identity
+   // (the clip space cube) by default.
+   void setViewProjection(const float matrix[16]) {
+      const auto row = [&](int i, int j) { return matrix[j * 4 + i]; };
+      for (int plane = 0; plane < 6; ++plane) {
+         const auto axis = plane / 2;
+         const auto sign = plane % 2 ? -1.0f : 1.0f;
+         auto& p = mPlanes[plane];
+         for (int j = 0; j < 4; ++j)
+            p[j] = row(3, j) + sign * row(axis, j);
+         const auto length = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+         if (length > 0)
+            for (auto& value : p)
+               value /= length;
+      }
+   }
+
+   // Resets the commands and runs the cull pass with program, a build of
+   // GPU_CULL_COMPUTE_SHADER.
+   void cull(GlStateCache& state, GLuint program) {
+      const auto start = std::chrono::steady_clock::now();
+
+      glBindBuffer(GL_COPY_READ_BUFFER, mCommandReset.get());
+      glBindBuffer(GL_COPY_WRITE_BUFFER, mCommands.get());
+      glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, mCommands.size());
+      glBindBuffer(GL_COPY_READ_BUFFER, 0);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+      state.useProgram(program);
+      if (program != mUniforms.program())
+         mUniforms.reflect(program);
+      // only the planes and angles change from frame to frame, the rest is skipped
+      const auto meshCount = mCommandTemplate.size();
+      mUniforms.set("objectCount", mObjectCount);
+      mUniforms.set("planes", std::span<const float>(mPlanes[0].data(), 4 * mPlanes.size()));
+      mUniforms.set("meshOffset", std::span<const float>(mMeshOffset[0].data(), 4 * meshCount));
+      mUniforms.set("meshAngle", std::span<const float>(mMeshAngle.data(), meshCount));
+      mUniforms.set("meshRadius", std::span<const float>(mMeshRadius.data(), meshCount));
+      mUniforms.set("meshBaseInstance", std::span<const GLuint>(mMeshBaseInstance.data(), meshCount));
+
+      glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mObjects.get());
+      glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mCommands.get());
+      glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mModels.get());
+      glDispatchCompute((mObjectCount + LOCAL_SIZE - 1) / LOCAL_SIZE, 1, 1);
+      // the draws read what the pass wrote as commands and vertex attributes
+      glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+      mCpuSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      ++mDispatches;
+   }
+
+   // Draws what the last cull() kept with program.
+   void draw(GlStateCache& state, GLuint program) {
+      const auto start = std::chrono::steady_clock::now();
+
+      state.useProgram(program);
+      state.bindVertexArray(mVertexArray);
+      state.setBlend(false);
+      glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommands.get());
+      for (const auto& run : mRuns) {
+         const auto offset = reinterpret_cast<const void*>(run.first * sizeof(IndirectCommand));
+         if (run.indexType == GL_NONE)
+            glMultiDrawArraysIndirect(run.mode, offset, run.count, sizeof(IndirectCommand));
+         else
+            glMultiDrawElementsIndirect(run.mode, run.indexType, offset, run.count, sizeof(IndirectCommand));
+         ++mDraws;
+      }
+      glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+      mCpuSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      ++mFrames;
+   }
+
+   GLuint objectCount() const {
+      return mObjectCount;
+   }
+
+   // Reads back the last frame's visible counts, which waits for the GPU.
+   void printStats() const {
+      std::vector<IndirectCommand> commands(mCommandTemplate.size());
+      GLuint visible = 0;
+      if (mFrames) {
+         glBindBuffer(GL_COPY_READ_BUFFER, mCommands.get());
+         glGetBufferSubData(GL_COPY_READ_BUFFER, 0, mCommands.size(), commands.data());
+         glBindBuffer(GL_COPY_READ_BUFFER, 0);
+         for (const auto& command : commands)
+            visible += command.instanceCount;
+      }
+
+      const auto frames = double(std::max(mFrames, 1ul));
+      printf("GPU scene: %u objects, %zu meshes, %u visible in the last frame, per frame %.1f dispatches, %.1f draw calls, "
+         "submit %.3f us/frame\n",
+         mObjectCount, mCommandTemplate.size(), visible, mDispatches / frames, mDraws / frames, mCpuSeconds * 1e6 / frames);
+      mUniforms.printStats("GPU cull");
+   }
+
+private:
+   // DrawElementsIndirectCommand; DrawArraysIndirectCommand is its first four
+   // fields, with baseInstance where this has baseVertex
+   struct IndirectCommand {
+      GLuint count;
+      GLuint instanceCount;
+      GLuint first;
+      GLuint baseVertex;
+      GLuint baseInstance;
+   };
+
+   // consecutive meshes drawn by one multi-draw
+   struct Run {
+      GLenum mode;
+      GLenum indexType;
+      std::size_t first;
+      GLsizei count;
+   };
+
+   static constexpr float IDENTITY[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+   GlBuffer mObjects;
+   GlBuffer mModels;
+   GlBuffer mCommands;
+   GlBuffer mCommandReset;
+   GLuint mVertexArray = 0;
+   GLuint mObjectCount = 0;
+   std::vector<IndirectCommand> mCommandTemplate;
+   std::vector<Run> mRuns;
+
+   std::array<std::array<float, 4>, 6> mPlanes{};
+   std::array<std::array<float, 4>, MAX_MESHES> mMeshOffset{};
+   std::array<float, MAX_MESHES> mMeshAngle{};
+   std::array<float, MAX_MESHES> mMeshRadius{};
+   std::array<GLuint, MAX_MESHES> mMeshBaseInstance{};
+
+   ProgramReflection mUniforms;
+
+   unsigned long mFrames = 0;
+   unsigned long mDispatches = 0;
+   unsigned long mDraws = 0;
+   double mCpuSeconds = 0;
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+constexpr std::uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+constexpr std::uint64_t FNV_PRIME = 0x100000001b3ull;
+
+// 64-bit FNV-1a; pass a previous result as seed to hash several strings as one.
+constexpr std::uint64_t fnv1a(std::string_view text, std::uint64_t seed = FNV_OFFSET_BASIS) {
+   auto hash = seed;
+   for (const auto c : text) {
+      hash ^= std::uint8_t(c);
+      hash *= FNV_PRIME;
+   }
+   return hash;
+}
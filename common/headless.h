@@ -0,0 +1,276 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <stdio.h>
+#include <vector>
+
+#include "gl_objects.h"
+#include "surface.h"
+
+#if defined(PLAYGROUND_HEADLESS_EGL)
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#elif defined(PLAYGROUND_HEADLESS_OSMESA)
+#include <GL/osmesa.h>
+#endif
+
+#if defined(PLAYGROUND_HEADLESS_EGL)
+
+inline EGLDisplay& headlessDisplay() {
+   static EGLDisplay display = EGL_NO_DISPLAY;
+   return display;
+}
+
+// Opens an EGL display that needs neither a window system nor a GPU: Mesa's
+// surfaceless platform (llvmpipe when no GPU is present), else the default one.
+// Returns GLFW_TRUE-compatible 1 on success, for use with ContextGuard.
+inline int headlessInit() {
+   auto& display = headlessDisplay();
+
+   const auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+      eglGetProcAddress("eglGetPlatformDisplayEXT"));
+   if (getPlatformDisplay)
+      display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+   if (display == EGL_NO_DISPLAY)
+      display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+   if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+      printf("Error initializing EGL display: 0x%x\n", eglGetError());
+      return 0;
+   }
+
+   return 1;
+}
+
+inline void headlessTerminate() {
+   auto& display = headlessDisplay();
+   if (display != EGL_NO_DISPLAY)
+      eglTerminate(display);
+   display = EGL_NO_DISPLAY;
+}
+
+#else
+
+inline int headlessInit() {
+#if defined(PLAYGROUND_HEADLESS_OSMESA)
+   return 1;
+#else
+   printf("Headless rendering is not available in this build\n");
+   return 0;
+#endif
+}
+
+inline void headlessTerminate() {
+}
+
+#endif
+
+// Offscreen "window": a context without any window system surface that
+// renders into a framebuffer object of a fixed size. The FBO stays bound as
+// GL_FRAMEBUFFER, so a frame loop written for a window draws into it unchanged.
+class HeadlessWindow : public Surface {
+public:
+   HeadlessWindow(int width, int height)
+      : mWidth{ width }
+      , mHeight{ height } {
+   }
+
+   ~HeadlessWindow() override {
+      for (auto& fence : mFences)
+         if (fence)
+            glDeleteSync(fence);
+      mColor.reset();
+      mDepth.reset();
+      mFramebuffer.reset();
+      destroyContext();
+   }
+
+   HeadlessWindow(const HeadlessWindow&) = delete;
+   HeadlessWindow& operator=(const HeadlessWindow&) = delete;
+
+   bool create(int glMajor, int glMinor) {
+      if (!createContext(glMajor, glMinor))
+         return false;
+
+      if (const auto ret = initGlew(); ret != GLEW_OK) {
+         printf("Error initializing GLEW: %d\n", ret);
+         return false;
+      }
+
+      mColor.emplace();
+      glBindRenderbuffer(GL_RENDERBUFFER, mColor->get());
+      glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, mWidth, mHeight);
+
+      mDepth.emplace();
+      glBindRenderbuffer(GL_RENDERBUFFER, mDepth->get());
+      glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, mWidth, mHeight);
+      glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+      mFramebuffer.emplace();
+      glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer->get());
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mColor->get());
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, mDepth->get());
+
+      if (const auto status = glCheckFramebufferStatus(GL_FRAMEBUFFER); status != GL_FRAMEBUFFER_COMPLETE) {
+         printf("Error creating offscreen framebuffer: 0x%x\n", status);
+         return false;
+      }
+
+      const auto renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+      printf("Headless renderer: %s\n", renderer ? renderer : "unknown");
+      return true;
+   }
+
+   bool shouldClose() override {
+      return false;
+   }
+
+   void pollEvents() override {
+   }
+
+   // Nothing to present; instead bound the number of queued frames the way a
+   // swap chain would, so frames/sec measures rendering rather than queueing.
+   void swapBuffers() override {
+      auto& fence = mFences[mFrame % mFences.size()];
+      if (fence) {
+         while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000) == GL_TIMEOUT_EXPIRED)
+            ;
+         glDeleteSync(fence);
+      }
+      fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      glFlush();
+      ++mFrame;
+   }
+
+   void getFramebufferSize(int* width, int* height) override {
+      *width = mWidth;
+      *height = mHeight;
+   }
+
+   double getTime() override {
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count();
+   }
+
+   GLuint framebuffer() const {
+      return mFramebuffer ? mFramebuffer->get() : 0;
+   }
+
+private:
+#if defined(PLAYGROUND_HEADLESS_EGL)
+   bool createContext(int glMajor, int glMinor) {
+      const auto display = headlessDisplay();
+
+      const EGLint configAttribs[] = {
+         EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+         EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+         EGL_RED_SIZE, 8,
+         EGL_GREEN_SIZE, 8,
+         EGL_BLUE_SIZE, 8,
+         EGL_ALPHA_SIZE, 8,
+         EGL_NONE
+      };
+      EGLConfig config;
+      EGLint configCount = 0;
+      if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0) {
+         printf("Error choosing EGL config: 0x%x\n", eglGetError());
+         return false;
+      }
+
+      eglBindAPI(EGL_OPENGL_API);
+      const EGLint contextAttribs[] = {
+         EGL_CONTEXT_MAJOR_VERSION, glMajor,
+         EGL_CONTEXT_MINOR_VERSION, glMinor,
+         EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+         EGL_NONE
+      };
+      mContext = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+      if (mContext == EGL_NO_CONTEXT) {
+         printf("Error creating EGL context: 0x%x\n", eglGetError());
+         return false;
+      }
+
+      // EGL_KHR_surfaceless_context: current without any draw/read surface
+      if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, mContext)) {
+         printf("Error making EGL context current: 0x%x\n", eglGetError());
+         return false;
+      }
+
+      return true;
+   }
+
+   void destroyContext() {
+      const auto display = headlessDisplay();
+      if (mContext != EGL_NO_CONTEXT) {
+         eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+         eglDestroyContext(display, mContext);
+      }
+   }
+
+   EGLContext mContext = EGL_NO_CONTEXT;
+#elif defined(PLAYGROUND_HEADLESS_OSMESA)
+   bool createContext(int glMajor, int glMinor) {
+      const int attribs[] = {
+         OSMESA_FORMAT, OSMESA_RGBA,
+         OSMESA_DEPTH_BITS, 24,
+         OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+         OSMESA_CONTEXT_MAJOR_VERSION, glMajor,
+         OSMESA_CONTEXT_MINOR_VERSION, glMinor,
+         0
+      };
+      mContext = OSMesaCreateContextAttribs(attribs, nullptr);
+      if (!mContext) {
+         printf("Error creating OSMesa context\n");
+         return false;
+      }
+
+      // OSMesa always wants a client side color buffer, even though the
+      // samples render into the FBO
+      mBuffer.resize(std::size_t(mWidth) * mHeight * 4);
+      if (!OSMesaMakeCurrent(mContext, mBuffer.data(), GL_UNSIGNED_BYTE, mWidth, mHeight)) {
+         printf("Error making OSMesa context current\n");
+         return false;
+      }
+
+      return true;
+   }
+
+   void destroyContext() {
+      if (mContext)
+         OSMesaDestroyContext(mContext);
+   }
+
+   OSMesaContext mContext = nullptr;
+   std::vector<unsigned char> mBuffer;
+#else
+   bool createContext(int, int) {
+      return false;
+   }
+
+   void destroyContext() {
+   }
+#endif
+
+   int mWidth;
+   int mHeight;
+   std::optional<GlRenderbuffer> mColor;
+   std::optional<GlRenderbuffer> mDepth;
+   std::optional<GlFramebuffer> mFramebuffer;
+   std::array<GLsync, 2> mFences{};
+   unsigned long mFrame = 0;
+   std::chrono::steady_clock::time_point mStart = std::chrono::steady_clock::now();
+};
+
+// Headless counterpart of makeWindow_glfw(); the context is current and GLEW
+// is initialized on return. Requires headlessInit() to have succeeded.
+inline std::unique_ptr<HeadlessWindow> makeWindow_headless(int width, int height, int glMajor, int glMinor) {
+   auto window = std::make_unique<HeadlessWindow>(width, height);
+   if (!window->create(glMajor, glMinor))
+      return nullptr;
+   return window;
+}
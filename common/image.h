@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <span>
+#include <stdio.h>
+#include <vector>
+
+#if defined(PLAYGROUND_PNG)
+#include <png.h>
+#endif
+
+// RGBA8 image stored bottom row first, as glReadPixels and SoftRasterizer
+// produce it; files are written and read top row first.
+struct Image {
+   int width = 0;
+   int height = 0;
+   std::vector<std::uint32_t> pixels;
+};
+
+// Writes RGBA8 pixels stored bottom row first as a PNG, top row first.
+#if defined(PLAYGROUND_PNG)
+
+inline bool writePng(const char* path, int width, int height, std::span<const std::uint32_t> pixels) {
+   png_image png{};
+   png.version = PNG_IMAGE_VERSION;
+   png.width = png_uint_32(width);
+   png.height = png_uint_32(height);
+   png.format = PNG_FORMAT_RGBA;
+
+   // negative stride: the last row in memory is the top of the picture
+   const auto stride = -png_int_32(width * 4);
+   if (!png_image_write_to_file(&png, path, 0, pixels.data(), stride, nullptr)) {
+      printf("Error writing '%s': %s\n", path, png.message);
+      return false;
+   }
+   return true;
+}
+
+inline std::optional<Image> readPng(const char* path) {
+   png_image png{};
+   png.version = PNG_IMAGE_VERSION;
+   if (!png_image_begin_read_from_file(&png, path)) {
+      printf("Error reading '%s': %s\n", path, png.message);
+      return {};
+   }
+
+   png.format = PNG_FORMAT_RGBA;
+   Image image;
+   image.width = int(png.width);
+   image.height = int(png.height);
+   image.pixels.resize(std::size_t(image.width) * image.height);
+   if (!png_image_finish_read(&png, nullptr, image.pixels.data(), -png_int_32(image.width * 4), nullptr)) {
+      printf("Error reading '%s': %s\n", path, png.message);
+      png_image_free(&png);
+      return {};
+   }
+   return image;
+}
+
+#else
+
+inline bool writePng(const char* path, int, int, std::span<const std::uint32_t>) {
+   printf("Cannot write '%s', built without libpng\n", path);
+   return false;
+}
+
+inline std::optional<Image> readPng(const char* path) {
+   printf("Cannot read '%s', built without libpng\n", path);
+   return {};
+}
+
+#endif
+
+inline bool writePng(const char* path, const Image& image) {
+   return writePng(path, image.width, image.height, image.pixels);
+}
+
+struct ImageDiff {
+   // pixels with any colour channel off by more than the tolerance; alpha is
+   // ignored, window framebuffers often have none
+   std::size_t differentPixels = 0;
+   int maxDelta = 0;
+   bool sizeMismatch = false;
+};
+
+inline ImageDiff compareImages(const Image& actual, const Image& expected, int tolerance) {
+   ImageDiff diff;
+   if (actual.width != expected.width || actual.height != expected.height) {
+      diff.sizeMismatch = true;
+      return diff;
+   }
+
+   for (std::size_t i = 0; i < actual.pixels.size(); ++i) {
+      auto delta = 0;
+      for (int shift = 0; shift < 24; shift += 8)
+         delta = std::max(delta, std::abs(int((actual.pixels[i] >> shift) & 0xff) - int((expected.pixels[i] >> shift) & 0xff)));
+      diff.maxDelta = std::max(diff.maxDelta, delta);
+      diff.differentPixels += delta > tolerance;
+   }
+   return diff;
+}
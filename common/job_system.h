@@ -0,0 +1,465 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdio.h>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Unit of work run by a JobSystem worker: function(job, worker) over the
+// index range [begin, end).
+struct Job {
+   void (*function)(const Job& job, unsigned worker) = nullptr;
+   void* context = nullptr;
+   std::uint32_t begin = 0;
+   std::uint32_t end = 0;
+};
+
+// Chase-Lev work-stealing deque of a fixed capacity (the C11 version of Lê,
+// Pop, Cohen and Zappa Nardelli, "Correct and Efficient Work-Stealing for
+// Weak Memory Models"). Its owner pushes and pops at the bottom, any other
+// thread steals from the top, the oldest job.
+class JobDeque {
+public:
+   static constexpr std::int64_t CAPACITY = 4096;
+
+   // Owner only; false when full.
+   bool push(Job* job) {
+      const auto bottom = mBottom.load(std::memory_order_relaxed);
+      const auto top = mTop.load(std::memory_order_acquire);
+      if (bottom - top >= CAPACITY)
+         return false;
+      mJobs[bottom & MASK].store(job, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      mBottom.store(bottom + 1, std::memory_order_relaxed);
+      return true;
+   }
+
+   // Owner only; the newest job, nullptr when empty.
+   Job* pop() {
+      const auto bottom = mBottom.load(std::memory_order_relaxed) - 1;
+      mBottom.store(bottom, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      auto top = mTop.load(std::memory_order_relaxed);
+
+      if (top > bottom) {
+         mBottom.store(bottom + 1, std::memory_order_relaxed);
+         return nullptr;
+      }
+      auto* job = mJobs[bottom & MASK].load(std::memory_order_relaxed);
+      if (top == bottom) {
+         // the last job: race the thieves for it
+         if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+         mBottom.store(bottom + 1, std::memory_order_relaxed);
+      }
+      return job;
+   }
+
+   // Any thread; the oldest job, nullptr when empty or lost to another thread.
+   Job* steal() {
+      auto top = mTop.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      const auto bottom = mBottom.load(std::memory_order_acquire);
+      if (top >= bottom)
+         return nullptr;
+      auto* job = mJobs[top & MASK].load(std::memory_order_relaxed);
+      if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+         return nullptr;
+      return job;
+   }
+
+private:
+   static constexpr std::int64_t MASK = CAPACITY - 1;
+
+   // top and bottom on their own cache lines, thieves hammer the first
+   alignas(64) std::atomic<std::int64_t> mTop{ 0 };
+   alignas(64) std::atomic<std::int64_t> mBottom{ 0 };
+   std::array<std::atomic<Job*>, CAPACITY> mJobs{};
+};
+
+class TaskGraph;
+
+// Fixed pool of worker threads with a Chase-Lev deque each. parallelFor()
+// splits a range into chunks, hands every worker an even share and lets
+// the ones that run out steal from the others, so uneven chunks still
+// balance. run() does the same for a TaskGraph. The calling thread works as
+// worker 0; jobs must not call parallelFor() or run() themselves, a graph
+// node that needs a loop is a parallel-for node.
+//
+//    JobSystem jobs;                  // one worker per hardware thread
+//    jobs.parallelFor(count, 64, [&](std::size_t begin, std::size_t end, unsigned worker) { ... });
+class JobSystem {
+public:
+   // threads counts the calling thread; 0 uses every hardware thread.
+   explicit JobSystem(unsigned threads = 0) {
+      if (threads == 0)
+         threads = std::max(1u, std::thread::hardware_concurrency());
+      for (unsigned i = 0; i < threads; ++i)
+         mWorkers.push_back(std::make_unique<Worker>());
+      for (unsigned i = 1; i < threads; ++i)
+         mWorkers[i]->thread = std::thread([this, i] { workerLoop(i); });
+   }
+
+   ~JobSystem() {
+      {
+         std::lock_guard lock(mMutex);
+         mStop = true;
+      }
+      mWake.notify_all();
+      for (auto& worker : mWorkers)
+         if (worker->thread.joinable())
+            worker->thread.join();
+   }
+
+   JobSystem(const JobSystem&) = delete;
+   JobSystem& operator=(const JobSystem&) = delete;
+
+   unsigned threads() const {
+      return unsigned(mWorkers.size());
+   }
+
+   // Calls body(begin, end, worker) for chunks of about grain indices that
+   // cover [0, count) and returns once all of them ran. worker is below
+   // threads() and stays the same within a chunk, for per-worker output.
+   template <typename Body>
+   void parallelFor(std::size_t count, std::size_t grain, Body&& body) {
+      if (count == 0)
+         return;
+      const auto start = std::chrono::steady_clock::now();
+
+      // no more chunks than the deques hold
+      const auto maxChunks = std::size_t(JobDeque::CAPACITY) * mWorkers.size();
+      grain = std::max({ grain, std::size_t(1), (count + maxChunks - 1) / maxChunks });
+      const auto chunks = (count + grain - 1) / grain;
+
+      // Body is a reference type for lvalues, Callable never is
+      using Callable = std::remove_reference_t<Body>;
+      const auto run = [](const Job& job, unsigned worker) {
+         (*static_cast<Callable*>(job.context))(job.begin, job.end, worker);
+      };
+      const auto context = const_cast<void*>(static_cast<const void*>(std::addressof(body)));
+      mJobs.resize(chunks);
+      for (std::size_t i = 0; i < chunks; ++i)
+         mJobs[i] = { run, context, std::uint32_t(i * grain), std::uint32_t(std::min(count, (i + 1) * grain)) };
+
+      mRemaining.store(chunks, std::memory_order_relaxed);
+      seed(mJobs);
+      execute(chunks > 1);
+
+      ++mCalls;
+      mSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   }
+
+   // Runs every node of graph once, each after the nodes it depends on.
+   inline void run(TaskGraph& graph);
+
+   // Per worker: jobs run, how many of them were stolen and the time spent
+   // in them, next to the wall time of every parallelFor() and run().
+   void printStats(const char* name) const {
+      const auto calls = double(std::max(mCalls, 1ul));
+      double busy = 0;
+      for (const auto& worker : mWorkers)
+         busy += worker->seconds;
+      printf("%s: %zu threads, %lu parallel loops and graph runs, %.3f ms/call wall, %.3f ms/call busy over all threads (%.2fx)\n",
+         name, mWorkers.size(), mCalls, mSeconds * 1000 / calls, busy * 1000 / calls, mSeconds > 0 ? busy / mSeconds : 0.0);
+      for (std::size_t i = 0; i < mWorkers.size(); ++i) {
+         const auto& worker = *mWorkers[i];
+         printf("   worker %zu: %.3f ms/call busy, %.1f jobs/call, %lu stolen\n",
+            i, worker.seconds * 1000 / calls, worker.jobs / calls, worker.steals);
+      }
+   }
+
+private:
+   friend class TaskGraph;
+
+   struct alignas(64) Worker {
+      JobDeque deque;
+      std::thread thread;
+      // written by this worker only; seconds is the time inside jobs
+      double seconds = 0;
+      unsigned long jobs = 0;
+      unsigned long steals = 0;
+   };
+
+   // Hands every worker an even share of jobs. The others are parked, so
+   // filling their deques from here does not race their own pushes and pops.
+   void seed(std::span<Job> jobs) {
+      const auto workers = mWorkers.size();
+      for (std::size_t w = 0; w < workers; ++w) {
+         const auto first = jobs.size() * w / workers;
+         const auto last = jobs.size() * (w + 1) / workers;
+         // newest first out: push backwards so each share runs in index order
+         for (auto i = last; i > first; --i)
+            push(unsigned(w), &jobs[i - 1]);
+      }
+   }
+
+   // Queues job on worker's deque, or runs it right away when that is full.
+   // Only worker itself may call it once the workers are awake.
+   void push(unsigned worker, Job* job) {
+      if (!mWorkers[worker]->deque.push(job))
+         runJob(*job, worker);
+   }
+
+   void runJob(const Job& job, unsigned worker) {
+      auto& self = *mWorkers[worker];
+      const auto start = std::chrono::steady_clock::now();
+      job.function(job, worker);
+      self.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      ++self.jobs;
+      mRemaining.fetch_sub(1, std::memory_order_acq_rel);
+   }
+
+   // Works on the seeded jobs, with the other workers when wake is set,
+   // until mRemaining drops to 0.
+   void execute(bool wake) {
+      const auto workers = wake ? mWorkers.size() : 1;
+      if (workers > 1) {
+         mBusy.store(unsigned(workers - 1), std::memory_order_relaxed);
+         {
+            std::lock_guard lock(mMutex);
+            ++mGeneration;
+         }
+         mWake.notify_all();
+      }
+      work(0);
+
+      // every job has run; wait for the workers to leave work() too, so none
+      // touches the jobs once the next call refills them
+      while (mBusy.load(std::memory_order_acquire) != 0)
+         std::this_thread::yield();
+   }
+
+   void workerLoop(unsigned index) {
+      unsigned long seen = 0;
+      for (;;) {
+         {
+            std::unique_lock lock(mMutex);
+            mWake.wait(lock, [&] { return mStop || mGeneration != seen; });
+            if (mStop)
+               return;
+            seen = mGeneration;
+         }
+         work(index);
+         mBusy.fetch_sub(1, std::memory_order_acq_rel);
+      }
+   }
+
+   // Runs this worker's own jobs, then steals until none are left.
+   void work(unsigned index) {
+      auto& self = *mWorkers[index];
+      const auto workers = unsigned(mWorkers.size());
+
+      auto victim = index;
+      while (mRemaining.load(std::memory_order_acquire) != 0) {
+         auto* job = self.deque.pop();
+         if (!job) {
+            victim = (victim + 1) % workers;
+            if (victim == index)
+               continue;
+            job = mWorkers[victim]->deque.steal();
+            if (!job) {
+               std::this_thread::yield();
+               continue;
+            }
+            ++self.steals;
+         }
+         runJob(*job, index);
+      }
+   }
+
+   std::vector<std::unique_ptr<Worker>> mWorkers;
+   std::vector<Job> mJobs;
+   // jobs of the current call that have not finished
+   std::atomic<std::size_t> mRemaining{ 0 };
+   std::atomic<unsigned> mBusy{ 0 };
+
+   std::mutex mMutex;
+   std::condition_variable mWake;
+   unsigned long mGeneration = 0;
+   bool mStop = false;
+
+   unsigned long mCalls = 0;
+   double mSeconds = 0;
+};
+
+// Work of a frame as a dependency graph, built once and run every frame by
+// JobSystem::run(). A node is a task or a parallel loop; it starts once
+// every node it depends on has finished, through a counter per node, and
+// the worker that finishes the last dependency queues it on its own deque.
+//
+//    TaskGraph graph;
+//    const auto simulate = graph.add("simulate", [&](unsigned) { ... });
+//    const auto transforms = graph.addParallelFor("transforms", count, 256, [&](std::size_t begin, std::size_t end, unsigned worker) { ... });
+//    graph.precede(simulate, transforms);
+//    jobs.run(graph);   // per frame
+class TaskGraph {
+public:
+   using Node = std::size_t;
+
+   // task(worker) runs once per run().
+   template <typename Task>
+   Node add(const char* name, Task&& task) {
+      return addNode(name, 1, 1, [task = std::forward<Task>(task)](std::size_t, std::size_t, unsigned worker) mutable { task(worker); });
+   }
+
+   // body(begin, end, worker) runs over chunks of about grain indices of [0, count).
+   template <typename Body>
+   Node addParallelFor(const char* name, std::size_t count, std::size_t grain, Body&& body) {
+      return addNode(name, count, grain, std::forward<Body>(body));
+   }
+
+   // Loop length of a parallel-for node from the next run() on.
+   void setCount(Node node, std::size_t count) {
+      mNodes[node]->count = count;
+   }
+
+   // after starts once before has finished.
+   void precede(Node before, Node after) {
+      mNodes[before]->successors.push_back(mNodes[after].get());
+      ++mNodes[after]->predecessors;
+   }
+
+   std::size_t size() const {
+      return mNodes.size();
+   }
+
+   // Time spent in each node per run, summed over the workers that ran it.
+   void printStats(const char* name) const {
+      const auto runs = double(std::max(mRuns, 1ul));
+      printf("%s: %zu nodes, %lu runs, %.3f ms/run\n", name, mNodes.size(), mRuns, mSeconds * 1000 / runs);
+      for (const auto& node : mNodes)
+         printf("   %-12s %.3f ms/run busy, %zu jobs\n", node->name, node->nanoseconds.load() / 1e6 / runs, node->jobs.size());
+   }
+
+private:
+   friend class JobSystem;
+
+   struct NodeData {
+      TaskGraph* graph = nullptr;
+      Node index = 0;
+      const char* name = "";
+      std::function<void(std::size_t, std::size_t, unsigned)> body;
+      std::size_t count = 1;
+      std::size_t grain = 1;
+      std::vector<NodeData*> successors;
+      unsigned predecessors = 0;
+
+      // per run
+      std::vector<Job> jobs;
+      std::atomic<unsigned> pending{ 0 };
+      std::atomic<std::size_t> unfinished{ 0 };
+      std::atomic<std::uint64_t> nanoseconds{ 0 };
+   };
+
+   Node addNode(const char* name, std::size_t count, std::size_t grain, std::function<void(std::size_t, std::size_t, unsigned)> body) {
+      auto node = std::make_unique<NodeData>();
+      node->graph = this;
+      node->index = mNodes.size();
+      node->name = name;
+      node->body = std::move(body);
+      node->count = count;
+      node->grain = std::max<std::size_t>(grain, 1);
+      mNodes.push_back(std::move(node));
+      return mNodes.size() - 1;
+   }
+
+   // Splits every node into jobs and resets its counters; the number of
+   // jobs in all, 0 when the graph has a cycle and cannot run.
+   std::size_t prepare() {
+      // Kahn's algorithm: a cycle leaves nodes that never become ready;
+      // the scratch vectors are members, so runs after the first allocate nothing
+      auto& pending = mPending;
+      auto& ready = mReady;
+      pending.resize(mNodes.size());
+      ready.clear();
+      for (std::size_t i = 0; i < mNodes.size(); ++i) {
+         pending[i] = mNodes[i]->predecessors;
+         if (!pending[i])
+            ready.push_back(mNodes[i].get());
+      }
+      std::size_t visited = 0;
+      while (!ready.empty()) {
+         const auto* node = ready.back();
+         ready.pop_back();
+         ++visited;
+         for (const auto* next : node->successors) {
+            if (--pending[next->index] == 0)
+               ready.push_back(next);
+         }
+      }
+      if (visited != mNodes.size()) {
+         printf("Task graph has a cycle, not running it\n");
+         return 0;
+      }
+
+      std::size_t total = 0;
+      for (auto& node : mNodes) {
+         // half a deque per node, so a few ready at once still fit
+         const auto maxJobs = std::size_t(JobDeque::CAPACITY / 2);
+         const auto grain = std::max(node->grain, (node->count + maxJobs - 1) / maxJobs);
+         const auto jobs = std::max<std::size_t>((node->count + grain - 1) / grain, 1);
+         node->jobs.resize(jobs);
+         for (std::size_t i = 0; i < jobs; ++i)
+            node->jobs[i] = { runNodeJob, node.get(), std::uint32_t(std::min(node->count, i * grain)), std::uint32_t(std::min(node->count, (i + 1) * grain)) };
+         node->pending.store(node->predecessors, std::memory_order_relaxed);
+         node->unfinished.store(jobs, std::memory_order_relaxed);
+         total += jobs;
+      }
+      return total;
+   }
+
+   static void runNodeJob(const Job& job, unsigned worker) {
+      auto& node = *static_cast<NodeData*>(job.context);
+      const auto start = std::chrono::steady_clock::now();
+      if (job.begin < job.end)
+         node.body(job.begin, job.end, worker);
+      node.nanoseconds.fetch_add(std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()),
+         std::memory_order_relaxed);
+
+      // the last job of the node releases its successors
+      if (node.unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1)
+         return;
+      for (auto* next : node.successors)
+         if (next->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            for (auto i = next->jobs.size(); i > 0; --i)
+               node.graph->mJobs->push(worker, &next->jobs[i - 1]);
+   }
+
+   std::vector<std::unique_ptr<NodeData>> mNodes;
+   std::vector<unsigned> mPending;
+   std::vector<const NodeData*> mReady;
+   JobSystem* mJobs = nullptr;
+   unsigned long mRuns = 0;
+   double mSeconds = 0;
+};
+
+inline void JobSystem::run(TaskGraph& graph) {
+   const auto start = std::chrono::steady_clock::now();
+   const auto total = graph.prepare();
+   if (total == 0)
+      return;
+   graph.mJobs = this;
+
+   mRemaining.store(total, std::memory_order_relaxed);
+   for (auto& node : graph.mNodes)
+      if (node->predecessors == 0)
+         seed(node->jobs);
+   execute(true);
+
+   const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   ++graph.mRuns;
+   graph.mSeconds += seconds;
+   ++mCalls;
+   mSeconds += seconds;
+}
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdio.h>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "hash.h"
+
+// What indexing a mesh saved. Vertex shader runs are counted on a simulated
+// FIFO post-transform cache of CACHE_SIZE entries; an unindexed draw runs it
+// for every vertex it lists.
+struct MeshBuildStats {
+   static constexpr std::size_t CACHE_SIZE = 16;
+
+   std::size_t inputVertices = 0;
+   std::size_t uniqueVertices = 0;
+   std::size_t indices = 0;
+   std::size_t primitives = 0;
+   std::size_t inputBytes = 0;
+   std::size_t vertexBytes = 0;
+   std::size_t indexBytes = 0;
+   // vertex shader runs of the indexed mesh in input order and after reordering
+   std::size_t shaderRunsInputOrder = 0;
+   std::size_t shaderRunsOptimized = 0;
+
+   MeshBuildStats& operator+=(const MeshBuildStats& other) {
+      inputVertices += other.inputVertices;
+      uniqueVertices += other.uniqueVertices;
+      indices += other.indices;
+      primitives += other.primitives;
+      inputBytes += other.inputBytes;
+      vertexBytes += other.vertexBytes;
+      indexBytes += other.indexBytes;
+      shaderRunsInputOrder += other.shaderRunsInputOrder;
+      shaderRunsOptimized += other.shaderRunsOptimized;
+      return *this;
+   }
+
+   void print(const char* name) const {
+      const auto perPrimitive = [&](std::size_t runs) { return primitives ? double(runs) / primitives : 0.0; };
+      printf("%s: %zu -> %zu vertices, %zu indices, %zu -> %zu bytes (%zu vertex + %zu index), "
+         "vertex shader runs %zu -> %zu (%zu in input order), per primitive %.3f -> %.3f\n",
+         name, inputVertices, uniqueVertices, indices, inputBytes, vertexBytes + indexBytes, vertexBytes, indexBytes,
+         inputVertices, shaderRunsOptimized, shaderRunsInputOrder, perPrimitive(inputVertices), perPrimitive(shaderRunsOptimized));
+   }
+};
+
+// Position-only (xyz) mesh with an index list, from buildIndexedMesh().
+struct IndexedMesh {
+   std::vector<float> vertices;
+   std::vector<std::uint32_t> indices;
+   // vertices per primitive: 3 for triangle lists, 2 for line lists
+   unsigned primitiveSize = 3;
+   MeshBuildStats stats;
+
+   std::size_t vertexCount() const {
+      return vertices.size() / 3;
+   }
+
+   // 16-bit indices reach 65536 vertices
+   bool shortIndices() const {
+      return vertexCount() <= 0x10000;
+   }
+
+   std::size_t indexSize() const {
+      return shortIndices() ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+   }
+};
+
+// Vertex shader runs of drawing indices on a FIFO post-transform cache.
+inline std::size_t countShaderRuns(std::span<const std::uint32_t> indices, std::size_t cacheSize = MeshBuildStats::CACHE_SIZE) {
+   std::vector<std::uint32_t> fifo(cacheSize, ~0u);
+   std::size_t next = 0;
+   std::size_t runs = 0;
+   for (const auto index : indices) {
+      if (std::find(fifo.begin(), fifo.end(), index) != fifo.end())
+         continue;
+      fifo[next] = index;
+      next = (next + 1) % cacheSize;
+      ++runs;
+   }
+   return runs;
+}
+
+// Merges bitwise equal vertices (-0 and 0 count as equal), first occurrence
+// first; indices refer to the unique vertices.
+inline IndexedMesh deduplicateVertices(std::span<const float> vertices, unsigned primitiveSize) {
+   using Key = std::array<std::uint32_t, 3>;
+   struct KeyHash {
+      std::size_t operator()(const Key& key) const {
+         return std::size_t(fnv1a(std::string_view(reinterpret_cast<const char*>(key.data()), sizeof(Key))));
+      }
+   };
+
+   IndexedMesh mesh;
+   mesh.primitiveSize = primitiveSize;
+   mesh.indices.reserve(vertices.size() / 3);
+
+   std::unordered_map<Key, std::uint32_t, KeyHash> unique;
+   unique.reserve(vertices.size() / 3);
+   for (std::size_t i = 0; i + 2 < vertices.size(); i += 3) {
+      Key key;
+      for (std::size_t c = 0; c < 3; ++c) {
+         const auto value = vertices[i + c] + 0.0f;
+         std::memcpy(&key[c], &value, sizeof(float));
+      }
+
+      const auto [entry, added] = unique.try_emplace(key, std::uint32_t(mesh.vertexCount()));
+      if (added)
+         mesh.vertices.insert(mesh.vertices.end(), vertices.begin() + i, vertices.begin() + i + 3);
+      mesh.indices.push_back(entry->second);
+   }
+   return mesh;
+}
+
+// Reorders a triangle list for the post-transform vertex cache with Tom
+// Forsyth's linear-speed algorithm: every vertex scores by its place in a
+// simulated LRU cache and by how many triangles still use it, and the next
+// triangle is the best scoring one among those touching the cache.
+inline void optimizeVertexCache(std::span<std::uint32_t> indices, std::size_t vertexCount) {
+   constexpr int CACHE_SIZE = 32;
+   constexpr float CACHE_DECAY_POWER = 1.5f;
+   constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+   constexpr float VALENCE_BOOST_SCALE = 2.0f;
+   constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+   const auto vertexScore = [&](int cachePosition, std::uint32_t valence) {
+      if (valence == 0)
+         return -1.0f;
+      auto score = 0.0f;
+      if (cachePosition >= 0)
+         score = cachePosition < 3 ? LAST_TRIANGLE_SCORE
+            : std::pow(1.0f - float(cachePosition - 3) / (CACHE_SIZE - 3), CACHE_DECAY_POWER);
+      return score + VALENCE_BOOST_SCALE * std::pow(float(valence), -VALENCE_BOOST_POWER);
+   };
+
+   const auto triangleCount = indices.size() / 3;
+   if (triangleCount < 2)
+      return;
+
+   // triangles of every vertex: the first valence entries of its range are the ones left
+   std::vector<std::uint32_t> valence(vertexCount);
+   for (std::size_t i = 0; i < triangleCount * 3; ++i)
+      ++valence[indices[i]];
+   std::vector<std::uint32_t> adjacencyStart(vertexCount + 1);
+   for (std::size_t v = 0; v < vertexCount; ++v)
+      adjacencyStart[v + 1] = adjacencyStart[v] + valence[v];
+   std::vector<std::uint32_t> adjacency(triangleCount * 3);
+   {
+      auto fill = adjacencyStart;
+      for (std::size_t i = 0; i < triangleCount * 3; ++i)
+         adjacency[fill[indices[i]]++] = std::uint32_t(i / 3);
+   }
+
+   std::vector<int> cachePosition(vertexCount, -1);
+   std::vector<float> score(vertexCount);
+   for (std::size_t v = 0; v < vertexCount; ++v)
+      score[v] = vertexScore(-1, valence[v]);
+   std::vector<float> triangleScore(triangleCount);
+   for (std::size_t t = 0; t < triangleCount; ++t)
+      triangleScore[t] = score[indices[3 * t]] + score[indices[3 * t + 1]] + score[indices[3 * t + 2]];
+   std::vector<bool> emitted(triangleCount);
+
+   std::vector<std::uint32_t> output;
+   output.reserve(triangleCount * 3);
+   std::vector<std::uint32_t> cache;
+   std::vector<std::uint32_t> nextCache;
+   std::size_t scan = 0;
+
+   auto best = std::size_t(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+   while (output.size() < triangleCount * 3) {
+      if (best == SIZE_MAX) {
+         // dead end: nothing in the cache has triangles left, take the next one in input order
+         while (emitted[scan])
+            ++scan;
+         best = scan;
+      }
+
+      const std::uint32_t triangle[] = { indices[3 * best], indices[3 * best + 1], indices[3 * best + 2] };
+      output.insert(output.end(), std::begin(triangle), std::end(triangle));
+      emitted[best] = true;
+
+      for (const auto v : triangle) {
+         const auto begin = adjacency.begin() + adjacencyStart[v];
+         const auto end = begin + valence[v];
+         std::iter_swap(std::find(begin, end, std::uint32_t(best)), end - 1);
+         --valence[v];
+      }
+
+      // the triangle's vertices move to the front, the rest shift back
+      nextCache.assign(std::begin(triangle), std::end(triangle));
+      for (const auto v : cache)
+         if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+            nextCache.push_back(v);
+      for (std::size_t i = 0; i < nextCache.size(); ++i) {
+         const auto v = nextCache[i];
+         cachePosition[v] = i < CACHE_SIZE ? int(i) : -1;
+         score[v] = vertexScore(cachePosition[v], valence[v]);
+      }
+
+      best = SIZE_MAX;
+      auto bestScore = -1.0f;
+      for (const auto v : nextCache) {
+         for (auto a = adjacencyStart[v]; a < adjacencyStart[v] + valence[v]; ++a) {
+            const auto t = adjacency[a];
+            triangleScore[t] = score[indices[3 * t]] + score[indices[3 * t + 1]] + score[indices[3 * t + 2]];
+            if (triangleScore[t] > bestScore) {
+               bestScore = triangleScore[t];
+               best = t;
+            }
+         }
+      }
+
+      if (nextCache.size() > CACHE_SIZE)
+         nextCache.resize(CACHE_SIZE);
+      cache.swap(nextCache);
+   }
+
+   std::copy(output.begin(), output.end(), indices.begin());
+}
+
+// Renumbers the vertices in order of first use, so the vertex fetch walks
+// the buffer forward.
+inline void optimizeVertexFetch(IndexedMesh& mesh) {
+   std::vector<std::uint32_t> remap(mesh.vertexCount(), ~0u);
+   std::vector<float> vertices;
+   vertices.reserve(mesh.vertices.size());
+   for (auto& index : mesh.indices) {
+      if (remap[index] == ~0u) {
+         remap[index] = std::uint32_t(vertices.size() / 3);
+         vertices.insert(vertices.end(), mesh.vertices.begin() + 3 * index, mesh.vertices.begin() + 3 * index + 3);
+      }
+      index = remap[index];
+   }
+   mesh.vertices.swap(vertices);
+}
+
+// Indexed version of an unindexed xyz list of primitiveSize-vertex
+// primitives: deduplicated, triangle lists reordered for the vertex cache,
+// vertices in fetch order. stats tells what it saved.
+inline IndexedMesh buildIndexedMesh(std::span<const float> vertices, unsigned primitiveSize) {
+   auto mesh = deduplicateVertices(vertices, primitiveSize);
+   mesh.stats.shaderRunsInputOrder = countShaderRuns(mesh.indices);
+
+   if (primitiveSize == 3)
+      optimizeVertexCache(mesh.indices, mesh.vertexCount());
+   optimizeVertexFetch(mesh);
+
+   auto& stats = mesh.stats;
+   stats.inputVertices = vertices.size() / 3;
+   stats.uniqueVertices = mesh.vertexCount();
+   stats.indices = mesh.indices.size();
+   stats.primitives = primitiveSize ? mesh.indices.size() / primitiveSize : 0;
+   stats.inputBytes = vertices.size_bytes();
+   stats.vertexBytes = mesh.vertices.size() * sizeof(float);
+   stats.indexBytes = mesh.indices.size() * mesh.indexSize();
+   stats.shaderRunsOptimized = countShaderRuns(mesh.indices);
+   return mesh;
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <stdio.h>
+#include <vector>
+
+#include "mesh_builder.h"
+#include "vertex_format.h"
+
+// Binary mesh file, laid out to go to the GPU as it is:
+//
+//    MeshFileHeader
+//    MeshFileAttribute x attributeCount
+//    vertices, interleaved per VertexLayout   (at vertexOffset)
+//    indices, 16 or 32 bits                   (at indexOffset)
+//
+// Both sections start on a MESH_FILE_ALIGNMENT boundary. Little endian,
+// as every GPU host the samples run on.
+constexpr char MESH_FILE_MAGIC[4] = { 'P', 'G', 'M', 'F' };
+constexpr std::uint32_t MESH_FILE_VERSION = 1;
+constexpr std::size_t MESH_FILE_ALIGNMENT = 256;
+
+struct MeshFileHeader {
+   char magic[4];
+   std::uint32_t version;
+   std::uint32_t mode;          // GL primitive mode
+   std::uint32_t vertexCount;
+   std::uint32_t indexCount;
+   std::uint32_t indexSize;     // 2 or 4, 0 when not indexed
+   std::uint32_t stride;
+   std::uint32_t attributeCount;
+   std::uint64_t vertexOffset;
+   std::uint64_t vertexBytes;
+   std::uint64_t indexOffset;
+   std::uint64_t indexBytes;
+   // bounding sphere around the origin, and the scale of normalized positions (see Mesh)
+   float radius;
+   float positionScale;
+};
+
+struct MeshFileAttribute {
+   std::uint32_t location;
+   std::uint32_t type;          // VertexType
+   std::uint32_t components;
+   std::uint32_t offset;
+   char name[16];
+};
+
+// What a mesh file holds, pointing into its bytes.
+struct MeshFileView {
+   MeshFileHeader header{};
+   std::vector<VertexAttribute> attributes;
+   // of each attribute in a vertex, header.stride bytes
+   std::vector<std::uint32_t> offsets;
+   std::span<const std::byte> vertices;
+   std::span<const std::byte> indices;
+};
+
+// Checks data as a mesh file; name is for the messages. Every index is
+// checked against the vertex count, so this reads the whole index section.
+// Nothing is copied, the view is valid as long as data.
+inline std::optional<MeshFileView> parseMeshFile(std::span<const std::byte> data, const char* name) {
+   MeshFileView view;
+   if (data.size() < sizeof(MeshFileHeader)) {
+      printf("%s: too short for a mesh file\n", name);
+      return std::nullopt;
+   }
+   auto& header = view.header;
+   std::memcpy(&header, data.data(), sizeof(header));
+   if (std::memcmp(header.magic, MESH_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != MESH_FILE_VERSION) {
+      printf("%s: not a version %u mesh file\n", name, MESH_FILE_VERSION);
+      return std::nullopt;
+   }
+
+   const auto attributesEnd = sizeof(MeshFileHeader) + std::uint64_t(header.attributeCount) * sizeof(MeshFileAttribute);
+   const auto fits = [&](std::uint64_t offset, std::uint64_t bytes) {
+      return offset <= data.size() && bytes <= data.size() - offset;
+   };
+   if (header.attributeCount == 0 || header.attributeCount > 16 || !fits(0, attributesEnd)
+      || !fits(header.vertexOffset, header.vertexBytes) || !fits(header.indexOffset, header.indexBytes)
+      || header.vertexBytes != std::uint64_t(header.vertexCount) * header.stride
+      || header.indexBytes != std::uint64_t(header.indexCount) * header.indexSize
+      || (header.indexSize != 0 && header.indexSize != 2 && header.indexSize != 4)
+      || (header.indexSize == 0 && header.indexCount != 0)) {
+      printf("%s: mesh file is truncated or its sizes disagree\n", name);
+      return std::nullopt;
+   }
+   if (header.mode > GL_TRIANGLE_FAN) {
+      printf("%s: primitive mode 0x%x is not a GL primitive mode\n", name, header.mode);
+      return std::nullopt;
+   }
+
+   for (std::uint32_t i = 0; i < header.attributeCount; ++i) {
+      MeshFileAttribute attribute;
+      std::memcpy(&attribute, data.data() + sizeof(MeshFileHeader) + i * sizeof(MeshFileAttribute), sizeof(attribute));
+      if (attribute.type > std::uint32_t(VertexType::Snorm10) || attribute.components == 0 || attribute.components > 4) {
+         printf("%s: attribute %u has an unknown format\n", name, i);
+         return std::nullopt;
+      }
+      const VertexAttribute parsed = { attribute.location, VertexType(attribute.type), GLint(attribute.components), "" };
+      if (std::uint64_t(attribute.offset) + std::uint32_t(VertexLayout::size(parsed)) > header.stride) {
+         printf("%s: attribute %u does not fit in a %u-byte vertex\n", name, i, header.stride);
+         return std::nullopt;
+      }
+      view.attributes.push_back(parsed);
+      view.offsets.push_back(attribute.offset);
+   }
+   view.vertices = data.subspan(std::size_t(header.vertexOffset), std::size_t(header.vertexBytes));
+   view.indices = data.subspan(std::size_t(header.indexOffset), std::size_t(header.indexBytes));
+
+   // an index past the vertices would have the GPU read past the vertex buffer
+   for (std::size_t i = 0; i < header.indexCount; ++i) {
+      std::uint32_t index = 0;
+      if (header.indexSize == 2) {
+         std::uint16_t index16;
+         std::memcpy(&index16, view.indices.data() + 2 * i, 2);
+         index = index16;
+      }
+      else
+         std::memcpy(&index, view.indices.data() + 4 * i, 4);
+      if (index >= header.vertexCount) {
+         printf("%s: index %zu is %u, past the %u vertices\n", name, i, index, header.vertexCount);
+         return std::nullopt;
+      }
+   }
+   return view;
+}
+
+// Writes mesh with positions stored as positionType; false after printing
+// why when the file cannot be written.
+inline bool writeMeshFile(const std::filesystem::path& path, const IndexedMesh& mesh, GLenum mode, VertexType positionType) {
+   const VertexLayout layout = { { 0, positionType, 3, "position" } };
+
+   MeshFileHeader header{};
+   std::memcpy(header.magic, MESH_FILE_MAGIC, sizeof(header.magic));
+   header.version = MESH_FILE_VERSION;
+   header.mode = mode;
+   header.vertexCount = std::uint32_t(mesh.vertexCount());
+   header.indexCount = std::uint32_t(mesh.indices.size());
+   header.indexSize = mesh.indices.empty() ? 0 : std::uint32_t(mesh.indexSize());
+   header.stride = std::uint32_t(layout.stride());
+   header.attributeCount = 1;
+   header.positionScale = 1;
+   for (std::size_t i = 0; i + 2 < mesh.vertices.size(); i += 3)
+      header.radius = std::max(header.radius, std::sqrt(mesh.vertices[i] * mesh.vertices[i]
+         + mesh.vertices[i + 1] * mesh.vertices[i + 1] + mesh.vertices[i + 2] * mesh.vertices[i + 2]));
+
+   // normalized formats hold [-1, 1], anything bigger is stored scaled down
+   std::span<const float> positions = mesh.vertices;
+   std::vector<float> scaled;
+   if (VertexLayout::normalized(positionType)) {
+      for (const auto value : mesh.vertices)
+         header.positionScale = std::max(header.positionScale, std::abs(value));
+      if (header.positionScale != 1) {
+         for (const auto value : mesh.vertices)
+            scaled.push_back(value / header.positionScale);
+         positions = scaled;
+      }
+   }
+   const auto vertices = layout.pack({ positions }, mesh.vertexCount());
+
+   std::vector<std::byte> indices(mesh.indices.size() * header.indexSize);
+   for (std::size_t i = 0; i < mesh.indices.size(); ++i) {
+      if (header.indexSize == 2) {
+         const auto index = std::uint16_t(mesh.indices[i]);
+         std::memcpy(indices.data() + 2 * i, &index, 2);
+      }
+      else
+         std::memcpy(indices.data() + 4 * i, &mesh.indices[i], 4);
+   }
+
+   const auto align = [](std::uint64_t offset) {
+      return (offset + MESH_FILE_ALIGNMENT - 1) & ~std::uint64_t(MESH_FILE_ALIGNMENT - 1);
+   };
+   header.vertexOffset = align(sizeof(MeshFileHeader) + sizeof(MeshFileAttribute));
+   header.vertexBytes = vertices.size();
+   header.indexOffset = align(header.vertexOffset + header.vertexBytes);
+   header.indexBytes = indices.size();
+
+   MeshFileAttribute attribute{};
+   attribute.location = 0;
+   attribute.type = std::uint32_t(positionType);
+   attribute.components = 3;
+   std::strncpy(attribute.name, "position", sizeof(attribute.name) - 1);
+
+   std::vector<std::byte> file(std::size_t(header.indexOffset + header.indexBytes));
+   std::memcpy(file.data(), &header, sizeof(header));
+   std::memcpy(file.data() + sizeof(header), &attribute, sizeof(attribute));
+   std::memcpy(file.data() + header.vertexOffset, vertices.data(), vertices.size());
+   if (!indices.empty())
+      std::memcpy(file.data() + header.indexOffset, indices.data(), indices.size());
+
+   std::ofstream stream(path, std::ios::binary);
+   if (!stream.write(reinterpret_cast<const char*>(file.data()), std::streamsize(file.size()))) {
+      printf("Cannot write '%s'\n", path.string().c_str());
+      return false;
+   }
+   return true;
+}
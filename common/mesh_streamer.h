@@ -0,0 +1,251 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <stdio.h>
+#include <vector>
+
+#include "file_loader.h"
+#include "geometry.h"
+#include "mesh_file.h"
+#include "stream_buffer.h"
+
+// Loads mesh files (mesh_file.h) while the frame loop keeps running. A
+// FileLoader thread maps each file and reads its pages in, so the GL thread
+// never waits for the disk. update() then moves at most budget bytes a frame
+// through a staging StreamBuffer into the mesh's buffers (a memcpy into the
+// mapped ring, glCopyBufferSubData on the GPU) and adds the mesh to the
+// registry once all of it arrived. Files load in the order they were asked
+// for; their vertices have to be in the registry's layout.
+//
+//    const auto id = streamer.load("bunny.pgmesh");
+//    streamer.update();                                  // once a frame
+//    if (const auto mesh = streamer.handle(id)) ...      // once it arrived
+class MeshStreamer {
+public:
+   MeshStreamer(GeometryRegistry& geometry, GLsizeiptr budget)
+      : mGeometry{ geometry }
+      , mBudget{ std::max<GLsizeiptr>(budget, 4096) }
+      , mLoader{ [this](Request& request, const char* name) { return parse(request, name); } } {
+      const auto& layout = geometry.layout();
+      const auto attributes = layout.attributes();
+      mLayout.assign(attributes.begin(), attributes.end());
+      mStride = std::uint32_t(layout.stride());
+      for (std::size_t i = 0; i < mLayout.size(); ++i)
+         mOffsets.push_back(std::uint32_t(layout.offset(i)));
+   }
+
+   MeshStreamer(const MeshStreamer&) = delete;
+   MeshStreamer& operator=(const MeshStreamer&) = delete;
+
+   // The staging ring and the loader thread.
+   bool create() {
+      // room for the alignment of every copy of a frame
+      if (!mStaging.create(mBudget + 4096))
+         return false;
+      mLoader.start();
+      return true;
+   }
+
+   // Queues path; the id for handle() and failed().
+   std::size_t load(const std::filesystem::path& path) {
+      auto request = std::make_unique<Request>();
+      request->path = path;
+      request->start = clock::now();
+      return mLoader.add(std::move(request));
+   }
+
+   // The mesh of id once all of it is on the GPU.
+   std::optional<MeshHandle> handle(std::size_t id) const {
+      return mLoader.files()[id]->handle;
+   }
+
+   bool failed(std::size_t id) const {
+      return mLoader.files()[id]->current() == LoadState::Failed;
+   }
+
+   // Uploads the next budget bytes of the mapped files; on the GL thread, once a frame.
+   void update() {
+      auto left = mBudget;
+      auto begun = false;
+      mCopies.clear();
+      const auto requests = mLoader.files();
+      for (std::size_t i = mFirstPending; i < requests.size() && left > 0; ++i) {
+         auto& request = *requests[i];
+         auto state = request.current();
+         if (state == LoadState::Mapped) {
+            begin(request);
+            state = LoadState::Uploading;
+            request.state.store(state, std::memory_order_relaxed);
+         }
+         if (state != LoadState::Uploading)
+            continue;
+
+         if (!begun) {
+            mStaging.beginFrame();
+            begun = true;
+         }
+         left -= stage(request, left);
+      }
+      if (!begun)
+         return;
+
+      mStaging.endWrites();
+      glBindBuffer(GL_COPY_READ_BUFFER, mStaging.get());
+      for (const auto& copy : mCopies) {
+         glBindBuffer(GL_COPY_WRITE_BUFFER, copy.buffer);
+         glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, copy.source, copy.target, copy.size);
+      }
+      glBindBuffer(GL_COPY_READ_BUFFER, 0);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+      mStaging.endFrame();
+
+      const auto bytes = mBudget - left;
+      ++mUploadFrames;
+      mMaxFrameBytes = std::max(mMaxFrameBytes, std::size_t(bytes));
+      for (std::size_t i = mFirstPending; i < requests.size(); ++i) {
+         auto& request = *requests[i];
+         if (request.current() == LoadState::Uploading && request.uploaded == request.total())
+            finish(request);
+      }
+      while (mFirstPending < requests.size() && requests[mFirstPending]->done())
+         ++mFirstPending;
+   }
+
+   // Nothing queued, mapping or uploading.
+   bool idle() const {
+      return mFirstPending == mLoader.files().size();
+   }
+
+   void printStats() const {
+      std::size_t loaded = 0;
+      std::size_t failed = 0;
+      for (const auto& request : mLoader.files()) {
+         loaded += request->handle.has_value();
+         failed += request->current() == LoadState::Failed;
+      }
+      const auto megabytes = double(mBytes) / (1024 * 1024);
+      printf("Mesh streamer: %zu meshes loaded, %zu failed, %.2f MB in %lu frames (budget %.0f KB, at most %.0f KB a frame), "
+         "loader thread read %.1f MB/s, request to drawable %.1f MB/s\n",
+         loaded, failed, megabytes, mUploadFrames, mBudget / 1024.0, mMaxFrameBytes / 1024.0,
+         mLoader.readMegabytesPerSecond(),
+         mLoadSeconds > 0 ? megabytes / mLoadSeconds : 0.0);
+   }
+
+private:
+   using clock = std::chrono::steady_clock;
+
+   struct Request : LoadedFile {
+      clock::time_point start;
+
+      // written by the loader thread before it sets Mapped
+      MeshFileView view;
+
+      // GL thread
+      std::optional<Mesh> mesh;
+      std::size_t uploaded = 0;
+      std::optional<MeshHandle> handle;
+
+      std::size_t total() const {
+         return view.vertices.size() + view.indices.size();
+      }
+   };
+
+   struct Copy {
+      GLuint buffer;
+      GLintptr source;
+      GLintptr target;
+      GLsizeiptr size;
+   };
+
+   // Loader thread: keeps the view of a mesh in the registry's layout.
+   bool parse(Request& request, const char* name) {
+      auto view = parseMeshFile(request.file.bytes(), name);
+      if (!view || !matchesLayout(*view, name))
+         return false;
+      request.view = std::move(*view);
+      return true;
+   }
+
+   bool matchesLayout(const MeshFileView& view, const char* name) const {
+      const auto same = view.attributes.size() == mLayout.size() && view.header.stride == mStride && view.offsets == mOffsets
+         && std::equal(mLayout.begin(), mLayout.end(), view.attributes.begin(), [](const auto& a, const auto& b) {
+            return a.location == b.location && a.type == b.type && a.components == b.components;
+         });
+      if (!same)
+         printf("%s: vertex format differs from the registry's (%s positions), convert it with that format\n",
+            name, toString(mLayout[0].type));
+      return same;
+   }
+
+   // Creates the mesh's buffers, to be filled by the copies.
+   void begin(Request& request) {
+      const auto& header = request.view.header;
+      auto& mesh = request.mesh.emplace();
+      mesh.mode = GLenum(header.mode);
+      mesh.vertexCount = GLsizei(header.vertexCount);
+      mesh.indexType = header.indexSize == 2 ? GL_UNSIGNED_SHORT : header.indexSize == 4 ? GL_UNSIGNED_INT : GL_NONE;
+      mesh.indexCount = mesh.indexType == GL_NONE ? 0 : GLsizei(header.indexCount);
+      mesh.radius = header.radius;
+      mesh.positionScale = header.positionScale;
+      mesh.vbo.allocate(GL_COPY_WRITE_BUFFER, GLsizeiptr(request.view.vertices.size()), nullptr, GL_STATIC_DRAW);
+      if (mesh.indexType != GL_NONE)
+         mesh.ebo.allocate(GL_COPY_WRITE_BUFFER, GLsizeiptr(request.view.indices.size()), nullptr, GL_STATIC_DRAW);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+   }
+
+   // Copies up to budget bytes of request into the staging slice; the bytes taken.
+   GLsizeiptr stage(Request& request, GLsizeiptr budget) {
+      GLsizeiptr staged = 0;
+      while (staged < budget && request.uploaded < request.total()) {
+         const auto inVertices = request.uploaded < request.view.vertices.size();
+         const auto section = inVertices ? request.view.vertices : request.view.indices;
+         const auto offset = inVertices ? request.uploaded : request.uploaded - request.view.vertices.size();
+         const auto size = std::min<std::size_t>(section.size() - offset, std::size_t(budget - staged));
+
+         const auto range = mStaging.allocate(GLsizeiptr(size), 4);
+         if (!range.data)
+            break;
+         std::memcpy(range.data, section.data() + offset, size);
+         const auto buffer = inVertices ? request.mesh->vbo.get() : request.mesh->ebo.get();
+         mCopies.push_back({ buffer, range.offset, GLintptr(offset), GLsizeiptr(size) });
+
+         request.uploaded += size;
+         staged += GLsizeiptr(size);
+      }
+      mBytes += std::size_t(staged);
+      return staged;
+   }
+
+   void finish(Request& request) {
+      request.handle = mGeometry.add(std::move(*request.mesh));
+      request.mesh.reset();
+      request.file.close();
+      request.view = {};
+      mLoadSeconds += std::chrono::duration<double>(clock::now() - request.start).count();
+      request.state.store(LoadState::Ready, std::memory_order_release);
+   }
+
+   GeometryRegistry& mGeometry;
+   std::vector<VertexAttribute> mLayout;
+   std::uint32_t mStride = 0;
+   std::vector<std::uint32_t> mOffsets;
+   GLsizeiptr mBudget;
+   StreamBuffer mStaging;
+   std::vector<Copy> mCopies;
+
+   FileLoader<Request> mLoader;
+   std::size_t mFirstPending = 0;
+
+   std::size_t mBytes = 0;
+   std::size_t mMaxFrameBytes = 0;
+   unsigned long mUploadFrames = 0;
+   double mLoadSeconds = 0;
+};
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstdlib>
+#include <optional>
+#include <stdio.h>
+#include <string_view>
+
+// Command line switches shared by every sample.
+struct Options {
+   // render offscreen through EGL/OSMesa instead of opening a window
+   bool headless = false;
+   // stop after this many frames, 0 runs until the window is closed
+   unsigned long frames = 0;
+   // write a Chrome trace of every frame to this file
+   const char* profilePath = nullptr;
+   // HelloGlm: draw this many objects per shape with instancing, 0 keeps the two-object scene
+   unsigned long instances = 0;
+   // HelloGlm: cull and draw the instanced objects on the GPU (GL 4.3), see gpu_scene.h
+   bool gpuDriven = false;
+   // HelloGlm: draw this many objects per shape with a draw each, prepared on every core
+   unsigned long objects = 0;
+   // worker threads of the job system, counting the main thread; 0 uses every hardware thread
+   unsigned threads = 0;
+   // storage of vertex positions: float, half, snorm16 or snorm10, see vertex_format.h
+   const char* vertexFormat = "float";
+   // directory of cached program binaries, nullptr compiles every start
+   const char* shaderCache = "shader_cache";
+   // directory the sample's shader files are read from, nullptr uses the one in the source tree
+   const char* shaderDir = nullptr;
+   // rebuild programs when their shader files change, see shader_reloader.h (default: on unless headless)
+   bool watchShaders = false;
+   // advance the simulation by this many seconds per frame instead of the elapsed time, 0 uses the clock
+   double frameTime = 0;
+   // HelloGlm: mesh file (see mesh_file.h) streamed in to replace the square once it has arrived
+   const char* meshPath = nullptr;
+   // HelloGlm: directory of KTX2/DDS textures streamed in and drawn on the shapes, see texture_streamer.h
+   const char* texturePath = nullptr;
+   // bytes of streamed meshes, and of streamed textures, uploaded per frame at most
+   unsigned long uploadBudget = 1024 * 1024;
+   // bytes of texture storage at most
+   unsigned long vramCap = 256ul * 1024 * 1024;
+   // seed for everything random in the scene, unset keeps each sample's default
+   std::optional<unsigned> seed;
+
+   // regression checks on --frames runs, see regression.h
+   // write the last frame to this PNG
+   const char* screenshot = nullptr;
+   // compare the last frame against this PNG
+   const char* golden = nullptr;
+   // per-channel difference still counted as equal
+   int tolerance = 8;
+   // percentage of pixels allowed to differ beyond the tolerance
+   double maxDiffPercent = 0.1;
+   // frame time budgets in milliseconds, 0 disables
+   double budgetP50 = 0;
+   double budgetP99 = 0;
+   // fail when a frame after this many warm-up frames calls operator new, see allocation_tracker.h
+   std::optional<unsigned long> allocationWarmup;
+
+   // record every frame to this .y4m file or directory of PNGs, see capture.h
+   const char* capturePath = nullptr;
+   // frame rate written to the video, 0 derives it from --frame-time or uses 60
+   double captureFps = 0;
+
+   bool keepRunning(unsigned long frame) const {
+      return frames == 0 || frame < frames;
+   }
+};
+
+inline void printUsage(const char* program) {
+   printf(
+      "Usage: %s [options]\n"
+      "  --headless      render offscreen without a display\n"
+      "  --frames N      stop after N frames (headless default: 600)\n"
+      "  --profile FILE  write a Chrome trace (chrome://tracing, Perfetto) to FILE\n"
+      "  --instances N   HelloGlm: draw N instanced objects per shape\n"
+      "  --gpu-driven    HelloGlm: cull the instanced objects in a compute shader and draw them indirectly (GL 4.3)\n"
+      "  --objects N     HelloGlm: draw N objects per shape, one draw each, recorded on worker threads\n"
+      "  --threads N     run parallel work on N threads including the main one (default: all hardware threads)\n"
+      "  --vertex-format F   store vertex positions as float, half, snorm16 or snorm10 (default: float)\n"
+      "  --shader-cache DIR  keep linked program binaries in DIR (default: shader_cache)\n"
+      "  --no-shader-cache   compile and link every program on startup\n"
+      "  --shader-dir DIR    read the sample's shader files from DIR (default: its shaders directory in the source tree)\n"
+      "  --watch-shaders     rebuild programs when their shader files change (default: unless headless)\n"
+      "  --no-watch-shaders  load the shader files once\n"
+      "  --frame-time MS     simulate MS milliseconds per frame regardless of real time (reproducible runs)\n"
+      "  --seed N            seed the scene's random numbers\n"
+      "  --mesh FILE         HelloGlm: stream FILE (made by MeshConvert) in and draw it in place of the square\n"
+      "  --textures DIR      HelloGlm: stream every .ktx2 and .dds file in DIR in and texture the shapes with them\n"
+      "  --upload-budget KB  upload at most KB of streamed meshes, and KB of streamed textures, per frame (default: 1024)\n"
+      "  --vram-cap MB       keep streamed textures within MB of storage, evicting the least recently used (default: 256)\n"
+      "  --screenshot FILE   write the last frame to a PNG\n"
+      "  --golden FILE       fail unless the last frame matches this PNG\n"
+      "  --tolerance N       per-channel difference ignored by --golden (default: 8)\n"
+      "  --max-diff PERCENT  pixels allowed to differ by more than the tolerance (default: 0.1)\n"
+      "  --budget-p50 MS     fail when the median frame time exceeds MS\n"
+      "  --budget-p99 MS     fail when the 99th percentile frame time exceeds MS\n"
+      "  --check-allocations N   fail when a frame after the first N allocates from the heap\n"
+      "  --capture PATH      record every frame to PATH.y4m, or as numbered PNGs into the directory PATH\n"
+      "  --capture-fps N     frame rate of the recorded video (default: from --frame-time, else 60)\n",
+      program);
+}
+
+inline Options parseOptions(int argc, char* argv[]) {
+   Options options;
+   auto framesSet = false;
+   auto watchSet = false;
+
+   for (int i = 1; i < argc; ++i) {
+      const std::string_view arg = argv[i];
+      const auto hasValue = i + 1 < argc;
+
+      if (arg == "--headless")
+         options.headless = true;
+      else if (arg == "--frames" && hasValue) {
+         options.frames = std::strtoul(argv[++i], nullptr, 10);
+         framesSet = true;
+      }
+      else if (arg == "--profile" && hasValue)
+         options.profilePath = argv[++i];
+      else if (arg == "--instances" && hasValue)
+         options.instances = std::strtoul(argv[++i], nullptr, 10);
+      else if (arg == "--gpu-driven")
+         options.gpuDriven = true;
+      else if (arg == "--objects" && hasValue)
+         options.objects = std::strtoul(argv[++i], nullptr, 10);
+      else if (arg == "--threads" && hasValue)
+         options.threads = unsigned(std::strtoul(argv[++i], nullptr, 10));
+      else if (arg == "--vertex-format" && hasValue)
+         options.vertexFormat = argv[++i];
+      else if (arg == "--shader-cache" && hasValue)
+         options.shaderCache = argv[++i];
+      else if (arg == "--no-shader-cache")
+         options.shaderCache = nullptr;
+      else if (arg == "--shader-dir" && hasValue)
+         options.shaderDir = argv[++i];
+      else if (arg == "--watch-shaders" || arg == "--no-watch-shaders") {
+         options.watchShaders = arg == "--watch-shaders";
+         watchSet = true;
+      }
+      else if (arg == "--frame-time" && hasValue)
+         options.frameTime = std::strtod(argv[++i], nullptr) / 1000;
+      else if (arg == "--seed" && hasValue)
+         options.seed = unsigned(std::strtoul(argv[++i], nullptr, 10));
+      else if (arg == "--mesh" && hasValue)
+         options.meshPath = argv[++i];
+      else if (arg == "--textures" && hasValue)
+         options.texturePath = argv[++i];
+      else if (arg == "--upload-budget" && hasValue)
+         options.uploadBudget = std::strtoul(argv[++i], nullptr, 10) * 1024;
+      else if (arg == "--vram-cap" && hasValue)
+         options.vramCap = std::strtoul(argv[++i], nullptr, 10) * 1024 * 1024;
+      else if (arg == "--screenshot" && hasValue)
+         options.screenshot = argv[++i];
+      else if (arg == "--golden" && hasValue)
+         options.golden = argv[++i];
+      else if (arg == "--tolerance" && hasValue)
+         options.tolerance = std::atoi(argv[++i]);
+      else if (arg == "--max-diff" && hasValue)
+         options.maxDiffPercent = std::strtod(argv[++i], nullptr);
+      else if (arg == "--budget-p50" && hasValue)
+         options.budgetP50 = std::strtod(argv[++i], nullptr);
+      else if (arg == "--budget-p99" && hasValue)
+         options.budgetP99 = std::strtod(argv[++i], nullptr);
+      else if (arg == "--check-allocations" && hasValue)
+         options.allocationWarmup = std::strtoul(argv[++i], nullptr, 10);
+      else if (arg == "--capture" && hasValue)
+         options.capturePath = argv[++i];
+      else if (arg == "--capture-fps" && hasValue)
+         options.captureFps = std::strtod(argv[++i], nullptr);
+      else if (arg == "--help" || arg == "-h") {
+         printUsage(argv[0]);
+         std::exit(0);
+      }
+      else
+         printf("Ignoring unknown option '%s'\n", argv[i]);
+   }
+
+   if (options.headless && !framesSet)
+      options.frames = 600;
+   if (!watchSet)
+      options.watchShaders = !options.headless;
+
+   return options;
+}
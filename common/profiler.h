@@ -0,0 +1,213 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <stdio.h>
+#include <vector>
+
+#include "gl_objects.h"
+
+// Frame profiler writing Chrome trace / Perfetto JSON ("X" complete events).
+// CPU scopes are timed with steady_clock and written as soon as they end.
+// GPU scopes are bracketed with GL_TIMESTAMP queries; results are read back
+// LATENCY frames later and only when already available, so the profiler never
+// waits on the GPU. Timestamp pairs are used rather than GL_TIME_ELAPSED since
+// elapsed queries cannot nest and carry no start time for the trace timeline.
+class Profiler {
+public:
+   static constexpr std::size_t LATENCY = 4;
+
+   Profiler() = default;
+
+   ~Profiler() {
+      close();
+   }
+
+   Profiler(const Profiler&) = delete;
+   Profiler& operator=(const Profiler&) = delete;
+
+   // Starts tracing into path; without it every call is a no-op.
+   // Needs a current context.
+   bool open(const char* path) {
+      mFile = fopen(path, "w");
+      if (!mFile) {
+         printf("Error opening trace file '%s'\n", path);
+         return false;
+      }
+
+      mPath = path;
+      mStart = clock::now();
+      fprintf(mFile, "[\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"CPU\"}}", CPU_TRACK);
+
+      mGpuTimers = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+      if (mGpuTimers) {
+         fprintf(mFile, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"GPU\"}}", GPU_TRACK);
+
+         // map GPU nanoseconds onto the CPU timeline
+         GLint64 gpuNow = 0;
+         glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+         mGpuOffset = std::int64_t(cpuNow() * 1000) - gpuNow;
+      }
+      else
+         printf("Timer queries not supported, profiling CPU only\n");
+
+      return true;
+   }
+
+   void close() {
+      if (!mFile)
+         return;
+
+      if (mGpuTimers) {
+         glFinish();
+         for (std::size_t i = 0; i < LATENCY; ++i)
+            collect(mFrames[(mFrameIndex + i) % LATENCY]);
+      }
+
+      fputs("\n]\n", mFile);
+      fclose(mFile);
+      mFile = nullptr;
+
+      printf("Trace written to '%s': %lu frames, %lu frames without GPU timings\n",
+         mPath, mFrameIndex, mGpuDropped);
+   }
+
+   bool enabled() const {
+      return mFile != nullptr;
+   }
+
+   void beginFrame() {
+      if (!mFile)
+         return;
+
+      auto& frame = mFrames[mFrameIndex % LATENCY];
+      collect(frame);
+      frame.used = 0;
+      mFrameBegin = cpuNow();
+   }
+
+   void endFrame() {
+      if (!mFile)
+         return;
+
+      writeEvent("frame", CPU_TRACK, mFrameBegin, cpuNow() - mFrameBegin);
+      ++mFrameIndex;
+   }
+
+   // Microseconds since open().
+   double cpuNow() const {
+      return std::chrono::duration<double, std::micro>(clock::now() - mStart).count();
+   }
+
+private:
+   friend class ProfileScope;
+
+   static constexpr int CPU_TRACK = 1;
+   static constexpr int GPU_TRACK = 2;
+
+   using clock = std::chrono::steady_clock;
+
+   struct GpuScope {
+      const char* name = nullptr;
+      GlQuery begin;
+      GlQuery end;
+   };
+
+   struct FrameQueries {
+      std::vector<GpuScope> scopes;
+      std::size_t used = 0;
+   };
+
+   std::size_t beginGpuScope(const char* name) {
+      if (!mGpuTimers)
+         return 0;
+
+      auto& frame = mFrames[mFrameIndex % LATENCY];
+      if (frame.used == frame.scopes.size())
+         frame.scopes.emplace_back();
+
+      auto& scope = frame.scopes[frame.used];
+      scope.name = name;
+      glQueryCounter(scope.begin.get(), GL_TIMESTAMP);
+      return frame.used++;
+   }
+
+   void endGpuScope(std::size_t index) {
+      if (!mGpuTimers)
+         return;
+
+      glQueryCounter(mFrames[mFrameIndex % LATENCY].scopes[index].end.get(), GL_TIMESTAMP);
+   }
+
+   // Writes the GPU events of a finished frame if the driver already has them.
+   void collect(FrameQueries& frame) {
+      if (frame.used == 0)
+         return;
+
+      GLint available = 0;
+      glGetQueryObjectiv(frame.scopes[frame.used - 1].end.get(), GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available) {
+         ++mGpuDropped;
+         frame.used = 0;
+         return;
+      }
+
+      for (std::size_t i = 0; i < frame.used; ++i) {
+         GLuint64 begin = 0;
+         GLuint64 end = 0;
+         glGetQueryObjectui64v(frame.scopes[i].begin.get(), GL_QUERY_RESULT, &begin);
+         glGetQueryObjectui64v(frame.scopes[i].end.get(), GL_QUERY_RESULT, &end);
+         writeEvent(frame.scopes[i].name, GPU_TRACK,
+            double(std::int64_t(begin) + mGpuOffset) / 1000, double(end - begin) / 1000);
+      }
+      frame.used = 0;
+   }
+
+   void writeEvent(const char* name, int track, double begin, double duration) {
+      fprintf(mFile, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+         name, track, begin, duration);
+   }
+
+   FILE* mFile = nullptr;
+   const char* mPath = nullptr;
+   clock::time_point mStart;
+   bool mGpuTimers = false;
+   std::int64_t mGpuOffset = 0;
+   std::array<FrameQueries, LATENCY> mFrames;
+   unsigned long mFrameIndex = 0;
+   unsigned long mGpuDropped = 0;
+   double mFrameBegin = 0;
+};
+
+// Times the enclosing block on the CPU and, when supported, on the GPU.
+// name must outlive the profiler (string literals).
+class [[nodiscard]] ProfileScope {
+public:
+   ProfileScope(Profiler& profiler, const char* name)
+      : mProfiler{ profiler }
+      , mName{ name } {
+      if (mProfiler.enabled()) {
+         mBegin = mProfiler.cpuNow();
+         mGpuIndex = mProfiler.beginGpuScope(name);
+      }
+   }
+
+   ~ProfileScope() {
+      if (mProfiler.enabled()) {
+         mProfiler.endGpuScope(mGpuIndex);
+         mProfiler.writeEvent(mName, Profiler::CPU_TRACK, mBegin, mProfiler.cpuNow() - mBegin);
+      }
+   }
+
+   ProfileScope(const ProfileScope&) = delete;
+   ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+   Profiler& mProfiler;
+   const char* mName;
+   double mBegin = 0;
+   std::size_t mGpuIndex = 0;
+};
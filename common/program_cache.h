@@ -0,0 +1,192 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <initializer_list>
+#include <span>
+#include <stdio.h>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "hash.h"
+
+// On-disk cache of linked program binaries (glGetProgramBinary/glProgramBinary).
+//
+// Entries are keyed by a hash of the shader sources and of the driver's
+// vendor, renderer and version strings, so a driver update or a shader edit
+// simply misses. A binary the driver rejects is deleted and counts as a miss.
+//
+//    const auto key = cache.key({ vShader, fShader });
+//    if (auto program = cache.load(key)) return program;
+//    ...create program, ProgramCache::prepare(program), compile, link...
+//    cache.store(key, program);
+class ProgramCache {
+public:
+   // An empty directory disables the cache. Needs a current context.
+   explicit ProgramCache(std::filesystem::path directory)
+      : mDirectory{ std::move(directory) } {
+      GLint formats = 0;
+      if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+         glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+      mSupported = formats > 0;
+
+      if (!mDirectory.empty() && !mSupported)
+         printf("Program binaries not supported by the driver, shader cache disabled\n");
+
+      for (const auto name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+         const auto value = reinterpret_cast<const char*>(glGetString(name));
+         mDriverHash = fnv1a(value ? value : "", mDriverHash);
+      }
+   }
+
+   bool enabled() const {
+      return mSupported && !mDirectory.empty();
+   }
+
+   std::uint64_t key(std::initializer_list<const char*> sources) const {
+      return key(std::span(sources.begin(), sources.size()));
+   }
+
+   std::uint64_t key(std::span<const char* const> sources) const {
+      auto hash = mDriverHash;
+      for (const auto source : sources) {
+         hash = fnv1a(source, hash);
+         // separator, so moving text between stages changes the key
+         hash = fnv1a(std::string_view("\0", 1), hash);
+      }
+      return hash;
+   }
+
+   // Linked program restored from the cache, 0 on a miss.
+   GLuint load(std::uint64_t key) {
+      if (!enabled()) {
+         ++mMisses;
+         return 0;
+      }
+
+      const auto file = path(key);
+      FILE* in = fopen(file.string().c_str(), "rb");
+      if (!in) {
+         ++mMisses;
+         return 0;
+      }
+
+      Header header;
+      std::vector<char> binary;
+      auto valid = fread(&header, sizeof(header), 1, in) == 1
+         && header.magic == MAGIC && header.key == key;
+      if (valid) {
+         binary.resize(header.size);
+         valid = fread(binary.data(), 1, binary.size(), in) == binary.size();
+      }
+      fclose(in);
+
+      GLuint program = 0;
+      if (valid) {
+         program = glCreateProgram();
+         glProgramBinary(program, header.format, binary.data(), GLsizei(binary.size()));
+
+         GLint linked = 0;
+         glGetProgramiv(program, GL_LINK_STATUS, &linked);
+         if (!linked) {
+            glDeleteProgram(program);
+            program = 0;
+         }
+      }
+
+      if (!program) {
+         std::error_code ignored;
+         std::filesystem::remove(file, ignored);
+         ++mMisses;
+         return 0;
+      }
+
+      ++mHits;
+      return program;
+   }
+
+   // Asks the driver to keep the binary retrievable; call before glLinkProgram.
+   static void prepare(GLuint program) {
+      glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+   }
+
+   void store(std::uint64_t key, GLuint program) {
+      if (!enabled())
+         return;
+
+      GLint length = 0;
+      glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+      if (length <= 0)
+         return;
+
+      Header header;
+      header.key = key;
+      std::vector<char> binary(length);
+      glGetProgramBinary(program, length, nullptr, &header.format, binary.data());
+      header.size = std::uint32_t(length);
+
+      std::error_code error;
+      std::filesystem::create_directories(mDirectory, error);
+
+      // write to a temporary first so a concurrent reader never sees half a file
+      const auto file = path(key);
+      auto temporary = file;
+      temporary += ".tmp";
+
+      FILE* out = fopen(temporary.string().c_str(), "wb");
+      if (!out) {
+         printf("Error writing shader cache entry '%s'\n", temporary.string().c_str());
+         return;
+      }
+      const auto written = fwrite(&header, sizeof(header), 1, out) == 1
+         && fwrite(binary.data(), 1, binary.size(), out) == binary.size();
+      fclose(out);
+
+      if (written)
+         std::filesystem::rename(temporary, file, error);
+      if (!written || error)
+         std::filesystem::remove(temporary, error);
+      else
+         ++mStores;
+   }
+
+   unsigned long hits() const {
+      return mHits;
+   }
+
+   unsigned long misses() const {
+      return mMisses;
+   }
+
+   void printStats() const {
+      printf("Shader cache: %lu hits, %lu misses, %lu stored%s\n",
+         mHits, mMisses, mStores, enabled() ? "" : " (disabled)");
+   }
+
+private:
+   static constexpr std::uint32_t MAGIC = 0x31425050; // "PPB1"
+
+   struct Header {
+      std::uint32_t magic = MAGIC;
+      GLenum format = 0;
+      std::uint64_t key = 0;
+      std::uint32_t size = 0;
+      std::uint32_t reserved = 0;
+   };
+
+   std::filesystem::path path(std::uint64_t key) const {
+      char name[32];
+      snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+      return mDirectory / name;
+   }
+
+   std::filesystem::path mDirectory;
+   bool mSupported = false;
+   std::uint64_t mDriverHash = FNV_OFFSET_BASIS;
+   unsigned long mHits = 0;
+   unsigned long mMisses = 0;
+   unsigned long mStores = 0;
+};
@@ -0,0 +1,308 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdio.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "hash.h"
+
+// Name of a uniform or uniform block, hashed while compiling: lookups by
+// name never touch a string at run time.
+//
+//    reflection.set("objectCount", count);   // "objectCount" hashed by the compiler
+struct UniformName {
+   consteval UniformName(const char* text)
+      : name{ text }
+      , hash{ fnv1a(text) } {
+   }
+
+   std::string_view name;
+   std::uint64_t hash;
+};
+
+// The active uniforms and uniform blocks of a linked program, enumerated once
+// after linking into flat tables sorted by name hash. set() remembers the
+// last value of every uniform and skips the glUniform* call when it is the
+// same again; bindBlock() does the same for block bindings.
+//
+// set() writes to the program in use, as glUniform* does: bind it first.
+// Uniforms the linker removed are ignored, like location -1. A program that
+// was relinked, or deleted and its name reused, needs reflect() again.
+class ProgramReflection {
+public:
+   ProgramReflection() = default;
+
+   explicit ProgramReflection(GLuint program) {
+      reflect(program);
+   }
+
+   // Reads the uniforms and blocks of program; forgets every cached value.
+   void reflect(GLuint program) {
+      mProgram = program;
+      mUniforms.clear();
+      mBlocks.clear();
+      mValues.clear();
+      if (!program)
+         return;
+
+      GLint count = 0;
+      GLint maxLength = 0;
+      glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+      glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+      std::string name(std::size_t(std::max(maxLength, 1)), '\0');
+      for (GLuint i = 0; i < GLuint(count); ++i) {
+         // members of uniform blocks have no location, they live in buffers
+         GLint block = -1;
+         glGetActiveUniformsiv(program, 1, &i, GL_UNIFORM_BLOCK_INDEX, &block);
+         if (block != -1)
+            continue;
+
+         GLsizei length = 0;
+         GLint size = 0;
+         GLenum type = 0;
+         glGetActiveUniform(program, i, GLsizei(name.size()), &length, &size, &type, name.data());
+         auto text = std::string_view(name.data(), std::size_t(length));
+         if (text.ends_with("[0]"))
+            text.remove_suffix(3);
+
+         Uniform uniform;
+         uniform.hash = fnv1a(text);
+         uniform.location = glGetUniformLocation(program, name.c_str());
+         uniform.type = type;
+         uniform.size = size;
+         uniform.value = mValues.size();
+         mValues.resize(mValues.size() + std::size_t(size) * std::size_t(describe(type).components) * 4);
+         mUniforms.push_back(uniform);
+      }
+
+      glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+      glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+      name.assign(std::size_t(std::max(maxLength, 1)), '\0');
+      for (GLuint i = 0; i < GLuint(count); ++i) {
+         GLsizei length = 0;
+         glGetActiveUniformBlockName(program, i, GLsizei(name.size()), &length, name.data());
+         Block block;
+         block.hash = fnv1a(std::string_view(name.data(), std::size_t(length)));
+         block.index = i;
+         glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_BINDING, &block.binding);
+         glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.size);
+         mBlocks.push_back(block);
+      }
+
+      const auto byHash = [](const auto& a, const auto& b) { return a.hash < b.hash; };
+      std::sort(mUniforms.begin(), mUniforms.end(), byHash);
+      std::sort(mBlocks.begin(), mBlocks.end(), byHash);
+      const auto sameHash = [](const auto& a, const auto& b) { return a.hash == b.hash; };
+      if (std::adjacent_find(mUniforms.begin(), mUniforms.end(), sameHash) != mUniforms.end()
+         || std::adjacent_find(mBlocks.begin(), mBlocks.end(), sameHash) != mBlocks.end())
+         printf("Program %u: two uniform names share a hash, lookups of them are ambiguous\n", program);
+   }
+
+   GLuint program() const {
+      return mProgram;
+   }
+
+   std::size_t uniformCount() const {
+      return mUniforms.size();
+   }
+
+   std::size_t blockCount() const {
+      return mBlocks.size();
+   }
+
+   // -1 when the program has no active uniform of that name.
+   GLint location(UniformName name) const {
+      const auto* uniform = find(mUniforms, name);
+      return uniform ? uniform->location : -1;
+   }
+
+   // GL_INVALID_INDEX when the program has no active block of that name.
+   GLuint blockIndex(UniformName name) const {
+      const auto* block = find(mBlocks, name);
+      return block ? block->index : GL_INVALID_INDEX;
+   }
+
+   GLint blockSize(UniformName name) const {
+      const auto* block = find(mBlocks, name);
+      return block ? block->size : 0;
+   }
+
+   // Values of a float, vecN or matN uniform (or array of them), tightly packed.
+   void set(UniformName name, std::span<const float> values) {
+      write(name, Kind::Float, values.data(), values.size());
+   }
+
+   // Values of an int, ivecN, bool or sampler uniform.
+   void set(UniformName name, std::span<const GLint> values) {
+      write(name, Kind::Int, values.data(), values.size());
+   }
+
+   // Values of a uint or uvecN uniform.
+   void set(UniformName name, std::span<const GLuint> values) {
+      write(name, Kind::Uint, values.data(), values.size());
+   }
+
+   void set(UniformName name, float value) {
+      set(name, std::span<const float>(&value, 1));
+   }
+
+   void set(UniformName name, GLint value) {
+      set(name, std::span<const GLint>(&value, 1));
+   }
+
+   void set(UniformName name, GLuint value) {
+      set(name, std::span<const GLuint>(&value, 1));
+   }
+
+   // Block bindings are not part of a program binary: set them after every
+   // load. Blocks the linker removed are ignored.
+   void bindBlock(UniformName name, GLuint binding) {
+      auto* block = find(mBlocks, name);
+      if (!block)
+         return;
+      if (block->binding == GLint(binding)) {
+         ++mSkipped;
+         return;
+      }
+      block->binding = GLint(binding);
+      glUniformBlockBinding(mProgram, block->index, binding);
+      ++mCalls;
+   }
+
+   // glUniform* and glUniformBlockBinding calls made and skipped as redundant
+   unsigned long calls() const {
+      return mCalls;
+   }
+
+   unsigned long skipped() const {
+      return mSkipped;
+   }
+
+   void printStats(const char* name) const {
+      const auto total = mCalls + mSkipped;
+      printf("%s uniforms: %zu uniforms, %zu blocks, %lu calls, %lu skipped as unchanged (%.1f%%)\n",
+         name, mUniforms.size(), mBlocks.size(), mCalls, mSkipped, total ? 100.0 * mSkipped / total : 0.0);
+   }
+
+private:
+   enum class Kind { Float, Int, Uint };
+
+   struct Uniform {
+      std::uint64_t hash = 0;
+      GLint location = -1;
+      GLenum type = 0;
+      GLint size = 0;
+      // offset of the last value in mValues, and how many bytes of it are known
+      std::size_t value = 0;
+      std::size_t known = 0;
+      bool reported = false;
+   };
+
+   struct Block {
+      std::uint64_t hash = 0;
+      GLuint index = 0;
+      GLint binding = 0;
+      GLint size = 0;
+   };
+
+   struct TypeInfo {
+      Kind kind;
+      int components;
+   };
+
+   // Anything not listed is a sampler or image, set as one int.
+   static TypeInfo describe(GLenum type) {
+      switch (type) {
+      case GL_FLOAT: return { Kind::Float, 1 };
+      case GL_FLOAT_VEC2: return { Kind::Float, 2 };
+      case GL_FLOAT_VEC3: return { Kind::Float, 3 };
+      case GL_FLOAT_VEC4: return { Kind::Float, 4 };
+      case GL_FLOAT_MAT2: return { Kind::Float, 4 };
+      case GL_FLOAT_MAT3: return { Kind::Float, 9 };
+      case GL_FLOAT_MAT4: return { Kind::Float, 16 };
+      case GL_INT_VEC2:
+      case GL_BOOL_VEC2: return { Kind::Int, 2 };
+      case GL_INT_VEC3:
+      case GL_BOOL_VEC3: return { Kind::Int, 3 };
+      case GL_INT_VEC4:
+      case GL_BOOL_VEC4: return { Kind::Int, 4 };
+      case GL_UNSIGNED_INT: return { Kind::Uint, 1 };
+      case GL_UNSIGNED_INT_VEC2: return { Kind::Uint, 2 };
+      case GL_UNSIGNED_INT_VEC3: return { Kind::Uint, 3 };
+      case GL_UNSIGNED_INT_VEC4: return { Kind::Uint, 4 };
+      default: return { Kind::Int, 1 };
+      }
+   }
+
+   // Entry of name in a table sorted by hash, const or not.
+   template <typename Table>
+   static auto find(Table& table, UniformName name) -> decltype(&table[0]) {
+      const auto at = std::lower_bound(table.begin(), table.end(), name.hash, [](const auto& entry, std::uint64_t hash) { return entry.hash < hash; });
+      return at != table.end() && at->hash == name.hash ? &*at : nullptr;
+   }
+
+   void write(UniformName name, Kind kind, const void* data, std::size_t values) {
+      auto* uniform = find(mUniforms, name);
+      if (!uniform)
+         return;
+      const auto info = describe(uniform->type);
+      if (info.kind != kind) {
+         if (!uniform->reported)
+            printf("Uniform '%.*s' of program %u set with the wrong value type\n", int(name.name.size()), name.name.data(), mProgram);
+         uniform->reported = true;
+         return;
+      }
+
+      const auto count = GLsizei(std::min(values / std::size_t(info.components), std::size_t(uniform->size)));
+      if (count == 0)
+         return;
+      const auto bytes = std::size_t(count) * std::size_t(info.components) * 4;
+      auto* cached = mValues.data() + uniform->value;
+      if (bytes <= uniform->known && std::memcmp(cached, data, bytes) == 0) {
+         ++mSkipped;
+         return;
+      }
+      std::memcpy(cached, data, bytes);
+      uniform->known = std::max(uniform->known, bytes);
+      ++mCalls;
+
+      const auto location = uniform->location;
+      const auto* f = static_cast<const GLfloat*>(data);
+      const auto* i = static_cast<const GLint*>(data);
+      const auto* u = static_cast<const GLuint*>(data);
+      switch (uniform->type) {
+      case GL_FLOAT: glUniform1fv(location, count, f); break;
+      case GL_FLOAT_VEC2: glUniform2fv(location, count, f); break;
+      case GL_FLOAT_VEC3: glUniform3fv(location, count, f); break;
+      case GL_FLOAT_VEC4: glUniform4fv(location, count, f); break;
+      case GL_FLOAT_MAT2: glUniformMatrix2fv(location, count, GL_FALSE, f); break;
+      case GL_FLOAT_MAT3: glUniformMatrix3fv(location, count, GL_FALSE, f); break;
+      case GL_FLOAT_MAT4: glUniformMatrix4fv(location, count, GL_FALSE, f); break;
+      case GL_INT_VEC2:
+      case GL_BOOL_VEC2: glUniform2iv(location, count, i); break;
+      case GL_INT_VEC3:
+      case GL_BOOL_VEC3: glUniform3iv(location, count, i); break;
+      case GL_INT_VEC4:
+      case GL_BOOL_VEC4: glUniform4iv(location, count, i); break;
+      case GL_UNSIGNED_INT: glUniform1uiv(location, count, u); break;
+      case GL_UNSIGNED_INT_VEC2: glUniform2uiv(location, count, u); break;
+      case GL_UNSIGNED_INT_VEC3: glUniform3uiv(location, count, u); break;
+      case GL_UNSIGNED_INT_VEC4: glUniform4uiv(location, count, u); break;
+      default: glUniform1iv(location, count, i); break;
+      }
+   }
+
+   GLuint mProgram = 0;
+   std::vector<Uniform> mUniforms;
+   std::vector<Block> mBlocks;
+   std::vector<std::uint8_t> mValues;
+   unsigned long mCalls = 0;
+   unsigned long mSkipped = 0;
+};
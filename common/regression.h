@@ -0,0 +1,109 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <span>
+#include <stdio.h>
+#include <string>
+
+#include "frame_stats.h"
+#include "image.h"
+#include "options.h"
+#include "surface.h"
+
+// --screenshot, --golden and --budget-* of a --frames run: reads the last
+// frame back before it is presented, then checks it and the frame times.
+//
+//    check.frame(i, *surface);   // right before swapBuffers()
+//    ...
+//    return check.finish(frameRate);
+class RegressionCheck {
+public:
+   explicit RegressionCheck(const Options& options)
+      : mOptions{ options } {
+      if ((options.screenshot || options.golden) && options.frames == 0)
+         printf("--screenshot/--golden need --frames, the last frame is not known otherwise\n");
+   }
+
+   // Reads back the bound framebuffer if frame is the last one.
+   void frame(unsigned long frame, Surface& surface) {
+      if (!wanted(frame))
+         return;
+
+      surface.getFramebufferSize(&mImage.width, &mImage.height);
+      mImage.pixels.resize(std::size_t(mImage.width) * mImage.height);
+      glPixelStorei(GL_PACK_ALIGNMENT, 4);
+      glReadPixels(0, 0, mImage.width, mImage.height, GL_RGBA, GL_UNSIGNED_BYTE, mImage.pixels.data());
+   }
+
+   // The same for a frame rendered on the CPU: RGBA8, bottom row first.
+   void frame(unsigned long frame, int width, int height, std::span<const std::uint32_t> pixels) {
+      if (!wanted(frame))
+         return;
+
+      mImage.width = width;
+      mImage.height = height;
+      mImage.pixels.assign(pixels.begin(), pixels.end());
+   }
+
+   // Runs the checks; the process exit code, 0 when everything passed.
+   int finish(const FrameRateCounter& frameRate) const {
+      auto passed = true;
+
+      if (mOptions.screenshot && !mImage.pixels.empty())
+         passed &= writePng(mOptions.screenshot, mImage);
+
+      if (mOptions.golden)
+         passed &= compareGolden();
+
+      const auto budget = [&](const char* name, double percent, double limit) {
+         if (limit <= 0)
+            return true;
+         const auto time = frameRate.percentile(percent);
+         const auto within = time <= limit;
+         printf("Frame time %s %.3f ms, budget %.3f ms: %s\n", name, time, limit, within ? "ok" : "FAILED");
+         return within;
+      };
+      passed &= budget("p50", 50, mOptions.budgetP50);
+      passed &= budget("p99", 99, mOptions.budgetP99);
+
+      return passed ? 0 : 1;
+   }
+
+private:
+   bool wanted(unsigned long frame) const {
+      return (mOptions.screenshot || mOptions.golden) && frame + 1 == mOptions.frames;
+   }
+
+   bool compareGolden() const {
+      if (mImage.pixels.empty()) {
+         printf("Golden image check FAILED: no frame was captured\n");
+         return false;
+      }
+
+      const auto expected = readPng(mOptions.golden);
+      if (!expected)
+         return false;
+
+      const auto diff = compareImages(mImage, *expected, mOptions.tolerance);
+      const auto allowed = mOptions.maxDiffPercent / 100 * mImage.pixels.size();
+      const auto passed = !diff.sizeMismatch && diff.differentPixels <= allowed;
+
+      if (diff.sizeMismatch)
+         printf("Golden image check FAILED: frame is %dx%d, '%s' is %dx%d\n",
+            mImage.width, mImage.height, mOptions.golden, expected->width, expected->height);
+      else
+         printf("Golden image check %s: %zu pixels (%.3f%%) differ by more than %d, max difference %d\n",
+            passed ? "ok" : "FAILED", diff.differentPixels, 100.0 * diff.differentPixels / mImage.pixels.size(),
+            mOptions.tolerance, diff.maxDelta);
+
+      // keep what was rendered next to the golden image for inspection
+      if (!passed)
+         writePng((std::string(mOptions.golden) + ".actual.png").c_str(), mImage);
+      return passed;
+   }
+
+   const Options& mOptions;
+   Image mImage;
+};
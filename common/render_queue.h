@@ -0,0 +1,310 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <stdio.h>
+#include <vector>
+
+#include "geometry.h"
+
+// The program, VAO, texture, blending and uniform block ranges last set through it, so
+// setting the same state again issues nothing. Code that changes these behind
+// its back (GeometryRegistry::setInstanceMatrices, glUseProgram) has to call
+// invalidate() afterwards.
+class GlStateCache {
+public:
+   static constexpr GLuint UNIFORM_BINDINGS = 8;
+
+   void useProgram(GLuint program) {
+      if (set(mProgram, program))
+         glUseProgram(program);
+   }
+
+   void bindVertexArray(GLuint vertexArray) {
+      if (set(mVertexArray, vertexArray))
+         glBindVertexArray(vertexArray);
+   }
+
+   // GL_TEXTURE_2D of texture unit 0, the only one the samples sample from.
+   void bindTexture(GLuint texture) {
+      if (set(mTexture, texture))
+         glBindTexture(GL_TEXTURE_2D, texture);
+   }
+
+   // Blending is the usual alpha blend: src alpha, one minus src alpha.
+   void setBlend(bool enabled) {
+      if (!set(mBlend, GLuint(enabled)))
+         return;
+      if (enabled) {
+         glEnable(GL_BLEND);
+         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+      }
+      else
+         glDisable(GL_BLEND);
+   }
+
+   void bindUniformRange(GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+      if (index >= UNIFORM_BINDINGS) {
+         ++mChanges;
+         glBindBufferRange(GL_UNIFORM_BUFFER, index, buffer, offset, size);
+         return;
+      }
+
+      auto& binding = mUniforms[index];
+      if (binding.buffer == buffer && binding.offset == offset && binding.size == size) {
+         ++mSkipped;
+         return;
+      }
+      binding = { buffer, offset, size };
+      ++mChanges;
+      glBindBufferRange(GL_UNIFORM_BUFFER, index, buffer, offset, size);
+   }
+
+   // Forgets everything, the next call of each setter reaches GL.
+   void invalidate() {
+      mProgram = mVertexArray = mTexture = mBlend = UNKNOWN;
+      mUniforms.fill({});
+   }
+
+   // State changes that reached GL, and the redundant ones dropped.
+   unsigned long changes() const {
+      return mChanges;
+   }
+
+   unsigned long skipped() const {
+      return mSkipped;
+   }
+
+private:
+   static constexpr GLuint UNKNOWN = ~0u;
+
+   struct UniformRange {
+      GLuint buffer = UNKNOWN;
+      GLintptr offset = 0;
+      GLsizeiptr size = 0;
+   };
+
+   bool set(GLuint& current, GLuint value) {
+      if (current == value) {
+         ++mSkipped;
+         return false;
+      }
+      current = value;
+      ++mChanges;
+      return true;
+   }
+
+   GLuint mProgram = UNKNOWN;
+   GLuint mVertexArray = UNKNOWN;
+   GLuint mTexture = UNKNOWN;
+   GLuint mBlend = UNKNOWN;
+   std::array<UniformRange, UNIFORM_BINDINGS> mUniforms{};
+
+   unsigned long mChanges = 0;
+   unsigned long mSkipped = 0;
+};
+
+// Sort key of a draw, most significant bits first. Opaque draws sort by
+// program, VAO, primitive and texture, then front to back; blended draws
+// come after every opaque one, back to front, then by state. depth is in
+// [0, 1]; GL names are small, the low bits of each keep them apart.
+//
+//    opaque:  0 | program:12 | vao:12 | mode:4 | texture:11 | depth:24
+//    blended: 1 | far-to-near depth:24 | program:12 | vao:12 | mode:4 | texture:11
+inline std::uint64_t makeSortKey(GLuint program, GLuint vertexArray, GLenum mode, bool blend, float depth, GLuint texture = 0) {
+   const auto quantized = std::uint64_t(std::clamp(depth, 0.0f, 1.0f) * 0xffffff);
+   const auto state = std::uint64_t(program & 0xfff) << 27 | std::uint64_t(vertexArray & 0xfff) << 15
+      | std::uint64_t(mode & 0xf) << 11 | std::uint64_t(texture & 0x7ff);
+
+   if (!blend)
+      return state << 24 | quantized;
+   return 1ull << 63 | (0xffffff - quantized) << 39 | state;
+}
+
+// One draw of a mesh range and the state it needs.
+struct DrawCommand {
+   std::uint64_t key = 0;
+   GLuint program = 0;
+   MeshRange mesh;
+   bool blend = false;
+   // bound on texture unit 0 before the draw, 0 leaves the binding alone
+   GLuint texture = 0;
+   // draw this many instances, 0 draws once
+   GLsizei instances = 0;
+   // uniform block range bound before the draw, buffer 0 binds none
+   GLuint uniformIndex = 0;
+   GLuint uniformBuffer = 0;
+   GLintptr uniformOffset = 0;
+   GLsizeiptr uniformSize = 0;
+};
+
+// A single draw of mesh without uniform blocks, keyed for its state.
+inline DrawCommand makeDrawCommand(GLuint program, const MeshRange& mesh, bool blend = false, float depth = 0, GLuint texture = 0) {
+   DrawCommand command;
+   command.key = makeSortKey(program, mesh.vertexArray, mesh.mode, blend, depth, texture);
+   command.program = program;
+   command.mesh = mesh;
+   command.blend = blend;
+   command.texture = texture;
+   return command;
+}
+
+// Collects a frame's draws and issues them in sort key order: a radix sort
+// groups draws by state, the state cache drops binds that are already in
+// place (also across frames), and consecutive draws that need identical state,
+// typically ranges of one merged VAO, go out in a single glMultiDrawArrays
+// (glMultiDrawElementsBaseVertex for indexed ranges).
+//
+//    queue.submit(command)...;
+//    queue.flush();   // once per frame, after the last submit
+class RenderQueue {
+public:
+   void submit(const DrawCommand& command) {
+      mCommands.push_back(command);
+   }
+
+   void flush() {
+      const auto start = std::chrono::steady_clock::now();
+      sort();
+      mSortSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      const auto changesBefore = mState.changes();
+      for (std::size_t i = 0; i < mOrder.size();) {
+         const auto& command = mCommands[mOrder[i].index];
+         apply(command);
+
+         if (command.instances) {
+            drawRange(command.mesh, command.instances);
+            ++mDraws;
+            ++i;
+            continue;
+         }
+
+         mFirsts.clear();
+         mCounts.clear();
+         mIndexOffsets.clear();
+         for (; i < mOrder.size() && batchable(command, mCommands[mOrder[i].index]); ++i) {
+            const auto& mesh = mCommands[mOrder[i].index].mesh;
+            mFirsts.push_back(mesh.first);
+            mCounts.push_back(mesh.count);
+            mIndexOffsets.push_back(reinterpret_cast<const void*>(mesh.indexOffset));
+         }
+         if (mFirsts.size() == 1)
+            drawRange(command.mesh);
+         else {
+            if (command.mesh.indexType == GL_NONE)
+               glMultiDrawArrays(command.mesh.mode, mFirsts.data(), mCounts.data(), GLsizei(mFirsts.size()));
+            else
+               glMultiDrawElementsBaseVertex(command.mesh.mode, mCounts.data(), command.mesh.indexType,
+                  mIndexOffsets.data(), GLsizei(mFirsts.size()), mFirsts.data());
+            ++mMultiDraws;
+         }
+         ++mDraws;
+      }
+      mStateChanges += mState.changes() - changesBefore;
+
+      // what immediate submission costs: every draw binds its program, VAO,
+      // texture and uniforms, and the frame ends binding VAO 0 and program 0
+      for (const auto& command : mCommands)
+         mImmediateStateChanges += 2 + (command.texture != 0) + (command.uniformBuffer != 0);
+      mImmediateStateChanges += 2;
+
+      mSubmitted += mCommands.size();
+      mCommands.clear();
+      ++mFrames;
+   }
+
+   // Room for commands draws a frame, so frames up to that many allocate nothing.
+   void reserve(std::size_t commands) {
+      mCommands.reserve(commands);
+      mOrder.reserve(commands);
+      mScratch.reserve(commands);
+      mFirsts.reserve(commands);
+      mCounts.reserve(commands);
+      mIndexOffsets.reserve(commands);
+   }
+
+   GlStateCache& state() {
+      return mState;
+   }
+
+   void printStats() const {
+      const auto frames = double(std::max(mFrames, 1ul));
+      printf("Render queue: %lu frames, per frame %.1f commands, %.1f state changes (%.1f immediate), "
+         "%.1f draw calls (%.1f immediate, %.1f multi-draws), %lu binds dropped, sort %.3f us/frame\n",
+         mFrames, mSubmitted / frames, mStateChanges / frames, mImmediateStateChanges / frames,
+         mDraws / frames, mSubmitted / frames, mMultiDraws / frames, mState.skipped(), mSortSeconds * 1e6 / frames);
+   }
+
+private:
+   struct SortEntry {
+      std::uint64_t key;
+      std::uint32_t index;
+   };
+
+   // LSD radix sort of (key, index), a byte per pass; passes where every key
+   // has the same byte are skipped, which is most of them for small queues.
+   void sort() {
+      mOrder.resize(mCommands.size());
+      for (std::size_t i = 0; i < mCommands.size(); ++i)
+         mOrder[i] = { mCommands[i].key, std::uint32_t(i) };
+      mScratch.resize(mOrder.size());
+
+      for (unsigned shift = 0; shift < 64; shift += 8) {
+         std::array<std::size_t, 257> offsets{};
+         for (const auto& entry : mOrder)
+            ++offsets[((entry.key >> shift) & 0xff) + 1];
+         if (std::any_of(offsets.begin() + 1, offsets.end(), [&](std::size_t count) { return count == mOrder.size(); }))
+            continue;
+
+         for (std::size_t digit = 1; digit < offsets.size(); ++digit)
+            offsets[digit] += offsets[digit - 1];
+         for (const auto& entry : mOrder)
+            mScratch[offsets[(entry.key >> shift) & 0xff]++] = entry;
+         mOrder.swap(mScratch);
+      }
+   }
+
+   void apply(const DrawCommand& command) {
+      mState.useProgram(command.program);
+      mState.bindVertexArray(command.mesh.vertexArray);
+      mState.setBlend(command.blend);
+      if (command.texture)
+         mState.bindTexture(command.texture);
+      if (command.uniformBuffer)
+         mState.bindUniformRange(command.uniformIndex, command.uniformBuffer, command.uniformOffset, command.uniformSize);
+   }
+
+   static bool batchable(const DrawCommand& first, const DrawCommand& next) {
+      return next.instances == 0
+         && next.program == first.program
+         && next.mesh.vertexArray == first.mesh.vertexArray
+         && next.mesh.mode == first.mesh.mode
+         && next.mesh.indexType == first.mesh.indexType
+         && next.blend == first.blend
+         && next.texture == first.texture
+         && next.uniformBuffer == first.uniformBuffer
+         && (!next.uniformBuffer || (next.uniformIndex == first.uniformIndex
+            && next.uniformOffset == first.uniformOffset && next.uniformSize == first.uniformSize));
+   }
+
+   GlStateCache mState;
+   std::vector<DrawCommand> mCommands;
+   std::vector<SortEntry> mOrder;
+   std::vector<SortEntry> mScratch;
+   std::vector<GLint> mFirsts;
+   std::vector<GLsizei> mCounts;
+   std::vector<const void*> mIndexOffsets;
+
+   unsigned long mFrames = 0;
+   unsigned long mSubmitted = 0;
+   unsigned long mDraws = 0;
+   unsigned long mMultiDraws = 0;
+   unsigned long mStateChanges = 0;
+   unsigned long mImmediateStateChanges = 0;
+   double mSortSeconds = 0;
+};
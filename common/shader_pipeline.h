@@ -0,0 +1,283 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <span>
+#include <stdio.h>
+#include <vector>
+
+#include "program_cache.h"
+
+// Placeholder drawn while the real programs are still compiling.
+static const char* FALLBACK_VERTEX_SHADER = R"(
+#version 330
+layout (location = 0) in vec3 pos;
+
+void main(){
+   gl_Position = vec4(0.5 * pos, 1.0);
+}
+)";
+
+static const char* FALLBACK_FRAGMENT_SHADER = R"(
+#version 330
+out vec4 color;
+
+void main(){
+   color = vec4(0.5, 0.5, 0.5, 1.0);
+}
+)";
+
+struct ShaderSource {
+   GLenum type;
+   const char* code;
+};
+
+using ProgramHandle = std::uint32_t;
+
+// Asynchronous program builds.
+//
+// submit() issues every compile and the link without asking for their status,
+// so the driver is free to build them in the background
+// (GL_KHR_parallel_shader_compile, or the ARB version of it). poll() once a
+// frame picks up the programs whose GL_COMPLETION_STATUS turned true; only then
+// are compile/link logs read, which would otherwise block. Without the
+// extension poll() resolves everything pending, the old blocking behaviour.
+//
+// Programs found in the ProgramCache are ready right after submit().
+class ShaderPipeline {
+public:
+   explicit ShaderPipeline(ProgramCache* cache = nullptr)
+      : mCache{ cache } {
+#if defined(GL_KHR_parallel_shader_compile)
+      if (GLEW_KHR_parallel_shader_compile) {
+         glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu); // as many as the driver likes
+         mParallel = true;
+      }
+#endif
+#if defined(GL_ARB_parallel_shader_compile)
+      if (!mParallel && GLEW_ARB_parallel_shader_compile) {
+         glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+         mParallel = true;
+      }
+#endif
+   }
+
+   ~ShaderPipeline() {
+      for (auto& entry : mEntries) {
+         deleteShaders(entry);
+         if (entry.program)
+            glDeleteProgram(entry.program);
+      }
+   }
+
+   ShaderPipeline(const ShaderPipeline&) = delete;
+   ShaderPipeline& operator=(const ShaderPipeline&) = delete;
+
+   // onReady runs once the program has linked (e.g. to set block bindings).
+   ProgramHandle submit(std::initializer_list<ShaderSource> sources, std::function<void(GLuint)> onReady = {}) {
+      return submit(std::span(sources.begin(), sources.size()), std::move(onReady));
+   }
+
+   ProgramHandle submit(std::span<const ShaderSource> sources, std::function<void(GLuint)> onReady = {}) {
+      if (mPending == 0)
+         mStart = std::chrono::steady_clock::now();
+
+      Entry entry;
+      entry.onReady = std::move(onReady);
+
+      if (mCache) {
+         std::vector<const char*> codes;
+         for (const auto& source : sources)
+            codes.push_back(source.code);
+         entry.key = mCache->key(codes);
+         entry.program = mCache->load(entry.key);
+      }
+
+      const auto handle = ProgramHandle(mEntries.size());
+      if (entry.program) {
+         mEntries.push_back(std::move(entry));
+         ++mPending;
+         finish(mEntries.back(), true);
+         return handle;
+      }
+
+      entry.program = glCreateProgram();
+      for (const auto& source : sources) {
+         const auto shader = glCreateShader(source.type);
+         glShaderSource(shader, 1, &source.code, nullptr);
+         glCompileShader(shader);
+         glAttachShader(entry.program, shader);
+         entry.shaders.push_back(shader);
+      }
+      ProgramCache::prepare(entry.program);
+      glLinkProgram(entry.program);
+
+      mEntries.push_back(std::move(entry));
+      ++mPending;
+      return handle;
+   }
+
+   // Resolves finished builds without blocking; true when nothing is pending.
+   bool poll() {
+      if (mPending == 0)
+         return true;
+
+      ++mPolls;
+      for (auto& entry : mEntries) {
+         if (entry.state != State::Pending)
+            continue;
+
+         GLint done = GL_TRUE;
+         if (mParallel)
+            glGetProgramiv(entry.program, COMPLETION_STATUS, &done);
+         if (done)
+            finish(entry, false);
+      }
+      return mPending == 0;
+   }
+
+   // Blocks until handle is built; true when it linked.
+   bool wait(ProgramHandle handle) {
+      auto& entry = mEntries[handle];
+      if (entry.state == State::Pending)
+         finish(entry, false);
+      return entry.state == State::Ready;
+   }
+
+   // Deletes the program of handle once it is no longer needed, e.g. after a
+   // rebuild replaced it; a pending build is finished first.
+   void release(ProgramHandle handle) {
+      auto& entry = mEntries[handle];
+      if (entry.state == State::Pending)
+         finish(entry, false);
+      if (entry.program)
+         glDeleteProgram(entry.program);
+      entry.program = 0;
+      entry.state = State::Released;
+   }
+
+   bool ready(ProgramHandle handle) const {
+      return mEntries[handle].state == State::Ready;
+   }
+
+   bool failed(ProgramHandle handle) const {
+      return mEntries[handle].state == State::Failed;
+   }
+
+   // The linked program, 0 while pending or after a failure.
+   GLuint program(ProgramHandle handle) const {
+      return ready(handle) ? mEntries[handle].program : 0;
+   }
+
+   bool parallel() const {
+      return mParallel;
+   }
+
+   void printStats() const {
+      std::size_t ready = 0;
+      std::size_t failed = 0;
+      std::size_t released = 0;
+      for (const auto& entry : mEntries) {
+         ready += entry.state == State::Ready;
+         failed += entry.state == State::Failed;
+         released += entry.state == State::Released;
+      }
+      printf("Shader pipeline: %zu programs (%zu ready, %zu failed, %zu pending, %zu released), %s compile, last ready after %.3f ms, %lu polls\n",
+         mEntries.size(), ready, failed, mPending, released, mParallel ? "parallel" : "serial", mReadySeconds * 1000, mPolls);
+   }
+
+private:
+   // GL_COMPLETION_STATUS_KHR, same value as the ARB enum
+   static constexpr GLenum COMPLETION_STATUS = 0x91B1;
+
+   enum class State {
+      Pending,
+      Ready,
+      Failed,
+      Released
+   };
+
+   struct Entry {
+      GLuint program = 0;
+      std::vector<GLuint> shaders;
+      std::uint64_t key = 0;
+      State state = State::Pending;
+      std::function<void(GLuint)> onReady;
+   };
+
+   // Reads the build results of entry; blocks if the driver is not done yet.
+   void finish(Entry& entry, bool cached) {
+      GLint result = 0;
+      GLchar log[1024] = "";
+      auto ok = true;
+
+      if (!cached) {
+         for (const auto shader : entry.shaders) {
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
+            if (!result) {
+               glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+               printf("Error compiling shader: '%s'\n", log);
+               ok = false;
+            }
+         }
+
+         glGetProgramiv(entry.program, GL_LINK_STATUS, &result);
+         if (ok && !result) {
+            glGetProgramInfoLog(entry.program, sizeof(log), nullptr, log);
+            printf("Error linking program: '%s'\n", log);
+            ok = false;
+         }
+      }
+
+#ifndef NDEBUG
+      // validation checks the program against the GL state current right now,
+      // not the state it will be drawn with: a hint, never a reason to drop it
+      if (ok) {
+         glValidateProgram(entry.program);
+         glGetProgramiv(entry.program, GL_VALIDATE_STATUS, &result);
+         if (!result) {
+            glGetProgramInfoLog(entry.program, sizeof(log), nullptr, log);
+            printf("Warning: program does not validate against the current state: '%s'\n", log);
+         }
+      }
+#endif
+      deleteShaders(entry);
+
+      if (!ok) {
+         glDeleteProgram(entry.program);
+         entry.program = 0;
+         entry.state = State::Failed;
+      }
+      else {
+         if (mCache && !cached)
+            mCache->store(entry.key, entry.program);
+         if (entry.onReady)
+            entry.onReady(entry.program);
+         entry.state = State::Ready;
+      }
+
+      if (--mPending == 0)
+         mReadySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count();
+   }
+
+   void deleteShaders(Entry& entry) {
+      for (const auto shader : entry.shaders) {
+         if (entry.program)
+            glDetachShader(entry.program, shader);
+         glDeleteShader(shader);
+      }
+      entry.shaders.clear();
+   }
+
+   ProgramCache* mCache = nullptr;
+   bool mParallel = false;
+   std::vector<Entry> mEntries;
+   std::size_t mPending = 0;
+   std::chrono::steady_clock::time_point mStart;
+   double mReadySeconds = 0;
+   unsigned long mPolls = 0;
+};
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <optional>
+#include <stdio.h>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "file_watcher.h"
+#include "shader_pipeline.h"
+
+// One stage of a program, path relative to the ShaderReloader's directory.
+struct ShaderFile {
+   GLenum type;
+   const char* path;
+};
+
+// Reads path with every `#include "file"` line replaced by that file, looked
+// up next to the including file and then in directory. #line directives keep
+// compile errors on the right line; their source string number is the
+// file's index in files, which gets every file read appended (path itself is
+// 0 when files starts out empty).
+inline std::optional<std::string> loadShaderSource(const std::filesystem::path& path, const std::filesystem::path& directory,
+   std::vector<std::filesystem::path>& files, int depth = 0) {
+   constexpr int MAX_DEPTH = 16;
+
+   std::error_code error;
+   const auto file = std::filesystem::absolute(path, error).lexically_normal();
+   std::ifstream stream(file);
+   if (!stream) {
+      printf("Cannot read shader '%s'\n", file.string().c_str());
+      return std::nullopt;
+   }
+   const auto index = files.size();
+   files.push_back(file);
+
+   std::string source;
+   std::string line;
+   for (int number = 1; std::getline(stream, line); ++number) {
+      const auto start = line.find_first_not_of(" \t");
+      if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+         source += line;
+         source += '\n';
+         continue;
+      }
+
+      const auto open = line.find('"', start);
+      const auto close = open == std::string::npos ? open : line.find('"', open + 1);
+      if (close == std::string::npos) {
+         printf("%s:%d: expected #include \"file\"\n", file.string().c_str(), number);
+         return std::nullopt;
+      }
+      if (depth == MAX_DEPTH) {
+         printf("%s:%d: includes nested deeper than %d, is there a cycle?\n", file.string().c_str(), number, MAX_DEPTH);
+         return std::nullopt;
+      }
+
+      const auto name = line.substr(open + 1, close - open - 1);
+      auto included = file.parent_path() / name;
+      if (!std::filesystem::exists(included, error))
+         included = directory / name;
+      const auto text = loadShaderSource(included, directory, files, depth + 1);
+      if (!text)
+         return std::nullopt;
+      source += "#line 1 " + std::to_string(files.size() - 1) + "\n";
+      source += *text;
+      source += "#line " + std::to_string(number + 1) + " " + std::to_string(index) + "\n";
+   }
+   return source;
+}
+
+// Programs built from shader files that rebuild themselves when a file they
+// read (includes too) changes. A rebuild compiles in the background through
+// the ShaderPipeline, so the frame loop keeps drawing the current program;
+// it is swapped for the new one once that links, and a rebuild that fails
+// leaves the current one in place. (Without parallel compile support the
+// pipeline builds during poll(), so that frame stalls.)
+//
+//    const auto id = reloader.add({ { GL_VERTEX_SHADER, "a.vert" }, { GL_FRAGMENT_SHADER, "a.frag" } });
+//    pipeline.poll();
+//    reloader.poll();                         // once a frame
+//    pipeline.program(reloader.handle(*id));
+class ShaderReloader {
+public:
+   ShaderReloader(ShaderPipeline& pipeline, std::filesystem::path directory, bool watch)
+      : mPipeline{ pipeline }
+      , mDirectory{ std::move(directory) } {
+      if (watch)
+         mWatcher = std::make_unique<FileWatcher>();
+   }
+
+   // Loads files and submits the program; nullopt when a file cannot be read.
+   // onReady runs for the first build and again for every rebuild.
+   std::optional<std::size_t> add(std::initializer_list<ShaderFile> files, std::function<void(GLuint)> onReady = {}) {
+      Entry entry;
+      for (const auto& file : files)
+         entry.files.push_back({ file.type, file.path });
+      entry.onReady = std::move(onReady);
+
+      const auto handle = build(entry);
+      if (!handle)
+         return std::nullopt;
+      entry.current = *handle;
+      mEntries.push_back(std::move(entry));
+      return mEntries.size() - 1;
+   }
+
+   // Starts rebuilds of programs whose files changed, swaps in the ones that linked.
+   void poll() {
+      if (!mWatcher)
+         return;
+
+      const auto changed = mWatcher->changes();
+      for (auto& entry : mEntries) {
+         const auto depends = std::any_of(changed.begin(), changed.end(), [&](const auto& file) {
+            return std::find(entry.dependencies.begin(), entry.dependencies.end(), file) != entry.dependencies.end();
+         });
+         if (!depends)
+            continue;
+
+         if (entry.pending)
+            mPipeline.release(*entry.pending);
+         entry.pending = build(entry);
+         entry.start = std::chrono::steady_clock::now();
+      }
+
+      for (auto& entry : mEntries) {
+         if (!entry.pending || !(mPipeline.ready(*entry.pending) || mPipeline.failed(*entry.pending)))
+            continue;
+
+         const auto milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - entry.start).count();
+         if (mPipeline.ready(*entry.pending)) {
+            mPipeline.release(entry.current);
+            entry.current = *entry.pending;
+            printf("Reloaded %s after %.1f ms\n", entry.files[0].path.c_str(), milliseconds);
+            ++mReloads;
+         }
+         else {
+            mPipeline.release(*entry.pending);
+            printf("Rebuilding %s failed, keeping the previous program\n", entry.files[0].path.c_str());
+            for (const auto& files : entry.stageFiles)
+               for (std::size_t i = 0; i < files.size(); ++i)
+                  printf("   source %zu: %s\n", i, files[i].string().c_str());
+            ++mFailures;
+         }
+         entry.pending.reset();
+      }
+   }
+
+   // The program of id: its first build until a rebuild links.
+   ProgramHandle handle(std::size_t id) const {
+      return mEntries[id].current;
+   }
+
+   bool watching() const {
+      return mWatcher != nullptr;
+   }
+
+   void printStats() const {
+      printf("Shader reloader: %zu programs from '%s', %s, %lu reloads, %lu failed\n",
+         mEntries.size(), mDirectory.string().c_str(), mWatcher ? "watching" : "not watching", mReloads, mFailures);
+   }
+
+private:
+   struct File {
+      GLenum type;
+      std::string path;
+   };
+
+   struct Entry {
+      std::vector<File> files;
+      std::function<void(GLuint)> onReady;
+      // files read per stage, in source string number order
+      std::vector<std::vector<std::filesystem::path>> stageFiles;
+      std::vector<std::filesystem::path> dependencies;
+      ProgramHandle current = 0;
+      std::optional<ProgramHandle> pending;
+      std::chrono::steady_clock::time_point start;
+   };
+
+   // Reads entry's files and submits them; on a read error nothing is submitted.
+   std::optional<ProgramHandle> build(Entry& entry) {
+      std::vector<std::vector<std::filesystem::path>> stageFiles(entry.files.size());
+      std::vector<std::string> codes;
+      for (std::size_t i = 0; i < entry.files.size(); ++i) {
+         auto code = loadShaderSource(mDirectory / entry.files[i].path, mDirectory, stageFiles[i]);
+         if (!code)
+            return std::nullopt;
+         codes.push_back(std::move(*code));
+      }
+
+      entry.stageFiles = stageFiles;
+      entry.dependencies.clear();
+      for (const auto& files : stageFiles)
+         entry.dependencies.insert(entry.dependencies.end(), files.begin(), files.end());
+      if (mWatcher)
+         for (const auto& dependency : entry.dependencies)
+            mWatcher->watch(dependency);
+
+      std::vector<ShaderSource> sources;
+      for (std::size_t i = 0; i < codes.size(); ++i)
+         sources.push_back({ entry.files[i].type, codes[i].c_str() });
+      return mPipeline.submit(sources, entry.onReady);
+   }
+
+   ShaderPipeline& mPipeline;
+   std::filesystem::path mDirectory;
+   std::unique_ptr<FileWatcher> mWatcher;
+   std::vector<Entry> mEntries;
+   unsigned long mReloads = 0;
+   unsigned long mFailures = 0;
+};
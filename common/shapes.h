@@ -0,0 +1,26 @@
+#pragma once
+
+// Vertex positions (xyz) of the scene's shapes, shared by the GL path and the
+// software rasterizer.
+
+// drawn as GL_TRIANGLES
+constexpr float TRIANGLE_VERTICES[] = {
+   -1.0, -1.0, 0.0,
+    1.0, -1.0, 0.0,
+    0.0,  1.0, 0.0
+};
+
+// outline, drawn as GL_LINES
+constexpr float SQUARE_VERTICES[] = {
+   -1.0, -1.0, 0.0,
+   -1.0,  1.0, 0.0,
+
+   -1.0,  1.0, 0.0,
+    1.0,  1.0, 0.0,
+
+    1.0,  1.0, 0.0,
+    1.0, -1.0, 0.0,
+
+    1.0, -1.0, 0.0,
+   -1.0, -1.0, 0.0
+};
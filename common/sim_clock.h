@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+
+// Fixed-timestep clock: the simulation always advances in TICK-sized steps no
+// matter how long a frame took, and rendering blends the last two steps.
+//
+//    const auto steps = clock.advance(frameSeconds);
+//    for (unsigned s = 0; s < steps; ++s) { previous = current; step(current); }
+//    draw(lerp(previous, current, clock.alpha()));
+//
+// A frame that would need more than maxSteps ticks (a stall, a debugger break)
+// runs maxSteps and drops the rest of its time, so the simulation slows down
+// for a moment instead of spiralling.
+class SimulationClock {
+public:
+   explicit SimulationClock(double tickSeconds = 1.0 / 60, unsigned maxSteps = 5)
+      : mTick{ tickSeconds }
+      , mMaxSteps{ maxSteps } {
+   }
+
+   // Accounts frameSeconds of real (or fixed, for reproducible runs) time and
+   // returns how many ticks to simulate this frame.
+   unsigned advance(double frameSeconds) {
+      frameSeconds = std::max(frameSeconds, 0.0);
+      ++mFrames;
+      mFrameSeconds += frameSeconds;
+      mMaxFrameSeconds = std::max(mMaxFrameSeconds, frameSeconds);
+
+      mAccumulator += frameSeconds;
+      auto steps = unsigned(mAccumulator / mTick);
+      if (steps > mMaxSteps) {
+         ++mClampedFrames;
+         mDroppedSeconds += (steps - mMaxSteps) * mTick;
+         mAccumulator = std::fmod(mAccumulator, mTick);
+         steps = mMaxSteps;
+      }
+      else
+         mAccumulator -= steps * mTick;
+
+      mTicks += steps;
+      mMaxStepsSeen = std::max(mMaxStepsSeen, steps);
+      return steps;
+   }
+
+   // How far rendering is between the previous and the latest tick, [0, 1).
+   float alpha() const {
+      return float(mAccumulator / mTick);
+   }
+
+   // Simulated time matching alpha(): the previous tick plus the blend.
+   double time() const {
+      return mTicks ? (mTicks - 1 + alpha()) * mTick : 0.0;
+   }
+
+   double tickSeconds() const {
+      return mTick;
+   }
+
+   unsigned long ticks() const {
+      return mTicks;
+   }
+
+   unsigned long frames() const {
+      return mFrames;
+   }
+
+   void printStats() const {
+      printf("Simulation: %lu ticks at %.0f Hz over %lu frames (avg %.3f ms, max %.3f ms), max %u ticks/frame, %lu frames clamped (%.3f s dropped)\n",
+         mTicks, 1 / mTick, mFrames, mFrames ? mFrameSeconds * 1000 / mFrames : 0.0, mMaxFrameSeconds * 1000,
+         mMaxStepsSeen, mClampedFrames, mDroppedSeconds);
+   }
+
+private:
+   double mTick;
+   unsigned mMaxSteps;
+   double mAccumulator = 0;
+
+   unsigned long mTicks = 0;
+   unsigned long mFrames = 0;
+   unsigned long mClampedFrames = 0;
+   unsigned mMaxStepsSeen = 0;
+   double mFrameSeconds = 0;
+   double mMaxFrameSeconds = 0;
+   double mDroppedSeconds = 0;
+};
+
+// A value at the previous and the latest tick.
+template <typename T>
+struct Interpolated {
+   T previous{};
+   T current{};
+
+   void reset(const T& value) {
+      previous = current = value;
+   }
+
+   // Call once per tick before stepping current.
+   void save() {
+      previous = current;
+   }
+
+   T at(float alpha) const {
+      return previous + (current - previous) * alpha;
+   }
+};
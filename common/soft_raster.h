@@ -0,0 +1,384 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <stdio.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+enum class SoftPrimitive {
+   Triangles,  // GL_TRIANGLES
+   Lines       // GL_LINES
+};
+
+// CPU rasterizer for the sample scenes: the same xyz vertex arrays the GL
+// paths upload, transformed by an optional model matrix (column-major, as
+// glm::value_ptr hands it out), rasterized flat-coloured into an RGBA8 buffer.
+//
+// draw() transforms and records primitives; flush() bins them into TILE-sized
+// tiles and rasterizes the tiles on all worker threads, primitives in
+// submission order within each tile. Rasterization follows GL closely enough
+// for image comparisons: pixel centres at +0.5, fixed-point edges with a
+// top-left fill rule, no blending, and pixels() is stored bottom row first
+// like glReadPixels.
+// Lines use a plain DDA, which can differ from GL's diamond-exit rule on a
+// few pixels per line.
+class SoftRasterizer {
+public:
+   static constexpr int TILE = 64;
+   static constexpr int SUBPIXEL_BITS = 8;
+   static constexpr std::int64_t SUBPIXELS = 1 << SUBPIXEL_BITS;
+
+   // threads counts the calling thread; 0 uses every hardware thread.
+   SoftRasterizer(int width, int height, unsigned threads = 0)
+      : mWidth{ width }
+      , mHeight{ height }
+      , mTilesX{ (width + TILE - 1) / TILE }
+      , mTilesY{ (height + TILE - 1) / TILE }
+      , mPixels(std::size_t(width) * height)
+      , mBins(std::size_t(mTilesX) * mTilesY) {
+      if (threads == 0)
+         threads = std::max(1u, std::thread::hardware_concurrency());
+      for (unsigned i = 1; i < threads; ++i)
+         mWorkers.emplace_back([this] { workerLoop(); });
+   }
+
+   ~SoftRasterizer() {
+      {
+         std::lock_guard lock(mMutex);
+         mStop = true;
+      }
+      mWake.notify_all();
+      for (auto& worker : mWorkers)
+         worker.join();
+   }
+
+   SoftRasterizer(const SoftRasterizer&) = delete;
+   SoftRasterizer& operator=(const SoftRasterizer&) = delete;
+
+   static std::uint32_t pack(float r, float g, float b, float a) {
+      const auto channel = [](float value) {
+         return std::uint32_t(std::clamp(value, 0.0f, 1.0f) * 255 + 0.5f);
+      };
+      return channel(r) | channel(g) << 8 | channel(b) << 16 | channel(a) << 24;
+   }
+
+   // Like glClearColor + glClear, applied at the start of the next flush().
+   void clear(float r, float g, float b, float a) {
+      mClear = true;
+      mClearColor = pack(r, g, b, a);
+   }
+
+   // positions holds xyz per vertex; model may be nullptr for identity.
+   void draw(std::span<const float> positions, SoftPrimitive primitive, const float* model, std::uint32_t color) {
+      const auto perPrimitive = primitive == SoftPrimitive::Triangles ? 3u : 2u;
+      const auto count = positions.size() / 3 / perPrimitive;
+
+      for (std::size_t i = 0; i < count; ++i) {
+         Primitive p;
+         p.line = primitive == SoftPrimitive::Lines;
+         p.color = color;
+         for (unsigned v = 0; v < perPrimitive; ++v) {
+            const auto* position = &positions[(i * perPrimitive + v) * 3];
+            if (!transform(position, model, p.v[v]))
+               p.culled = true;
+         }
+         if (!p.culled)
+            mPrimitives.push_back(p);
+      }
+      (perPrimitive == 3 ? mTriangles : mLines) += count;
+   }
+
+   // Rasterizes everything drawn since the last flush.
+   void flush() {
+      const auto start = std::chrono::steady_clock::now();
+
+      bin();
+      mNextTile.store(0, std::memory_order_relaxed);
+      mFragments.store(0, std::memory_order_relaxed);
+      {
+         std::lock_guard lock(mMutex);
+         mFinished = 0;
+         ++mGeneration;
+      }
+      mWake.notify_all();
+
+      rasterTiles();
+
+      {
+         std::unique_lock lock(mMutex);
+         mDone.wait(lock, [this] { return mFinished == mWorkers.size(); });
+      }
+
+      mPrimitives.clear();
+      mClear = false;
+      ++mFrames;
+      mTotalFragments += mFragments.load(std::memory_order_relaxed);
+      mSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   }
+
+   // RGBA8, bottom row first.
+   const std::vector<std::uint32_t>& pixels() const {
+      return mPixels;
+   }
+
+   int width() const {
+      return mWidth;
+   }
+
+   int height() const {
+      return mHeight;
+   }
+
+   unsigned threads() const {
+      return unsigned(mWorkers.size()) + 1;
+   }
+
+   void printStats() const {
+      const auto seconds = std::max(mSeconds, 1e-9);
+      printf("Software rasterizer: %dx%d, %u threads, %lu frames in %.3f s (%.3f ms/frame), %.1f Mpix/s, %.2f Mtris/s, %.2f Mlines/s\n",
+         mWidth, mHeight, threads(), mFrames, mSeconds, mFrames ? mSeconds * 1000 / mFrames : 0.0,
+         mTotalFragments / seconds / 1e6, mTriangles / seconds / 1e6, mLines / seconds / 1e6);
+   }
+
+private:
+   struct Vertex {
+      float x;
+      float y;
+   };
+
+   struct Primitive {
+      std::array<Vertex, 3> v;
+      std::uint32_t color;
+      bool line = false;
+      bool culled = false;
+   };
+
+   // Model transform, perspective divide and viewport; false behind the eye.
+   bool transform(const float* position, const float* m, Vertex& out) const {
+      float x = position[0], y = position[1], z = position[2], w = 1;
+      if (m) {
+         const auto px = x, py = y, pz = z;
+         x = m[0] * px + m[4] * py + m[8] * pz + m[12];
+         y = m[1] * px + m[5] * py + m[9] * pz + m[13];
+         w = m[3] * px + m[7] * py + m[11] * pz + m[15];
+      }
+      if (w <= 0)
+         return false;
+
+      out.x = (x / w * 0.5f + 0.5f) * mWidth;
+      out.y = (y / w * 0.5f + 0.5f) * mHeight;
+      return true;
+   }
+
+   void bin() {
+      for (auto& bin : mBins)
+         bin.clear();
+
+      for (std::uint32_t i = 0; i < mPrimitives.size(); ++i) {
+         const auto& p = mPrimitives[i];
+         const auto vertices = p.line ? 2 : 3;
+         auto minX = p.v[0].x, maxX = p.v[0].x, minY = p.v[0].y, maxY = p.v[0].y;
+         for (int v = 1; v < vertices; ++v) {
+            minX = std::min(minX, p.v[v].x);
+            maxX = std::max(maxX, p.v[v].x);
+            minY = std::min(minY, p.v[v].y);
+            maxY = std::max(maxY, p.v[v].y);
+         }
+         if (maxX < 0 || maxY < 0 || minX >= mWidth || minY >= mHeight)
+            continue;
+
+         const auto tileX0 = std::max(0, int(minX) / TILE);
+         const auto tileY0 = std::max(0, int(minY) / TILE);
+         const auto tileX1 = std::min(mTilesX - 1, int(maxX) / TILE);
+         const auto tileY1 = std::min(mTilesY - 1, int(maxY) / TILE);
+         for (int ty = tileY0; ty <= tileY1; ++ty)
+            for (int tx = tileX0; tx <= tileX1; ++tx)
+               mBins[std::size_t(ty) * mTilesX + tx].push_back(i);
+      }
+   }
+
+   void workerLoop() {
+      unsigned long seen = 0;
+      for (;;) {
+         {
+            std::unique_lock lock(mMutex);
+            mWake.wait(lock, [&] { return mStop || mGeneration != seen; });
+            if (mStop)
+               return;
+            seen = mGeneration;
+         }
+
+         rasterTiles();
+
+         {
+            std::lock_guard lock(mMutex);
+            ++mFinished;
+         }
+         mDone.notify_one();
+      }
+   }
+
+   // Takes tiles off the shared counter until none are left.
+   void rasterTiles() {
+      std::uint64_t fragments = 0;
+      const auto tiles = mTilesX * mTilesY;
+
+      for (auto tile = mNextTile.fetch_add(1, std::memory_order_relaxed); tile < tiles;
+           tile = mNextTile.fetch_add(1, std::memory_order_relaxed)) {
+         const auto x0 = (tile % mTilesX) * TILE;
+         const auto y0 = (tile / mTilesX) * TILE;
+         const auto x1 = std::min(x0 + TILE, mWidth);
+         const auto y1 = std::min(y0 + TILE, mHeight);
+
+         if (mClear)
+            for (int y = y0; y < y1; ++y)
+               std::fill_n(&mPixels[std::size_t(y) * mWidth + x0], x1 - x0, mClearColor);
+
+         for (const auto index : mBins[tile]) {
+            const auto& p = mPrimitives[index];
+            fragments += p.line ? rasterLine(p, x0, y0, x1, y1) : rasterTriangle(p, x0, y0, x1, y1);
+         }
+      }
+
+      mFragments.fetch_add(fragments, std::memory_order_relaxed);
+   }
+
+   // Edge functions over the tile's part of the bounding box.
+   // Vertices are snapped to SUBPIXEL_BITS of sub-pixel precision and the
+   // edges evaluated in integers, like GL rasterizers do, so coverage matches
+   // them exactly instead of depending on float rounding.
+   std::uint64_t rasterTriangle(const Primitive& p, int x0, int y0, int x1, int y1) {
+      struct Fixed {
+         std::int64_t x, y;
+      };
+      const auto snap = [](const Vertex& v) {
+         return Fixed{ std::llround(v.x * SUBPIXELS), std::llround(v.y * SUBPIXELS) };
+      };
+      auto a = snap(p.v[0]), b = snap(p.v[1]), c = snap(p.v[2]);
+      const auto area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+      if (area == 0)
+         return 0;
+      if (area < 0)
+         std::swap(b, c); // counter-clockwise from here on, no culling
+
+      const auto minX = std::max(x0, int(std::min({ a.x, b.x, c.x }) >> SUBPIXEL_BITS));
+      const auto maxX = std::min(x1 - 1, int(std::max({ a.x, b.x, c.x }) >> SUBPIXEL_BITS));
+      const auto minY = std::max(y0, int(std::min({ a.y, b.y, c.y }) >> SUBPIXEL_BITS));
+      const auto maxY = std::min(y1 - 1, int(std::max({ a.y, b.y, c.y }) >> SUBPIXEL_BITS));
+      if (minX > maxX || minY > maxY)
+         return 0;
+
+      struct Edge {
+         Fixed origin;
+         std::int64_t dx, dy;
+         bool topLeft;
+
+         std::int64_t at(std::int64_t x, std::int64_t y) const {
+            return dx * (y - origin.y) - dy * (x - origin.x);
+         }
+
+         // pixels exactly on an edge belong to it only for left edges and
+         // bottom ones: the top-left rule of a y-down rasterizer, seen in GL's
+         // y-up window space (llvmpipe and most hardware)
+         bool inside(std::int64_t value) const {
+            return value > 0 || (value == 0 && topLeft);
+         }
+      };
+      const auto edge = [](const Fixed& from, const Fixed& to) {
+         const auto dx = to.x - from.x;
+         const auto dy = to.y - from.y;
+         return Edge{ from, dx, dy, dy < 0 || (dy == 0 && dx > 0) };
+      };
+      const std::array<Edge, 3> edges = { edge(a, b), edge(b, c), edge(c, a) };
+
+      const auto half = std::int64_t(SUBPIXELS) / 2;
+      std::uint64_t fragments = 0;
+      for (int y = minY; y <= maxY; ++y) {
+         const auto py = (std::int64_t(y) << SUBPIXEL_BITS) + half;
+         const auto px = (std::int64_t(minX) << SUBPIXEL_BITS) + half;
+         std::array<std::int64_t, 3> e;
+         for (int i = 0; i < 3; ++i)
+            e[i] = edges[i].at(px, py);
+
+         auto* row = &mPixels[std::size_t(y) * mWidth];
+         for (int x = minX; x <= maxX; ++x) {
+            if (edges[0].inside(e[0]) && edges[1].inside(e[1]) && edges[2].inside(e[2])) {
+               row[x] = p.color;
+               ++fragments;
+            }
+            for (int i = 0; i < 3; ++i)
+               e[i] -= edges[i].dy * SUBPIXELS;
+         }
+      }
+      return fragments;
+   }
+
+   // DDA along the major axis, half-open at the far end like GL lines.
+   std::uint64_t rasterLine(const Primitive& p, int x0, int y0, int x1, int y1) {
+      auto a = p.v[0], b = p.v[1];
+      const auto xMajor = std::abs(b.x - a.x) >= std::abs(b.y - a.y);
+      if (!xMajor) {
+         std::swap(a.x, a.y);
+         std::swap(b.x, b.y);
+         std::swap(x0, y0);
+         std::swap(x1, y1);
+      }
+      if (a.x > b.x)
+         std::swap(a, b);
+      if (b.x == a.x)
+         return 0;
+
+      const auto slope = (b.y - a.y) / (b.x - a.x);
+      const auto first = std::max(x0, int(std::ceil(a.x - 0.5f)));
+      const auto last = std::min(x1, int(std::ceil(b.x - 0.5f)));
+
+      std::uint64_t fragments = 0;
+      for (int major = first; major < last; ++major) {
+         const auto minor = int(std::floor(a.y + (major + 0.5f - a.x) * slope));
+         if (minor < y0 || minor >= y1)
+            continue;
+
+         const auto x = xMajor ? major : minor;
+         const auto y = xMajor ? minor : major;
+         mPixels[std::size_t(y) * mWidth + x] = p.color;
+         ++fragments;
+      }
+      return fragments;
+   }
+
+   int mWidth;
+   int mHeight;
+   int mTilesX;
+   int mTilesY;
+   std::vector<std::uint32_t> mPixels;
+   bool mClear = false;
+   std::uint32_t mClearColor = 0;
+
+   std::vector<Primitive> mPrimitives;
+   std::vector<std::vector<std::uint32_t>> mBins;
+
+   std::vector<std::thread> mWorkers;
+   std::mutex mMutex;
+   std::condition_variable mWake;
+   std::condition_variable mDone;
+   unsigned long mGeneration = 0;
+   std::size_t mFinished = 0;
+   bool mStop = false;
+   std::atomic<int> mNextTile{ 0 };
+   std::atomic<std::uint64_t> mFragments{ 0 };
+
+   unsigned long mFrames = 0;
+   std::uint64_t mTriangles = 0;
+   std::uint64_t mLines = 0;
+   std::uint64_t mTotalFragments = 0;
+   double mSeconds = 0;
+};
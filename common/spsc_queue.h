@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <stdio.h>
+
+// Lock-free ring for exactly one producer thread and one consumer thread.
+//
+// Each side owns one index and only reads the other's, so push() and pop()
+// are a load, a copy and a release store, and never block. A push into a full
+// ring is dropped and counted instead of waiting for the consumer.
+template <typename T, std::size_t CAPACITY>
+class SpscQueue {
+   static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "capacity must be a power of two");
+
+public:
+   // Producer thread only; false when the ring is full and value was dropped.
+   bool push(const T& value) {
+      const auto tail = mTail.load(std::memory_order_relaxed);
+      const auto depth = tail - mHead.load(std::memory_order_acquire);
+      if (depth == CAPACITY) {
+         mDrops.fetch_add(1, std::memory_order_relaxed);
+         return false;
+      }
+
+      mSlots[tail & (CAPACITY - 1)] = value;
+      mTail.store(tail + 1, std::memory_order_release);
+
+      if (depth + 1 > mMaxDepth.load(std::memory_order_relaxed))
+         mMaxDepth.store(depth + 1, std::memory_order_relaxed);
+      return true;
+   }
+
+   // Consumer thread only; empty when nothing is queued.
+   std::optional<T> pop() {
+      const auto head = mHead.load(std::memory_order_relaxed);
+      if (head == mTail.load(std::memory_order_acquire))
+         return {};
+
+      auto value = mSlots[head & (CAPACITY - 1)];
+      mHead.store(head + 1, std::memory_order_release);
+      return value;
+   }
+
+   // Snapshot from either thread, may be stale by the time it is used.
+   std::size_t depth() const {
+      return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire);
+   }
+
+   std::size_t maxDepth() const {
+      return mMaxDepth.load(std::memory_order_relaxed);
+   }
+
+   std::size_t pushed() const {
+      return mTail.load(std::memory_order_acquire);
+   }
+
+   std::size_t drops() const {
+      return mDrops.load(std::memory_order_relaxed);
+   }
+
+   static constexpr std::size_t capacity() {
+      return CAPACITY;
+   }
+
+   void printStats(const char* name) const {
+      printf("%s: %zu pushed, %zu dropped, depth %zu (max %zu of %zu)\n",
+         name, pushed(), drops(), depth(), maxDepth(), CAPACITY);
+   }
+
+private:
+   // producer and consumer indices on separate cache lines
+   alignas(64) std::atomic<std::size_t> mHead{ 0 };
+   alignas(64) std::atomic<std::size_t> mTail{ 0 };
+   alignas(64) std::atomic<std::size_t> mDrops{ 0 };
+   std::atomic<std::size_t> mMaxDepth{ 0 };
+   std::array<T, CAPACITY> mSlots{};
+};
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdio.h>
+
+#include "gl_objects.h"
+
+// Range of the stream buffer handed out for one frame; data points to
+// offset inside the mapped storage and is valid until endWrites().
+struct StreamRange {
+   void* data = nullptr;
+   GLintptr offset = 0;
+   GLsizeiptr size = 0;
+};
+
+// Ring buffer for per-frame data (uniform blocks, instance attributes).
+//
+// With ARB_buffer_storage the store is mapped once, persistently and
+// coherently, and split into SLICES frame slices. A fence placed after the
+// frame's draws guards each slice, so the CPU writes one slice with plain
+// stores while the GPU still reads the previous ones. Without it every frame
+// orphans the store through glMapBufferRange(GL_MAP_INVALIDATE_BUFFER_BIT).
+//
+// Per frame: beginFrame(), allocate()..., endWrites(), draws, endFrame().
+class StreamBuffer {
+public:
+   static constexpr unsigned SLICES = 3;
+
+   StreamBuffer() = default;
+
+   ~StreamBuffer() {
+      for (auto& fence : mFences)
+         if (fence)
+            glDeleteSync(fence);
+      if (mMapped && mBuffer.get()) {
+         glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer.get());
+         glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+      }
+   }
+
+   StreamBuffer(const StreamBuffer&) = delete;
+   StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+   bool create(GLsizeiptr sliceSize) {
+      mSliceSize = sliceSize;
+      mPersistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+
+      if (mPersistent) {
+         const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+         mBuffer.allocateStorage(GL_COPY_WRITE_BUFFER, sliceSize * SLICES, nullptr, flags);
+         mMapped = static_cast<std::uint8_t*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, sliceSize * SLICES, flags));
+      }
+      else
+         mBuffer.allocate(GL_COPY_WRITE_BUFFER, sliceSize, nullptr, GL_STREAM_DRAW);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+      if (mPersistent && !mMapped) {
+         printf("Error mapping stream buffer\n");
+         return false;
+      }
+      return true;
+   }
+
+   // Waits, if needed, until the GPU is done with the slice about to be reused.
+   void beginFrame() {
+      mHead = 0;
+
+      if (mPersistent) {
+         auto& fence = mFences[mSlice];
+         if (fence) {
+            if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+               ++mWaits;
+               const auto start = std::chrono::steady_clock::now();
+               while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000) == GL_TIMEOUT_EXPIRED)
+                  ;
+               mWaitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+            glDeleteSync(fence);
+            fence = nullptr;
+         }
+         mFrameData = mMapped + mSlice * mSliceSize;
+         mFrameOffset = GLintptr(mSlice) * mSliceSize;
+      }
+      else {
+         glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer.get());
+         mFrameData = static_cast<std::uint8_t*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, mSliceSize,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+         glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+         mFrameOffset = 0;
+      }
+   }
+
+   // size bytes from the current slice, offset aligned to alignment (a power of
+   // two). Returns an empty range, data null, once the slice is exhausted:
+   // callers check data before writing and skip what would read the range.
+   StreamRange allocate(GLsizeiptr size, GLsizeiptr alignment = 16) {
+      const auto begin = (mHead + alignment - 1) & ~(alignment - 1);
+      if (!mFrameData || begin + size > mSliceSize) {
+         ++mOverflows;
+         return {};
+      }
+
+      mHead = begin + size;
+      return { mFrameData + begin, mFrameOffset + begin, size };
+   }
+
+   // Makes the frame's writes visible to GL; draws may use the ranges after this.
+   void endWrites() {
+      if (!mPersistent && mFrameData) {
+         glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer.get());
+         glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+         glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+      }
+      mFrameData = nullptr;
+   }
+
+   // Call after the last draw reading this frame's ranges.
+   void endFrame() {
+      if (mPersistent) {
+         mFences[mSlice] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+         mSlice = (mSlice + 1) % SLICES;
+      }
+      ++mFrames;
+   }
+
+   void bindRange(GLenum target, GLuint index, const StreamRange& range) const {
+      glBindBufferRange(target, index, mBuffer.get(), range.offset, range.size);
+   }
+
+   GLuint get() const {
+      return mBuffer.get();
+   }
+
+   bool persistent() const {
+      return mPersistent;
+   }
+
+   // beginFrame() calls that had to wait for the GPU, and how long they waited
+   unsigned long waits() const {
+      return mWaits;
+   }
+
+   double waitSeconds() const {
+      return mWaitSeconds;
+   }
+
+   void printStats() const {
+      printf("Stream buffer: %s, %u x %td bytes, %lu frames, %lu fence waits (%.3f ms), %lu overflows\n",
+         mPersistent ? "persistent" : "orphaning", mPersistent ? SLICES : 1u, mSliceSize,
+         mFrames, mWaits, mWaitSeconds * 1000, mOverflows);
+   }
+
+private:
+   GlBuffer mBuffer;
+   bool mPersistent = false;
+   std::uint8_t* mMapped = nullptr;
+   GLsizeiptr mSliceSize = 0;
+
+   unsigned mSlice = 0;
+   std::uint8_t* mFrameData = nullptr;
+   GLintptr mFrameOffset = 0;
+   GLsizeiptr mHead = 0;
+   std::array<GLsync, SLICES> mFences{};
+
+   unsigned long mFrames = 0;
+   unsigned long mWaits = 0;
+   unsigned long mOverflows = 0;
+   double mWaitSeconds = 0;
+};
+
+// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT of the current context.
+inline GLsizeiptr uniformBufferAlignment() {
+   GLint alignment = 256;
+   glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+   return alignment;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <stdio.h>
+
+// What a frame loop presents to: an on-screen window or an offscreen framebuffer.
+class Surface {
+public:
+   virtual ~Surface() = default;
+
+   virtual bool shouldClose() = 0;
+   virtual void pollEvents() = 0;
+   virtual void swapBuffers() = 0;
+   virtual void getFramebufferSize(int* width, int* height) = 0;
+
+   // Seconds since the surface was created.
+   virtual double getTime() = 0;
+};
+
+// glewInit() for the current context. GLEW builds for GLX report a missing X
+// display when the context comes from EGL, even though every entry point loads.
+inline GLenum initGlew() {
+   glewExperimental = GL_TRUE;
+   const auto ret = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+   if (ret == GLEW_ERROR_NO_GLX_DISPLAY)
+      return GLEW_OK;
+#endif
+   return ret;
+}
+
+#ifdef GLFW_TRUE
+
+// Non-owning view of a GLFW window.
+class GlfwSurface : public Surface {
+public:
+   explicit GlfwSurface(GLFWwindow* window)
+      : mWindow{ window } {
+   }
+
+   bool shouldClose() override {
+      return glfwWindowShouldClose(mWindow);
+   }
+
+   void pollEvents() override {
+      glfwPollEvents();
+   }
+
+   void swapBuffers() override {
+      glfwSwapBuffers(mWindow);
+   }
+
+   void getFramebufferSize(int* width, int* height) override {
+      glfwGetFramebufferSize(mWindow, width, height);
+   }
+
+   double getTime() override {
+      return glfwGetTime();
+   }
+
+private:
+   GLFWwindow* mWindow;
+};
+
+#endif
+
+#ifdef SDL_h_
+
+// Non-owning view of an SDL window with a GL context.
+class SdlSurface : public Surface {
+public:
+   explicit SdlSurface(SDL_Window* window)
+      : mWindow{ window }
+      , mStart{ SDL_GetPerformanceCounter() } {
+   }
+
+   bool shouldClose() override {
+      return mShouldClose;
+   }
+
+   void pollEvents() override {
+      SDL_Event e;
+      while (SDL_PollEvent(&e)) {
+         if (e.type == SDL_QUIT)
+            mShouldClose = true;
+      }
+   }
+
+   void swapBuffers() override {
+      SDL_GL_SwapWindow(mWindow);
+   }
+
+   void getFramebufferSize(int* width, int* height) override {
+      SDL_GL_GetDrawableSize(mWindow, width, height);
+   }
+
+   double getTime() override {
+      return double(SDL_GetPerformanceCounter() - mStart) / SDL_GetPerformanceFrequency();
+   }
+
+private:
+   SDL_Window* mWindow;
+   Uint64 mStart;
+   bool mShouldClose = false;
+};
+
+#endif
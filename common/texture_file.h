@@ -0,0 +1,230 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <stdio.h>
+#include <vector>
+
+// Pixel format of a texture file as GL takes it: RGBA8 or one of the BCn
+// block formats, which GL uploads as they are stored.
+struct TextureFormat {
+   GLenum internalFormat = GL_RGBA8;
+   // format and type of glTexSubImage2D, unused for block formats
+   GLenum format = GL_RGBA;
+   GLenum type = GL_UNSIGNED_BYTE;
+   // bytes per 4x4 block, per pixel for uncompressed formats
+   unsigned blockBytes = 4;
+   bool compressed = false;
+   const char* name = "RGBA8";
+
+   // Rows of a level, and bytes of one, as they are uploaded: block rows for block formats.
+   unsigned rows(unsigned height) const {
+      return compressed ? (height + 3) / 4 : height;
+   }
+
+   std::size_t rowBytes(unsigned width) const {
+      return std::size_t(compressed ? (width + 3) / 4 : width) * blockBytes;
+   }
+
+   std::size_t levelBytes(unsigned width, unsigned height) const {
+      return rows(height) * rowBytes(width);
+   }
+};
+
+constexpr TextureFormat TEXTURE_RGBA8{ GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, false, "RGBA8" };
+constexpr TextureFormat TEXTURE_BGRA8{ GL_RGBA8, GL_BGRA, GL_UNSIGNED_BYTE, 4, false, "BGRA8" };
+constexpr TextureFormat TEXTURE_SRGB8_ALPHA8{ GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, false, "SRGB8_ALPHA8" };
+constexpr TextureFormat TEXTURE_BC1{ GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 0, 0, 8, true, "BC1" };
+constexpr TextureFormat TEXTURE_BC3{ GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0, 0, 16, true, "BC3" };
+constexpr TextureFormat TEXTURE_BC4{ GL_COMPRESSED_RED_RGTC1, 0, 0, 8, true, "BC4" };
+constexpr TextureFormat TEXTURE_BC5{ GL_COMPRESSED_RG_RGTC2, 0, 0, 16, true, "BC5" };
+constexpr TextureFormat TEXTURE_BC7{ GL_COMPRESSED_RGBA_BPTC_UNORM, 0, 0, 16, true, "BC7" };
+
+// What a texture file holds, pointing into its bytes; levels[0] is the full size.
+struct TextureFileView {
+   TextureFormat format;
+   unsigned width = 0;
+   unsigned height = 0;
+   std::vector<std::span<const std::byte>> levels;
+
+   unsigned levelWidth(std::size_t level) const {
+      return std::max(width >> level, 1u);
+   }
+
+   unsigned levelHeight(std::size_t level) const {
+      return std::max(height >> level, 1u);
+   }
+};
+
+namespace texture_file_detail {
+
+template <typename T>
+T read(std::span<const std::byte> data, std::size_t offset) {
+   T value{};
+   if (offset + sizeof(T) <= data.size())
+      std::memcpy(&value, data.data() + offset, sizeof(T));
+   return value;
+}
+
+// DXGI_FORMAT of DDS files with a DX10 header, VkFormat of KTX2 files
+inline std::optional<TextureFormat> fromDxgi(std::uint32_t format) {
+   switch (format) {
+   case 28: return TEXTURE_RGBA8;
+   case 29: return TEXTURE_SRGB8_ALPHA8;
+   case 87: return TEXTURE_BGRA8;
+   case 71: return TEXTURE_BC1;
+   case 77: return TEXTURE_BC3;
+   case 80: return TEXTURE_BC4;
+   case 83: return TEXTURE_BC5;
+   case 98: return TEXTURE_BC7;
+   default: return std::nullopt;
+   }
+}
+
+inline std::optional<TextureFormat> fromVk(std::uint32_t format) {
+   switch (format) {
+   case 37: return TEXTURE_RGBA8;
+   case 43: return TEXTURE_SRGB8_ALPHA8;
+   case 44: return TEXTURE_BGRA8;
+   case 133: return TEXTURE_BC1;
+   case 137: return TEXTURE_BC3;
+   case 139: return TEXTURE_BC4;
+   case 141: return TEXTURE_BC5;
+   case 145: return TEXTURE_BC7;
+   default: return std::nullopt;
+   }
+}
+
+inline bool checkLevels(const TextureFileView& view, const char* name) {
+   if (view.width == 0 || view.height == 0 || view.levels.empty() || (std::max(view.width, view.height) >> (view.levels.size() - 1)) == 0) {
+      printf("%s: texture has no size, or more mip levels than down to 1x1\n", name);
+      return false;
+   }
+   for (std::size_t level = 0; level < view.levels.size(); ++level)
+      if (view.levels[level].size() != view.format.levelBytes(view.levelWidth(level), view.levelHeight(level))) {
+         printf("%s: mip level %zu is truncated or has the wrong size for %ux%u %s\n",
+            name, level, view.levelWidth(level), view.levelHeight(level), view.format.name);
+         return false;
+      }
+   return true;
+}
+
+// KTX2: identifier, header, index, level index; levels where the index says.
+inline std::optional<TextureFileView> parseKtx2(std::span<const std::byte> data, const char* name) {
+   TextureFileView view;
+   const auto vkFormat = read<std::uint32_t>(data, 12);
+   view.width = read<std::uint32_t>(data, 20);
+   view.height = read<std::uint32_t>(data, 24);
+   const auto depth = read<std::uint32_t>(data, 28);
+   const auto layers = read<std::uint32_t>(data, 32);
+   const auto faces = read<std::uint32_t>(data, 36);
+   const auto levels = std::max(read<std::uint32_t>(data, 40), 1u);
+   const auto supercompression = read<std::uint32_t>(data, 44);
+   if (depth > 1 || layers > 1 || faces != 1 || supercompression != 0) {
+      printf("%s: only plain 2D KTX2 textures are supported (no arrays, cube maps or supercompression)\n", name);
+      return std::nullopt;
+   }
+   const auto format = fromVk(vkFormat);
+   if (!format) {
+      printf("%s: VkFormat %u is not supported\n", name, vkFormat);
+      return std::nullopt;
+   }
+   view.format = *format;
+
+   constexpr std::size_t LEVEL_INDEX = 80;
+   if (levels > 16 || data.size() < LEVEL_INDEX + levels * 24) {
+      printf("%s: KTX2 level index is truncated\n", name);
+      return std::nullopt;
+   }
+   for (std::uint32_t level = 0; level < levels; ++level) {
+      const auto offset = read<std::uint64_t>(data, LEVEL_INDEX + level * 24);
+      const auto bytes = read<std::uint64_t>(data, LEVEL_INDEX + level * 24 + 8);
+      if (offset > data.size() || bytes > data.size() - offset) {
+         printf("%s: mip level %u is outside the file\n", name, level);
+         return std::nullopt;
+      }
+      view.levels.push_back(data.subspan(std::size_t(offset), std::size_t(bytes)));
+   }
+   return checkLevels(view, name) ? std::optional(std::move(view)) : std::nullopt;
+}
+
+// DDS: magic, 124-byte header, optional DX10 header, then every level packed, largest first.
+inline std::optional<TextureFileView> parseDds(std::span<const std::byte> data, const char* name) {
+   constexpr std::uint32_t FOURCC_FLAG = 0x4, RGB_FLAG = 0x40, CUBEMAP = 0x200;
+   const auto fourCC = [](const char (&code)[5]) {
+      return std::uint32_t(code[0]) | std::uint32_t(code[1]) << 8 | std::uint32_t(code[2]) << 16 | std::uint32_t(code[3]) << 24;
+   };
+
+   TextureFileView view;
+   view.height = read<std::uint32_t>(data, 12);
+   view.width = read<std::uint32_t>(data, 16);
+   const auto levels = std::max(read<std::uint32_t>(data, 28), 1u);
+   const auto flags = read<std::uint32_t>(data, 80);
+   const auto code = read<std::uint32_t>(data, 84);
+   const auto bits = read<std::uint32_t>(data, 88);
+   const auto redMask = read<std::uint32_t>(data, 92);
+   if (read<std::uint32_t>(data, 4) != 124 || (read<std::uint32_t>(data, 112) & CUBEMAP)) {
+      printf("%s: only 2D DDS textures are supported\n", name);
+      return std::nullopt;
+   }
+
+   std::size_t offset = 128;
+   std::optional<TextureFormat> format;
+   if ((flags & FOURCC_FLAG) && code == fourCC("DX10")) {
+      format = fromDxgi(read<std::uint32_t>(data, 128));
+      offset += 20;
+      // resourceDimension TEXTURE2D, miscFlag without TEXTURECUBE, one array element
+      if (read<std::uint32_t>(data, 132) != 3 || (read<std::uint32_t>(data, 136) & 0x4) || read<std::uint32_t>(data, 140) > 1) {
+         printf("%s: only 2D DDS textures are supported\n", name);
+         return std::nullopt;
+      }
+   }
+   else if (flags & FOURCC_FLAG) {
+      if (code == fourCC("DXT1"))
+         format = TEXTURE_BC1;
+      else if (code == fourCC("DXT5"))
+         format = TEXTURE_BC3;
+      else if (code == fourCC("ATI1") || code == fourCC("BC4U"))
+         format = TEXTURE_BC4;
+      else if (code == fourCC("ATI2") || code == fourCC("BC5U"))
+         format = TEXTURE_BC5;
+   }
+   else if ((flags & RGB_FLAG) && bits == 32)
+      format = redMask == 0xff ? TEXTURE_RGBA8 : redMask == 0xff0000 ? TEXTURE_BGRA8 : std::optional<TextureFormat>();
+   if (!format) {
+      printf("%s: DDS pixel format is not supported\n", name);
+      return std::nullopt;
+   }
+   view.format = *format;
+
+   for (std::uint32_t level = 0; level < levels && level < 16; ++level) {
+      const auto bytes = view.format.levelBytes(view.levelWidth(level), view.levelHeight(level));
+      if (offset > data.size() || bytes > data.size() - offset) {
+         printf("%s: mip level %u is outside the file\n", name, level);
+         return std::nullopt;
+      }
+      view.levels.push_back(data.subspan(offset, bytes));
+      offset += bytes;
+   }
+   return checkLevels(view, name) ? std::optional(std::move(view)) : std::nullopt;
+}
+
+}
+
+// Checks data as a KTX2 or DDS texture, told apart by their magic; name is
+// for the messages. Nothing is copied, the view is valid as long as data.
+inline std::optional<TextureFileView> parseTextureFile(std::span<const std::byte> data, const char* name) {
+   static constexpr unsigned char KTX2_IDENTIFIER[12] = { 0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n' };
+   if (data.size() >= 80 && std::memcmp(data.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0)
+      return texture_file_detail::parseKtx2(data, name);
+   if (data.size() >= 128 && std::memcmp(data.data(), "DDS ", 4) == 0)
+      return texture_file_detail::parseDds(data, name);
+   printf("%s: neither a KTX2 nor a DDS file\n", name);
+   return std::nullopt;
+}
@@ -0,0 +1,441 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <stdio.h>
+#include <vector>
+
+#include "file_loader.h"
+#include "gl_objects.h"
+#include "render_queue.h"
+#include "stream_buffer.h"
+#include "texture_file.h"
+
+// Index into TextureStreamer, valid for the streamer's whole lifetime.
+using TextureHandle = std::uint32_t;
+
+// Loads KTX2 and DDS textures (texture_file.h) while the frame loop keeps
+// running, within a cap on the bytes of texture storage.
+//
+// A FileLoader thread maps each file and reads its pages in. update() then
+// uploads at most budget bytes a frame through a staging StreamBuffer bound
+// as pixel unpack buffer, in bands of rows, coarse levels first:
+//  - the mip tail (levels of MIP_TAIL_SIZE texels and less) goes into a
+//    texture of its own as soon as the file is mapped, and stays resident;
+//  - textures drawn in the last frame get their full chain in immutable
+//    storage (glTexStorage2D), filled from the tail up. Its base level
+//    follows the finest complete level, so draws sample complete levels
+//    only and sharpen as the finer ones arrive;
+//  - when a full chain does not fit under the cap, the least recently used
+//    full chains not drawn in the last frame drop back to their tail.
+//
+//    const auto handle = textures.load("bricks.ktx2");
+//    textures.update(queue.state());                  // once a frame
+//    command.texture = textures.use(handle);          // any thread, between updates
+class TextureStreamer {
+public:
+   // levels this small (in texels per side) are the tail that stays resident
+   static constexpr unsigned MIP_TAIL_SIZE = 64;
+
+   TextureStreamer(GLsizeiptr budget, std::size_t cap)
+      : mBudget{ std::max<GLsizeiptr>(budget, 4096) }
+      , mCap{ cap }
+      , mLoader{ parse } {
+   }
+
+   TextureStreamer(const TextureStreamer&) = delete;
+   TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+   // The staging ring, the fallback texture and the loader thread.
+   bool create() {
+      // a band is at least one row, which may go past the budget
+      if (!mStaging.create(mBudget + MAX_ROW_BYTES))
+         return false;
+      mImmutable = GLEW_VERSION_4_2 || GLEW_ARB_texture_storage;
+
+      // mid grey until a texture's first level is there
+      const std::uint8_t grey[4] = { 128, 128, 128, 255 };
+      glBindTexture(GL_TEXTURE_2D, mFallback.get());
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+      glBindTexture(GL_TEXTURE_2D, 0);
+
+      mLoader.start();
+      return true;
+   }
+
+   // Queues path; the handle for use().
+   TextureHandle load(const std::filesystem::path& path) {
+      auto texture = std::make_unique<Texture>();
+      texture->path = path;
+      texture->lastUsed.store(mFrame, std::memory_order_relaxed);
+      return TextureHandle(mLoader.add(std::move(texture)));
+   }
+
+   // The texture to draw handle with, at its finest complete level; the
+   // fallback before anything of it arrived. Marks it used this frame.
+   GLuint use(TextureHandle handle) {
+      auto& texture = *mLoader.files()[handle];
+      texture.lastUsed.store(mFrame, std::memory_order_relaxed);
+      return texture.drawable ? texture.drawable : mFallback.get();
+   }
+
+   std::size_t size() const {
+      return mLoader.files().size();
+   }
+
+   // Evicts, creates and uploads; on the GL thread, once a frame, before
+   // the frame's use() calls. Binds textures through state.
+   void update(GlStateCache& state) {
+      const auto start = clock::now();
+      ++mFrame;
+
+      for (auto& texture : mLoader.files())
+         if (texture->current() == LoadState::Mapped)
+            createTail(*texture, state);
+
+      for (auto& texture : mLoader.files())
+         if (texture->tail && !texture->full && texture->tailFirst > 0 && wanted(*texture) && done(*texture->tail))
+            promote(*texture, state);
+
+      upload(state);
+
+      for (auto& texture : mLoader.files()) {
+         if (texture->full && texture->full->complete < texture->tailFirst)
+            texture->drawable = texture->full->texture.get();
+         else if (texture->tail && texture->tail->complete < texture->view.levels.size())
+            texture->drawable = texture->tail->texture.get();
+         else
+            texture->drawable = 0;
+      }
+
+      const auto seconds = std::chrono::duration<double>(clock::now() - start).count();
+      mUpdateSeconds += seconds;
+      mMaxUpdateSeconds = std::max(mMaxUpdateSeconds, seconds);
+   }
+
+   void printStats() const {
+      std::size_t failed = 0;
+      std::size_t full = 0;
+      std::size_t streaming = 0;
+      std::size_t tails = 0;
+      for (const auto& texture : mLoader.files()) {
+         failed += texture->current() == LoadState::Failed;
+         if (texture->full)
+            (done(*texture->full) ? full : streaming) += 1;
+         else if (texture->tail)
+            (texture->tailFirst == 0 ? full : tails) += 1;
+      }
+      const auto megabytes = [](double bytes) {
+         return bytes / (1024 * 1024);
+      };
+      printf("Texture streamer: %zu textures (%zu failed), %zu at full resolution, %zu streaming in, %zu at their mip tail; "
+         "resident %.2f MB (peak %.2f MB, cap %.2f MB), %lu promotions, %lu evictions, %lu refused by the cap\n",
+         mLoader.files().size(), failed, full, streaming, tails, megabytes(double(mResident)), megabytes(double(mPeakResident)),
+         megabytes(double(mCap)), mPromotions, mEvictions, mRefused);
+      printf("Texture uploads: %.2f MB in %lu frames (budget %.0f KB, %lu frames used all of it), loader thread read %.1f MB/s; "
+         "stalls: %lu staging fence waits (%.3f ms), update at most %.3f ms (%.3f ms/frame)\n",
+         megabytes(double(mUploadedBytes)), mUploadFrames, mBudget / 1024.0, mBudgetLimitedFrames,
+         mLoader.readMegabytesPerSecond(),
+         mStaging.waits(), mStaging.waitSeconds() * 1000, mMaxUpdateSeconds * 1000,
+         mUpdateSeconds * 1000 / double(std::max(mFrame, 1ul)));
+   }
+
+private:
+   using clock = std::chrono::steady_clock;
+
+   static constexpr GLsizeiptr MAX_ROW_BYTES = 256 * 1024;
+
+   // A GL texture with file levels [first, levels) of a texture, filled coarse to fine.
+   struct Residency {
+      GlTexture texture;
+      unsigned first = 0;
+      // finest file level uploaded in full, the level count while none is
+      unsigned complete = 0;
+      // file level being uploaded, and its bytes staged so far
+      unsigned next = 0;
+      std::size_t offset = 0;
+      std::size_t bytes = 0;
+   };
+
+   struct Texture : LoadedFile {
+      // written by the loader thread before it sets Mapped
+      TextureFileView view;
+
+      // GL thread
+      unsigned tailFirst = 0;
+      std::optional<Residency> tail;
+      std::optional<Residency> full;
+      bool refused = false;
+      GLuint drawable = 0;
+      std::atomic<unsigned long> lastUsed{ 0 };
+   };
+
+   // One band of rows of a level, staged at offset.
+   struct Upload {
+      GLuint texture;
+      GLint level;
+      TextureFormat format;
+      GLint y;
+      GLsizei width;
+      GLsizei height;
+      GLintptr offset;
+      GLsizei bytes;
+      bool completes;
+   };
+
+   // Loader thread: keeps the view of a texture this GL can sample.
+   static bool parse(Texture& texture, const char* name) {
+      auto view = parseTextureFile(texture.file.bytes(), name);
+      if (!view || !supported(view->format, name))
+         return false;
+      texture.view = std::move(*view);
+      return true;
+   }
+
+   static bool supported(const TextureFormat& format, const char* name) {
+      const auto s3tc = format.internalFormat == TEXTURE_BC1.internalFormat || format.internalFormat == TEXTURE_BC3.internalFormat;
+      const auto bptc = format.internalFormat == TEXTURE_BC7.internalFormat;
+      if ((s3tc && !GLEW_EXT_texture_compression_s3tc) || (bptc && !GLEW_VERSION_4_2 && !GLEW_ARB_texture_compression_bptc)) {
+         printf("%s: this GL cannot sample %s textures\n", name, format.name);
+         return false;
+      }
+      return true;
+   }
+
+   bool wanted(const Texture& texture) const {
+      return texture.lastUsed.load(std::memory_order_relaxed) + 1 >= mFrame;
+   }
+
+   static bool done(const Residency& residency) {
+      return residency.complete == residency.first;
+   }
+
+   void createTail(Texture& texture, GlStateCache& state) {
+      const auto& view = texture.view;
+      texture.tailFirst = unsigned(view.levels.size() - 1);
+      for (unsigned level = 0; level < view.levels.size(); ++level)
+         if (std::max(view.levelWidth(level), view.levelHeight(level)) <= MIP_TAIL_SIZE) {
+            texture.tailFirst = level;
+            break;
+         }
+      allocate(texture, texture.tail, texture.tailFirst, state);
+      texture.state.store(LoadState::Ready, std::memory_order_relaxed);
+   }
+
+   // Full chain for texture when it fits under the cap, after evicting what has to go.
+   void promote(Texture& texture, GlStateCache& state) {
+      std::size_t bytes = 0;
+      for (const auto& level : texture.view.levels)
+         bytes += level.size();
+
+      if (mResident + bytes > mCap) {
+         mCold.clear();
+         std::size_t coldBytes = 0;
+         for (auto& other : mLoader.files())
+            if (other->full && !wanted(*other)) {
+               mCold.push_back(other.get());
+               coldBytes += other->full->bytes;
+            }
+         if (mResident - coldBytes + bytes > mCap) {
+            mRefused += !texture.refused;
+            texture.refused = true;
+            return;
+         }
+
+         std::sort(mCold.begin(), mCold.end(), [](const Texture* a, const Texture* b) {
+            return a->lastUsed.load(std::memory_order_relaxed) < b->lastUsed.load(std::memory_order_relaxed);
+         });
+         for (auto* cold : mCold) {
+            if (mResident + bytes <= mCap)
+               break;
+            // deleting a bound texture unbinds it behind the cache's back
+            state.bindTexture(0);
+            mResident -= cold->full->bytes;
+            cold->full.reset();
+            ++mEvictions;
+         }
+      }
+
+      allocate(texture, texture.full, 0, state);
+      texture.refused = false;
+      ++mPromotions;
+   }
+
+   // Storage for file levels [first, levels) of texture, nothing uploaded yet.
+   void allocate(const Texture& texture, std::optional<Residency>& slot, unsigned first, GlStateCache& state) {
+      const auto& view = texture.view;
+      const auto& format = view.format;
+      const auto levels = unsigned(view.levels.size());
+      auto& residency = slot.emplace();
+      residency.first = first;
+      residency.complete = levels;
+      residency.next = levels - 1;
+      for (auto level = first; level < levels; ++level)
+         residency.bytes += view.levels[level].size();
+
+      state.bindTexture(residency.texture.get());
+      const auto count = GLint(levels - first);
+      if (mImmutable)
+         glTexStorage2D(GL_TEXTURE_2D, count, format.internalFormat, GLsizei(view.levelWidth(first)), GLsizei(view.levelHeight(first)));
+      else
+         for (auto level = first; level < levels; ++level) {
+            const auto width = GLsizei(view.levelWidth(level));
+            const auto height = GLsizei(view.levelHeight(level));
+            if (format.compressed)
+               glCompressedTexImage2D(GL_TEXTURE_2D, GLint(level - first), format.internalFormat, width, height, 0, GLsizei(view.levels[level].size()), nullptr);
+            else
+               glTexImage2D(GL_TEXTURE_2D, GLint(level - first), GLint(format.internalFormat), width, height, 0, format.format, format.type, nullptr);
+         }
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, count - 1);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, count - 1);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+      mResident += residency.bytes;
+      mPeakResident = std::max(mPeakResident, mResident);
+   }
+
+   // Stages bands of the most urgent levels until the budget is used up:
+   // tails before full chains, smaller levels before bigger ones.
+   void upload(GlStateCache& state) {
+      mUploads.clear();
+      GLsizeiptr left = mBudget;
+      auto begun = false;
+      for (;;) {
+         Texture* texture = nullptr;
+         Residency* residency = nullptr;
+         std::size_t best = ~std::size_t(0);
+         for (auto& candidate : mLoader.files()) {
+            if (candidate->tail && !done(*candidate->tail)) {
+               const auto bytes = candidate->view.levels[candidate->tail->next].size();
+               if (bytes < best) {
+                  texture = candidate.get();
+                  residency = &*candidate->tail;
+                  best = bytes;
+               }
+            }
+            // every tail goes first
+            else if (candidate->full && !done(*candidate->full) && wanted(*candidate)) {
+               const auto bytes = (std::size_t(1) << 48) + candidate->view.levels[candidate->full->next].size();
+               if (bytes < best) {
+                  texture = candidate.get();
+                  residency = &*candidate->full;
+                  best = bytes;
+               }
+            }
+         }
+         if (!texture)
+            break;
+
+         if (!begun) {
+            mStaging.beginFrame();
+            begun = true;
+         }
+         const auto staged = stage(*texture, *residency, left, left == mBudget);
+         if (staged == 0) {
+            ++mBudgetLimitedFrames;
+            break;
+         }
+         left -= staged;
+      }
+      if (!begun)
+         return;
+
+      mStaging.endWrites();
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mStaging.get());
+      for (const auto& upload : mUploads) {
+         state.bindTexture(upload.texture);
+         const auto pixels = reinterpret_cast<const void*>(upload.offset);
+         if (upload.format.compressed)
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, upload.y, upload.width, upload.height,
+               upload.format.internalFormat, upload.bytes, pixels);
+         else
+            glTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, upload.y, upload.width, upload.height,
+               upload.format.format, upload.format.type, pixels);
+         if (upload.completes)
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, upload.level);
+      }
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      mStaging.endFrame();
+
+      mUploadedBytes += std::size_t(mBudget - left);
+      ++mUploadFrames;
+   }
+
+   // Stages the next rows of residency's current level that fit in budget;
+   // the bytes staged. The first band of a frame is at least one row.
+   GLsizeiptr stage(const Texture& texture, Residency& residency, GLsizeiptr budget, bool first) {
+      const auto& view = texture.view;
+      const auto& format = view.format;
+      const auto width = view.levelWidth(residency.next);
+      const auto height = view.levelHeight(residency.next);
+      const auto level = view.levels[residency.next];
+      const auto rowBytes = format.rowBytes(width);
+
+      auto rows = std::min((level.size() - residency.offset) / rowBytes, std::size_t(std::max<GLsizeiptr>(budget, 0)) / rowBytes);
+      if (rows == 0 && first)
+         rows = 1;
+      if (rows == 0)
+         return 0;
+      const auto bytes = rows * rowBytes;
+      const auto range = mStaging.allocate(GLsizeiptr(bytes), 16);
+      if (!range.data)
+         return 0;
+      std::memcpy(range.data, level.data() + residency.offset, bytes);
+
+      const auto texelRows = format.compressed ? 4u : 1u;
+      const auto firstRow = unsigned(residency.offset / rowBytes);
+      Upload upload;
+      upload.texture = residency.texture.get();
+      upload.level = GLint(residency.next - residency.first);
+      upload.format = format;
+      upload.y = GLint(firstRow * texelRows);
+      upload.width = GLsizei(width);
+      upload.height = GLsizei(std::min(unsigned(firstRow + rows) * texelRows, height)) - upload.y;
+      upload.offset = range.offset;
+      upload.bytes = GLsizei(bytes);
+
+      residency.offset += bytes;
+      upload.completes = residency.offset == level.size();
+      if (upload.completes) {
+         residency.complete = residency.next;
+         residency.offset = 0;
+         if (residency.next > residency.first)
+            --residency.next;
+      }
+      mUploads.push_back(upload);
+      return GLsizeiptr(bytes);
+   }
+
+   GLsizeiptr mBudget;
+   std::size_t mCap;
+   bool mImmutable = false;
+   StreamBuffer mStaging;
+   GlTexture mFallback;
+   std::vector<Upload> mUploads;
+   std::vector<Texture*> mCold;
+
+   FileLoader<Texture> mLoader;
+
+   unsigned long mFrame = 0;
+   std::size_t mResident = 0;
+   std::size_t mPeakResident = 0;
+   unsigned long mPromotions = 0;
+   unsigned long mEvictions = 0;
+   unsigned long mRefused = 0;
+   std::size_t mUploadedBytes = 0;
+   unsigned long mUploadFrames = 0;
+   unsigned long mBudgetLimitedFrames = 0;
+   double mUpdateSeconds = 0;
+   double mMaxUpdateSeconds = 0;
+};
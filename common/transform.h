@@ -0,0 +1,325 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PLAYGROUND_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(PLAYGROUND_X86) && (defined(__GNUC__) || defined(__clang__))
+#define PLAYGROUND_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PLAYGROUND_TARGET_AVX2
+#endif
+
+// Structure-of-arrays input of composeTransforms(). Every object i gets
+//    model = translate(position + offset) * rotate(angle, axis) * scale(scale * scaleFactor)
+// which is what the glm::translate/rotate/scale chain builds, composed in closed
+// form instead of as three 4x4 products.
+struct TransformBatch {
+   const float* positionX = nullptr;
+   const float* positionY = nullptr;
+   const float* positionZ = nullptr;
+   const float* axisX = nullptr;   // rotation axis, unit length
+   const float* axisY = nullptr;
+   const float* axisZ = nullptr;
+   const float* angle = nullptr;   // radians
+   const float* scale = nullptr;
+   std::size_t count = 0;
+
+   // shared by the whole batch
+   float offset[3] = { 0, 0, 0 };
+   float scaleFactor = 1;
+};
+
+enum class SimdLevel { Scalar, Sse2, Avx2 };
+
+inline const char* toString(SimdLevel level) {
+   switch (level) {
+   case SimdLevel::Avx2: return "avx2";
+   case SimdLevel::Sse2: return "sse2";
+   default: return "scalar";
+   }
+}
+
+inline SimdLevel detectSimdLevel() {
+#if defined(PLAYGROUND_X86) && defined(_MSC_VER)
+   int info[4];
+   __cpuid(info, 1);
+   const bool osxsave = info[2] & (1 << 27);
+   const bool avx = info[2] & (1 << 28);
+   if (osxsave && avx && (_xgetbv(0) & 6) == 6) {
+      __cpuidex(info, 7, 0);
+      if (info[1] & (1 << 5))
+         return SimdLevel::Avx2;
+   }
+   return SimdLevel::Sse2;
+#elif defined(PLAYGROUND_X86)
+   __builtin_cpu_init();
+   return __builtin_cpu_supports("avx2") ? SimdLevel::Avx2 : SimdLevel::Sse2;
+#else
+   return SimdLevel::Scalar;
+#endif
+}
+
+// Best level the CPU supports, lowered with PLAYGROUND_SIMD=scalar|sse2.
+inline SimdLevel bestSimdLevel() {
+   static const SimdLevel level = [] {
+      auto detected = detectSimdLevel();
+      if (const char* env = std::getenv("PLAYGROUND_SIMD")) {
+         const std::string_view requested = env;
+         if (requested == "scalar")
+            detected = SimdLevel::Scalar;
+         else if (requested == "sse2" && detected == SimdLevel::Avx2)
+            detected = SimdLevel::Sse2;
+      }
+      return detected;
+   }();
+   return level;
+}
+
+namespace transform_detail {
+
+// Writes one column major 4x4 model matrix.
+inline void composeOne(const TransformBatch& batch, std::size_t i, float* out) {
+   const auto c = std::cos(batch.angle[i]);
+   const auto s = std::sin(batch.angle[i]);
+   const auto ax = batch.axisX[i];
+   const auto ay = batch.axisY[i];
+   const auto az = batch.axisZ[i];
+   const auto k = batch.scale[i] * batch.scaleFactor;
+   const auto tx = (1 - c) * ax;
+   const auto ty = (1 - c) * ay;
+   const auto tz = (1 - c) * az;
+
+   out[0] = (c + tx * ax) * k;       out[4] = (ty * ax - s * az) * k;  out[8] = (tz * ax + s * ay) * k;   out[12] = batch.positionX[i] + batch.offset[0];
+   out[1] = (tx * ay + s * az) * k;  out[5] = (c + ty * ay) * k;       out[9] = (tz * ay - s * ax) * k;   out[13] = batch.positionY[i] + batch.offset[1];
+   out[2] = (tx * az - s * ay) * k;  out[6] = (ty * az + s * ax) * k;  out[10] = (c + tz * az) * k;      out[14] = batch.positionZ[i] + batch.offset[2];
+   out[3] = 0;                       out[7] = 0;                       out[11] = 0;                       out[15] = 1;
+}
+
+inline void composeScalar(const TransformBatch& batch, std::size_t begin, float* out) {
+   for (auto i = begin; i < batch.count; ++i)
+      composeOne(batch, i, out + 16 * i);
+}
+
+// Cephes single precision sin/cos: reduce to [-pi/4, pi/4] by octant, then
+// evaluate the minimax polynomials; max error about 1 ulp for |x| < 8192.
+constexpr float FOUR_OVER_PI = 1.27323954473516f;
+constexpr float DP1 = 0.78515625f;
+constexpr float DP2 = 2.4187564849853515625e-4f;
+constexpr float DP3 = 3.77489497744594108e-8f;
+constexpr float SIN_P0 = -1.9515295891e-4f;
+constexpr float SIN_P1 = 8.3321608736e-3f;
+constexpr float SIN_P2 = -1.6666654611e-1f;
+constexpr float COS_P0 = 2.443315711809948e-5f;
+constexpr float COS_P1 = -1.388731625493765e-3f;
+constexpr float COS_P2 = 4.166664568298827e-2f;
+
+#ifdef PLAYGROUND_X86
+
+inline void sincos4(__m128 x, __m128* sinOut, __m128* cosOut) {
+   const auto signMask = _mm_castsi128_ps(_mm_set1_epi32(int(0x80000000)));
+   auto sinSign = _mm_and_ps(x, signMask);
+   x = _mm_andnot_ps(signMask, x);
+
+   auto j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(FOUR_OVER_PI)));
+   j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+   const auto y = _mm_cvtepi32_ps(j);
+
+   const auto sinSwap = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29));
+   const auto cosSwap = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+   const auto polyMask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128()));
+   sinSign = _mm_xor_ps(sinSign, sinSwap);
+
+   x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(DP1)));
+   x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(DP2)));
+   x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(DP3)));
+   const auto z = _mm_mul_ps(x, x);
+
+   auto cosPoly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS_P0), z), _mm_set1_ps(COS_P1));
+   cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(COS_P2));
+   cosPoly = _mm_mul_ps(_mm_mul_ps(cosPoly, z), z);
+   cosPoly = _mm_sub_ps(cosPoly, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+   cosPoly = _mm_add_ps(cosPoly, _mm_set1_ps(1.0f));
+
+   auto sinPoly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_P0), z), _mm_set1_ps(SIN_P1));
+   sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(SIN_P2));
+   sinPoly = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinPoly, z), x), x);
+
+   const auto sinValue = _mm_or_ps(_mm_and_ps(polyMask, sinPoly), _mm_andnot_ps(polyMask, cosPoly));
+   const auto cosValue = _mm_or_ps(_mm_and_ps(polyMask, cosPoly), _mm_andnot_ps(polyMask, sinPoly));
+   *sinOut = _mm_xor_ps(sinValue, sinSign);
+   *cosOut = _mm_xor_ps(cosValue, cosSwap);
+}
+
+// Transposes four SoA columns (x, y, z, w of four objects) into four AoS columns.
+inline void storeColumns4(__m128 x, __m128 y, __m128 z, __m128 w, float* out, std::size_t column) {
+   _MM_TRANSPOSE4_PS(x, y, z, w);
+   _mm_storeu_ps(out + 4 * column, x);
+   _mm_storeu_ps(out + 16 + 4 * column, y);
+   _mm_storeu_ps(out + 32 + 4 * column, z);
+   _mm_storeu_ps(out + 48 + 4 * column, w);
+}
+
+inline void composeSse2(const TransformBatch& batch, float* out) {
+   const auto one = _mm_set1_ps(1.0f);
+   const auto zero = _mm_setzero_ps();
+   const auto scaleFactor = _mm_set1_ps(batch.scaleFactor);
+
+   std::size_t i = 0;
+   for (; i + 4 <= batch.count; i += 4) {
+      __m128 s, c;
+      sincos4(_mm_loadu_ps(batch.angle + i), &s, &c);
+
+      const auto ax = _mm_loadu_ps(batch.axisX + i);
+      const auto ay = _mm_loadu_ps(batch.axisY + i);
+      const auto az = _mm_loadu_ps(batch.axisZ + i);
+      const auto k = _mm_mul_ps(_mm_loadu_ps(batch.scale + i), scaleFactor);
+      const auto oneMinusC = _mm_sub_ps(one, c);
+      const auto tx = _mm_mul_ps(oneMinusC, ax);
+      const auto ty = _mm_mul_ps(oneMinusC, ay);
+      const auto tz = _mm_mul_ps(oneMinusC, az);
+      const auto sx = _mm_mul_ps(s, ax);
+      const auto sy = _mm_mul_ps(s, ay);
+      const auto sz = _mm_mul_ps(s, az);
+
+      auto* matrices = out + 16 * i;
+      storeColumns4(
+         _mm_mul_ps(_mm_add_ps(c, _mm_mul_ps(tx, ax)), k),
+         _mm_mul_ps(_mm_add_ps(_mm_mul_ps(tx, ay), sz), k),
+         _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(tx, az), sy), k),
+         zero, matrices, 0);
+      storeColumns4(
+         _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(ty, ax), sz), k),
+         _mm_mul_ps(_mm_add_ps(c, _mm_mul_ps(ty, ay)), k),
+         _mm_mul_ps(_mm_add_ps(_mm_mul_ps(ty, az), sx), k),
+         zero, matrices, 1);
+      storeColumns4(
+         _mm_mul_ps(_mm_add_ps(_mm_mul_ps(tz, ax), sy), k),
+         _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(tz, ay), sx), k),
+         _mm_mul_ps(_mm_add_ps(c, _mm_mul_ps(tz, az)), k),
+         zero, matrices, 2);
+      storeColumns4(
+         _mm_add_ps(_mm_loadu_ps(batch.positionX + i), _mm_set1_ps(batch.offset[0])),
+         _mm_add_ps(_mm_loadu_ps(batch.positionY + i), _mm_set1_ps(batch.offset[1])),
+         _mm_add_ps(_mm_loadu_ps(batch.positionZ + i), _mm_set1_ps(batch.offset[2])),
+         one, matrices, 3);
+   }
+
+   composeScalar(batch, i, out);
+}
+
+PLAYGROUND_TARGET_AVX2
+inline void sincos8(__m256 x, __m256* sinOut, __m256* cosOut) {
+   const auto signMask = _mm256_castsi256_ps(_mm256_set1_epi32(int(0x80000000)));
+   auto sinSign = _mm256_and_ps(x, signMask);
+   x = _mm256_andnot_ps(signMask, x);
+
+   auto j = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(FOUR_OVER_PI)));
+   j = _mm256_and_si256(_mm256_add_epi32(j, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+   const auto y = _mm256_cvtepi32_ps(j);
+
+   const auto sinSwap = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, _mm256_set1_epi32(4)), 29));
+   const auto cosSwap = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_andnot_si256(_mm256_sub_epi32(j, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+   const auto polyMask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)), _mm256_setzero_si256()));
+   sinSign = _mm256_xor_ps(sinSign, sinSwap);
+
+   x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(DP1)));
+   x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(DP2)));
+   x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(DP3)));
+   const auto z = _mm256_mul_ps(x, x);
+
+   auto cosPoly = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(COS_P0), z), _mm256_set1_ps(COS_P1));
+   cosPoly = _mm256_add_ps(_mm256_mul_ps(cosPoly, z), _mm256_set1_ps(COS_P2));
+   cosPoly = _mm256_mul_ps(_mm256_mul_ps(cosPoly, z), z);
+   cosPoly = _mm256_sub_ps(cosPoly, _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+   cosPoly = _mm256_add_ps(cosPoly, _mm256_set1_ps(1.0f));
+
+   auto sinPoly = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(SIN_P0), z), _mm256_set1_ps(SIN_P1));
+   sinPoly = _mm256_add_ps(_mm256_mul_ps(sinPoly, z), _mm256_set1_ps(SIN_P2));
+   sinPoly = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(sinPoly, z), x), x);
+
+   *sinOut = _mm256_xor_ps(_mm256_blendv_ps(cosPoly, sinPoly, polyMask), sinSign);
+   *cosOut = _mm256_xor_ps(_mm256_blendv_ps(sinPoly, cosPoly, polyMask), cosSwap);
+}
+
+// Eight objects: the low and high 128-bit halves are transposed separately.
+PLAYGROUND_TARGET_AVX2
+inline void storeColumns8(__m256 x, __m256 y, __m256 z, __m256 w, float* out, std::size_t column) {
+   storeColumns4(_mm256_castps256_ps128(x), _mm256_castps256_ps128(y),
+      _mm256_castps256_ps128(z), _mm256_castps256_ps128(w), out, column);
+   storeColumns4(_mm256_extractf128_ps(x, 1), _mm256_extractf128_ps(y, 1),
+      _mm256_extractf128_ps(z, 1), _mm256_extractf128_ps(w, 1), out + 64, column);
+}
+
+PLAYGROUND_TARGET_AVX2
+inline void composeAvx2(const TransformBatch& batch, float* out) {
+   const auto one = _mm256_set1_ps(1.0f);
+   const auto zero = _mm256_setzero_ps();
+   const auto scaleFactor = _mm256_set1_ps(batch.scaleFactor);
+
+   std::size_t i = 0;
+   for (; i + 8 <= batch.count; i += 8) {
+      __m256 s, c;
+      sincos8(_mm256_loadu_ps(batch.angle + i), &s, &c);
+
+      const auto ax = _mm256_loadu_ps(batch.axisX + i);
+      const auto ay = _mm256_loadu_ps(batch.axisY + i);
+      const auto az = _mm256_loadu_ps(batch.axisZ + i);
+      const auto k = _mm256_mul_ps(_mm256_loadu_ps(batch.scale + i), scaleFactor);
+      const auto oneMinusC = _mm256_sub_ps(one, c);
+      const auto tx = _mm256_mul_ps(oneMinusC, ax);
+      const auto ty = _mm256_mul_ps(oneMinusC, ay);
+      const auto tz = _mm256_mul_ps(oneMinusC, az);
+      const auto sx = _mm256_mul_ps(s, ax);
+      const auto sy = _mm256_mul_ps(s, ay);
+      const auto sz = _mm256_mul_ps(s, az);
+
+      auto* matrices = out + 16 * i;
+      storeColumns8(
+         _mm256_mul_ps(_mm256_add_ps(c, _mm256_mul_ps(tx, ax)), k),
+         _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(tx, ay), sz), k),
+         _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(tx, az), sy), k),
+         zero, matrices, 0);
+      storeColumns8(
+         _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(ty, ax), sz), k),
+         _mm256_mul_ps(_mm256_add_ps(c, _mm256_mul_ps(ty, ay)), k),
+         _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(ty, az), sx), k),
+         zero, matrices, 1);
+      storeColumns8(
+         _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(tz, ax), sy), k),
+         _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(tz, ay), sx), k),
+         _mm256_mul_ps(_mm256_add_ps(c, _mm256_mul_ps(tz, az)), k),
+         zero, matrices, 2);
+      storeColumns8(
+         _mm256_add_ps(_mm256_loadu_ps(batch.positionX + i), _mm256_set1_ps(batch.offset[0])),
+         _mm256_add_ps(_mm256_loadu_ps(batch.positionY + i), _mm256_set1_ps(batch.offset[1])),
+         _mm256_add_ps(_mm256_loadu_ps(batch.positionZ + i), _mm256_set1_ps(batch.offset[2])),
+         one, matrices, 3);
+   }
+
+   composeScalar(batch, i, out);
+}
+
+#endif
+
+} // namespace transform_detail
+
+// Writes batch.count column major 4x4 matrices (16 floats each) to out.
+inline void composeTransforms(const TransformBatch& batch, float* out, SimdLevel level = bestSimdLevel()) {
+#ifdef PLAYGROUND_X86
+   if (level == SimdLevel::Avx2)
+      return transform_detail::composeAvx2(batch, out);
+   if (level == SimdLevel::Sse2)
+      return transform_detail::composeSse2(batch, out);
+#endif
+   transform_detail::composeScalar(batch, 0, out);
+}
@@ -0,0 +1,276 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <span>
+#include <stdio.h>
+#include <string_view>
+#include <vector>
+
+// Storage type of a vertex attribute. The normalized types hold values in
+// [-1, 1]; pack() clamps to that range.
+enum class VertexType {
+   Float32,   // GL_FLOAT
+   Half,      // GL_HALF_FLOAT, 11 significant bits
+   Snorm16,   // GL_SHORT, normalized, steps of 1/32767
+   Snorm10,   // GL_INT_2_10_10_10_REV, normalized, xyz in steps of 1/511, w in 2 bits
+};
+
+inline const char* toString(VertexType type) {
+   switch (type) {
+   case VertexType::Half: return "half";
+   case VertexType::Snorm16: return "snorm16";
+   case VertexType::Snorm10: return "snorm10";
+   default: return "float";
+   }
+}
+
+// The --vertex-format names; anything else is float.
+inline VertexType parseVertexType(std::string_view name) {
+   for (const auto type : { VertexType::Half, VertexType::Snorm16, VertexType::Snorm10 })
+      if (name == toString(type))
+         return type;
+   return VertexType::Float32;
+}
+
+// Round to nearest even; overflow goes to infinity, tiny values to half denormals.
+inline std::uint16_t floatToHalf(float value) {
+   std::uint32_t bits;
+   std::memcpy(&bits, &value, sizeof(bits));
+   const auto sign = std::uint16_t((bits >> 16) & 0x8000);
+   const auto exponent = int((bits >> 23) & 0xff);
+   auto mantissa = bits & 0x7fffff;
+
+   if (exponent == 0xff)
+      return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+   const auto halfExponent = exponent - 127 + 15;
+   if (halfExponent >= 0x1f)
+      return sign | 0x7c00;
+   if (halfExponent <= 0) {
+      if (halfExponent < -10)
+         return sign;
+      mantissa |= 0x800000;
+      const auto shift = unsigned(14 - halfExponent);
+      auto half = mantissa >> shift;
+      const auto rest = mantissa & ((1u << shift) - 1);
+      const auto halfway = 1u << (shift - 1);
+      if (rest > halfway || (rest == halfway && (half & 1)))
+         ++half;
+      return sign | std::uint16_t(half);
+   }
+
+   auto half = std::uint32_t(halfExponent << 10) | (mantissa >> 13);
+   const auto rest = mantissa & 0x1fff;
+   if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+      ++half;   // may carry into the exponent, which rounds up correctly
+   return sign | std::uint16_t(half);
+}
+
+inline float halfToFloat(std::uint16_t half) {
+   const auto sign = (half & 0x8000) ? -1.0f : 1.0f;
+   const auto exponent = (half >> 10) & 0x1f;
+   const auto mantissa = half & 0x3ff;
+   if (exponent == 0)
+      return sign * std::ldexp(float(mantissa), -24);
+   if (exponent == 0x1f)
+      return mantissa ? NAN : sign * INFINITY;
+   return sign * std::ldexp(float(mantissa | 0x400), exponent - 25);
+}
+
+inline std::int32_t quantizeSnorm(float value, int bits) {
+   const auto steps = float((1 << (bits - 1)) - 1);
+   return std::int32_t(std::lround(std::clamp(value, -1.0f, 1.0f) * steps));
+}
+
+inline float dequantizeSnorm(std::int32_t value, int bits) {
+   const auto steps = float((1 << (bits - 1)) - 1);
+   return std::max(float(value) / steps, -1.0f);
+}
+
+// One attribute of a VertexLayout: components floats per vertex in the
+// source data, stored as type.
+struct VertexAttribute {
+   GLuint location = 0;
+   VertexType type = VertexType::Float32;
+   GLint components = 3;
+   const char* name = "";
+};
+
+// How far packed data is from its source, per attribute.
+struct QuantizationError {
+   double maxError = 0;
+   double sumSquares = 0;
+   std::size_t values = 0;
+
+   double rms() const {
+      return values ? std::sqrt(sumSquares / values) : 0.0;
+   }
+
+   void add(double error) {
+      maxError = std::max(maxError, error);
+      sumSquares += error * error;
+      ++values;
+   }
+
+   QuantizationError& operator+=(const QuantizationError& other) {
+      maxError = std::max(maxError, other.maxError);
+      sumSquares += other.sumSquares;
+      values += other.values;
+      return *this;
+   }
+
+   // Errors of data that was divided by factor before packing, in the original units.
+   void scale(double factor) {
+      maxError *= factor;
+      sumSquares *= factor * factor;
+   }
+};
+
+// Interleaved vertex attributes in one buffer, declared once:
+//
+//    const VertexLayout layout = { { 0, VertexType::Snorm16, 3, "position" }, { 1, VertexType::Snorm10, 3, "normal" } };
+//    const auto bytes = layout.pack({ positions, normals }, vertexCount, &errors);
+//    layout.apply();   // glVertexAttribPointer for the bound GL_ARRAY_BUFFER
+//
+// Each attribute starts on a 4-byte boundary, so 3-component half and snorm16
+// attributes take 8 bytes.
+class VertexLayout {
+public:
+   VertexLayout(std::initializer_list<VertexAttribute> attributes)
+      : mAttributes{ attributes } {
+      for (const auto& attribute : mAttributes) {
+         mOffsets.push_back(mStride);
+         mStride += size(attribute);
+      }
+   }
+
+   GLsizei stride() const {
+      return mStride;
+   }
+
+   // Bytes from the start of a vertex to attribute i.
+   GLsizei offset(std::size_t i) const {
+      return mOffsets[i];
+   }
+
+   std::span<const VertexAttribute> attributes() const {
+      return mAttributes;
+   }
+
+   // Bytes of attribute in a vertex.
+   static GLsizei size(const VertexAttribute& attribute) {
+      switch (attribute.type) {
+      case VertexType::Half:
+      case VertexType::Snorm16: return GLsizei((2 * attribute.components + 3) & ~3);
+      case VertexType::Snorm10: return 4;
+      default: return GLsizei(4 * attribute.components);
+      }
+   }
+
+   static GLenum glType(VertexType type) {
+      switch (type) {
+      case VertexType::Half: return GL_HALF_FLOAT;
+      case VertexType::Snorm16: return GL_SHORT;
+      case VertexType::Snorm10: return GL_INT_2_10_10_10_REV;
+      default: return GL_FLOAT;
+      }
+   }
+
+   static GLboolean normalized(VertexType type) {
+      return type == VertexType::Snorm16 || type == VertexType::Snorm10;
+   }
+
+   // Points every attribute at the buffer bound to GL_ARRAY_BUFFER, vertices
+   // starting at offset, and enables it.
+   void apply(GLintptr offset = 0) const {
+      for (std::size_t i = 0; i < mAttributes.size(); ++i) {
+         const auto& attribute = mAttributes[i];
+         // the packed type is always read as 4 components
+         const auto components = attribute.type == VertexType::Snorm10 ? 4 : attribute.components;
+         glVertexAttribPointer(attribute.location, components, glType(attribute.type), normalized(attribute.type),
+            mStride, reinterpret_cast<const void*>(offset + mOffsets[i]));
+         glEnableVertexAttribArray(attribute.location);
+      }
+   }
+
+   // Interleaves vertexCount vertices; sources[i] holds the floats of
+   // attribute i. errors, when given, gets one entry per attribute.
+   std::vector<std::uint8_t> pack(std::initializer_list<std::span<const float>> sources, std::size_t vertexCount,
+      std::vector<QuantizationError>* errors = nullptr) const {
+      return pack(std::span(sources.begin(), sources.size()), vertexCount, errors);
+   }
+
+   std::vector<std::uint8_t> pack(std::span<const std::span<const float>> sources, std::size_t vertexCount,
+      std::vector<QuantizationError>* errors = nullptr) const {
+      std::vector<std::uint8_t> bytes(vertexCount * mStride);
+      if (errors)
+         errors->assign(mAttributes.size(), {});
+
+      for (std::size_t i = 0; i < mAttributes.size() && i < sources.size(); ++i) {
+         const auto& attribute = mAttributes[i];
+         const auto components = std::size_t(attribute.components);
+         for (std::size_t v = 0; v < vertexCount; ++v) {
+            const auto* source = sources[i].data() + v * components;
+            auto* target = bytes.data() + v * mStride + mOffsets[i];
+            float decoded[4] = {};
+            encode(attribute, source, target, decoded);
+            if (errors)
+               for (std::size_t c = 0; c < components; ++c)
+                  (*errors)[i].add(std::abs(double(decoded[c]) - double(source[c])));
+         }
+      }
+      return bytes;
+   }
+
+   void printErrors(const char* name, std::span<const QuantizationError> errors) const {
+      for (std::size_t i = 0; i < mAttributes.size() && i < errors.size(); ++i)
+         printf("%s %s: %s, %d bytes, max error %.3g, rms %.3g\n", name, mAttributes[i].name,
+            toString(mAttributes[i].type), size(mAttributes[i]), errors[i].maxError, errors[i].rms());
+   }
+
+private:
+   // Writes one attribute value and what the GPU will read back from it.
+   static void encode(const VertexAttribute& attribute, const float* source, std::uint8_t* target, float* decoded) {
+      const auto components = attribute.components;
+      switch (attribute.type) {
+      case VertexType::Half:
+         for (int c = 0; c < components; ++c) {
+            const auto half = floatToHalf(source[c]);
+            std::memcpy(target + 2 * c, &half, sizeof(half));
+            decoded[c] = halfToFloat(half);
+         }
+         break;
+      case VertexType::Snorm16:
+         for (int c = 0; c < components; ++c) {
+            const auto value = std::int16_t(quantizeSnorm(source[c], 16));
+            std::memcpy(target + 2 * c, &value, sizeof(value));
+            decoded[c] = dequantizeSnorm(value, 16);
+         }
+         break;
+      case VertexType::Snorm10: {
+         std::uint32_t packed = 0;
+         for (int c = 0; c < std::min(components, 4); ++c) {
+            const auto bits = c < 3 ? 10 : 2;
+            const auto value = quantizeSnorm(source[c], bits);
+            packed |= (std::uint32_t(value) & ((1u << bits) - 1)) << (10 * c);
+            decoded[c] = dequantizeSnorm(value, bits);
+         }
+         std::memcpy(target, &packed, sizeof(packed));
+         break;
+      }
+      default:
+         std::memcpy(target, source, 4 * components);
+         std::copy(source, source + components, decoded);
+         break;
+      }
+   }
+
+   std::vector<VertexAttribute> mAttributes;
+   std::vector<GLsizei> mOffsets;
+   GLsizei mStride = 0;
+};
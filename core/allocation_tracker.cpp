@@ -0,0 +1,194 @@
+#include "allocation_tracker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <stdio.h>
+
+namespace {
+
+std::atomic<unsigned long> gAllocations{ 0 };
+std::atomic<std::size_t> gBytes{ 0 };
+std::atomic<std::size_t> gLiveBytes{ 0 };
+std::atomic<std::size_t> gPeakBytes{ 0 };
+
+// Every block is malloc'ed with room in front for the size it was asked for
+// and the pointer to free, so aligned and unaligned blocks are freed alike.
+constexpr std::size_t HEADER = 2 * sizeof(void*);
+
+void* trackedAllocate(std::size_t size, std::size_t alignment) {
+   alignment = std::max(alignment, alignof(std::max_align_t));
+   auto* base = static_cast<char*>(std::malloc(size + HEADER + alignment));
+   if (!base)
+      return nullptr;
+   const auto address = (reinterpret_cast<std::uintptr_t>(base) + HEADER + alignment - 1) & ~std::uintptr_t(alignment - 1);
+   auto* block = reinterpret_cast<void**>(address);
+   block[-1] = base;
+   block[-2] = reinterpret_cast<void*>(size);
+
+   gAllocations.fetch_add(1, std::memory_order_relaxed);
+   gBytes.fetch_add(size, std::memory_order_relaxed);
+   const auto live = gLiveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+   auto peak = gPeakBytes.load(std::memory_order_relaxed);
+   while (live > peak && !gPeakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+   }
+   return block;
+}
+
+void* trackedNew(std::size_t size, std::size_t alignment) {
+   if (auto* block = trackedAllocate(size, alignment))
+      return block;
+   throw std::bad_alloc();
+}
+
+void trackedFree(void* pointer) {
+   if (!pointer)
+      return;
+   auto* block = static_cast<void**>(pointer);
+   gLiveBytes.fetch_sub(reinterpret_cast<std::size_t>(block[-2]), std::memory_order_relaxed);
+   std::free(block[-1]);
+}
+
+}
+
+void* operator new(std::size_t size) {
+   return trackedNew(size, 0);
+}
+
+void* operator new[](std::size_t size) {
+   return trackedNew(size, 0);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+   return trackedNew(size, std::size_t(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+   return trackedNew(size, std::size_t(alignment));
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+   return trackedAllocate(size, 0);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+   return trackedAllocate(size, 0);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+   return trackedAllocate(size, std::size_t(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+   return trackedAllocate(size, std::size_t(alignment));
+}
+
+void operator delete(void* pointer) noexcept {
+   trackedFree(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+   trackedFree(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+   trackedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+   trackedFree(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+   trackedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+   trackedFree(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept {
+   trackedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept {
+   trackedFree(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+   trackedFree(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+   trackedFree(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+   trackedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+   trackedFree(pointer);
+}
+
+AllocationCounts allocationCounts() {
+   AllocationCounts counts;
+   counts.allocations = gAllocations.load(std::memory_order_relaxed);
+   counts.bytes = gBytes.load(std::memory_order_relaxed);
+   counts.liveBytes = gLiveBytes.load(std::memory_order_relaxed);
+   counts.peakBytes = gPeakBytes.load(std::memory_order_relaxed);
+   return counts;
+}
+
+AllocationCheck::AllocationCheck(const Options& options)
+   : mCheck{ options.allocationWarmup.has_value() }
+   , mWarmup{ options.allocationWarmup.value_or(DEFAULT_ALLOCATION_WARMUP) } {
+   if (mCheck && options.frames != 0 && options.frames <= mWarmup)
+      printf("--check-allocations %lu leaves no frame of a %lu frame run to check\n", mWarmup, options.frames);
+}
+
+void AllocationCheck::beginFrame(unsigned long frame) {
+   mFrame = frame;
+   mStart = allocationCounts();
+}
+
+void AllocationCheck::endFrame() {
+   const auto counts = allocationCounts();
+   const auto allocations = counts.allocations - mStart.allocations;
+   const auto bytes = counts.bytes - mStart.bytes;
+   ++mFrames;
+   mAllocations += allocations;
+   mBytes += bytes;
+   if (mFrame < mWarmup)
+      return;
+
+   ++mSteadyFrames;
+   mSteadyAllocations += allocations;
+   mSteadyBytes += bytes;
+   if (allocations && !mFirstAllocations) {
+      mFirstFrame = mFrame;
+      mFirstAllocations = allocations;
+   }
+}
+
+void AllocationCheck::printStats() const {
+   const auto frames = double(std::max(mFrames, 1ul));
+   const auto steadyFrames = double(std::max(mSteadyFrames, 1ul));
+   printf("Heap: %.1f allocations/frame (%.1f bytes), after %lu warm-up frames %.2f allocations/frame (%.1f bytes), peak %zu bytes live\n",
+      mAllocations / frames, mBytes / frames, mWarmup, mSteadyAllocations / steadyFrames, mSteadyBytes / steadyFrames,
+      allocationCounts().peakBytes);
+}
+
+int AllocationCheck::finish() const {
+   if (!mCheck)
+      return 0;
+   if (mSteadyAllocations == 0) {
+      printf("Heap allocations after warm-up: none in %lu frames: ok\n", mSteadyFrames);
+      return 0;
+   }
+   printf("Heap allocations after warm-up: %lu in %lu frames, the first %lu in frame %lu: FAILED\n",
+      mSteadyAllocations, mSteadyFrames, mFirstAllocations, mFirstFrame);
+   return 1;
+}
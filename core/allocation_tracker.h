@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+
+#include "options.h"
+
+// Every operator new and delete of the process, on all threads, counted by
+// the global replacements in allocation_tracker.cpp; a sample gets them by
+// using anything declared here. Only C++ allocations show up, malloc from C
+// libraries and the GL driver does not.
+struct AllocationCounts {
+   unsigned long allocations = 0;
+   // bytes requested by all allocations, alive now and at most at once
+   std::size_t bytes = 0;
+   std::size_t liveBytes = 0;
+   std::size_t peakBytes = 0;
+};
+
+AllocationCounts allocationCounts();
+
+// frames not checked when --check-allocations is not given
+constexpr unsigned long DEFAULT_ALLOCATION_WARMUP = 60;
+
+// Heap allocations of the frame loop, frame by frame. Frames after the
+// first warm-up ones are the steady state, where everything per-frame should
+// come from buffers, arenas and pools that already grew; with
+// --check-allocations a steady frame that allocates fails the run.
+//
+//    allocations.beginFrame(i);
+//    ...                               // the frame's work
+//    allocations.endFrame();           // before presenting and readbacks
+//    return check.finish(frameRate) | allocations.finish();
+class AllocationCheck {
+public:
+   explicit AllocationCheck(const Options& options);
+
+   void beginFrame(unsigned long frame);
+   void endFrame();
+
+   void printStats() const;
+
+   // The process exit code, 1 when the check is on and a steady frame allocated.
+   int finish() const;
+
+private:
+   bool mCheck;
+   unsigned long mWarmup;
+
+   unsigned long mFrame = 0;
+   AllocationCounts mStart;
+
+   unsigned long mFrames = 0;
+   unsigned long mAllocations = 0;
+   std::size_t mBytes = 0;
+   unsigned long mSteadyFrames = 0;
+   unsigned long mSteadyAllocations = 0;
+   std::size_t mSteadyBytes = 0;
+   // first steady frame that allocated, and how often it did
+   unsigned long mFirstFrame = 0;
+   unsigned long mFirstAllocations = 0;
+};
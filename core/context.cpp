@@ -0,0 +1,11 @@
+#include "context.h"
+
+ContextGuard::ContextGuard(int (*initContext)(), void (*terminateContext)())
+   : mInitContextFun{ initContext }
+   , mTerminateContextFun{ terminateContext } {
+   mInitStatus = mInitContextFun();
+}
+
+ContextGuard::~ContextGuard() {
+   mTerminateContextFun();
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <memory>
+
+// Initializes a windowing or display library for the lifetime of the guard:
+// glfwInit/glfwTerminate, or headlessInit/headlessTerminate. The terminate
+// function runs even when init failed, as glfwTerminate allows.
+class [[nodiscard]] ContextGuard {
+public:
+   ContextGuard(int (*initContext)(), void (*terminateContext)());
+   ~ContextGuard();
+
+   ContextGuard(const ContextGuard&) = delete;
+   ContextGuard& operator=(const ContextGuard&) = delete;
+
+   // What initContext returned, GLFW_TRUE on success.
+   int getInitStatus() const {
+      return mInitStatus;
+   }
+
+private:
+   int mInitStatus;
+   int (*mInitContextFun)();
+   void (*mTerminateContextFun)();
+};
+
+#ifdef GLFW_TRUE
+
+struct GlfwWindowDeleter {
+   void operator()(GLFWwindow* window) const {
+      glfwDestroyWindow(window);
+   }
+};
+
+using window_ptr = std::unique_ptr<GLFWwindow, GlfwWindowDeleter>;
+
+// glfwCreateWindow with the window destroyed by the returned pointer; empty
+// when the window or its context couldn't be created.
+inline window_ptr makeWindow_glfw(int width, int height, const char* title,
+   GLFWmonitor* monitor = nullptr, GLFWwindow* share = nullptr) {
+   return window_ptr(glfwCreateWindow(width, height, title, monitor, share));
+}
+
+#endif
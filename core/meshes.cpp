@@ -0,0 +1,12 @@
+#include "meshes.h"
+
+#include "mesh_builder.h"
+#include "shapes.h"
+
+MeshHandle createTriangle(GeometryRegistry& geometry) {
+   return geometry.add(buildIndexedMesh(TRIANGLE_VERTICES, 3), GL_TRIANGLES);
+}
+
+MeshHandle createSquare(GeometryRegistry& geometry) {
+   return geometry.add(buildIndexedMesh(SQUARE_VERTICES, 2), GL_LINES);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "geometry.h"
+
+// The shapes every sample draws, uploaded into geometry as indexed meshes:
+// the unit triangle as GL_TRIANGLES and the unit square's outline as
+// GL_LINES, its 8 vertices merged into 4 (see shapes.h).
+MeshHandle createTriangle(GeometryRegistry& geometry);
+MeshHandle createSquare(GeometryRegistry& geometry);
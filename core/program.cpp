@@ -0,0 +1,73 @@
+#include "program.h"
+
+#include <stdio.h>
+#include <string.h>
+
+bool addShader(GLuint program, const char* shaderCode, GLenum shaderType) {
+   GLuint shader = glCreateShader(shaderType);
+
+   const GLchar* code[1];
+   code[0] = shaderCode;
+
+   GLint codeLength[1];
+   codeLength[0] = GLint(strlen(shaderCode));
+
+   glShaderSource(shader, 1, code, codeLength);
+   glCompileShader(shader);
+
+   GLint result = 0;
+   GLchar log[1024] = "";
+
+   glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
+   if (!result) {
+      glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+      printf("Error compiling shader: '%s'\n", log);
+      glDeleteShader(shader);
+      return false;
+   }
+
+   glAttachShader(program, shader);
+   glDeleteShader(shader);
+   return true;
+}
+
+GLuint compileProgram(const char* vertexShader, const char* fragmentShader) {
+   const auto program = glCreateProgram();
+   if (!program) {
+      printf("Error creating shader program\n");
+      return 0;
+   }
+
+   auto ret = true;
+   ret &= addShader(program, vertexShader, GL_VERTEX_SHADER);
+   ret &= addShader(program, fragmentShader, GL_FRAGMENT_SHADER);
+
+   GLint result = 0;
+   GLchar log[1024] = "";
+
+   if (ret) {
+      glLinkProgram(program);
+      glGetProgramiv(program, GL_LINK_STATUS, &result);
+      if (!result) {
+         glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+         printf("Error linking program: '%s'\n", log);
+         ret = false;
+      }
+   }
+
+   if (ret) {
+      glValidateProgram(program);
+      glGetProgramiv(program, GL_VALIDATE_STATUS, &result);
+      if (!result) {
+         glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+         printf("Error validating program: '%s'\n", log);
+         ret = false;
+      }
+   }
+
+   if (!ret) {
+      glDeleteProgram(program);
+      return 0;
+   }
+   return program;
+}
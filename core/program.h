@@ -0,0 +1,13 @@
+#pragma once
+
+#include <GL/glew.h>
+
+// Compiles shaderCode and attaches it to program. The shader is flagged for
+// deletion right away, so it goes with the program. Prints the info log and
+// returns false when it doesn't compile.
+bool addShader(GLuint program, const char* shaderCode, GLenum shaderType);
+
+// Compiles, links and validates a vertex + fragment program, blocking until
+// the driver is done; ShaderPipeline is the asynchronous counterpart. Returns
+// 0 after printing the log when any step fails.
+GLuint compileProgram(const char* vertexShader, const char* fragmentShader);